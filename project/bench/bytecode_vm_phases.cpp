@@ -0,0 +1,164 @@
+#include <cstddef>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <boost/program_options.hpp>
+
+#include "compiler.hpp"
+#include "heap.hpp"
+#include "object.hpp"
+#include "peephole.hpp"
+#include "phases.hpp"
+#include "scanner.hpp"
+#include "vm.hpp"
+
+using std::cout;
+using std::left;
+using std::make_unique;
+using std::pair;
+using std::right;
+using std::set;
+using std::setw;
+using std::size_t;
+using std::string;
+using std::unique_ptr;
+using std::vector;
+
+namespace loxns = motts::lox;
+namespace program_options = boost::program_options;
+
+// Not exported (internal linkage)
+namespace {
+    // Everything one run of a script goes through. Each phase's setup runs the phases before it.
+    struct Run {
+        explicit Run(const string& source_arg) :
+            source {source_arg}
+        {}
+
+        const string& source;
+        loxns::VM vm;
+        unique_ptr<loxns::Program> program;
+    };
+
+    void scan(Run& run) {
+        auto token_count = 0;
+        for (loxns::Token_iterator token_iter {run.source}; token_iter != loxns::Token_iterator{}; ++token_iter) {
+            ++token_count;
+        }
+        benchmark::DoNotOptimize(token_count);
+    }
+
+    void compile(Run& run) {
+        run.program = make_unique<loxns::Program>(run.vm.compile(run.source));
+    }
+
+    void execute(Run& run) {
+        run.vm.execute(*run.program);
+    }
+
+    // Instructions in the function and in every function declared inside it, which are in its constants
+    size_t count_instructions(const loxns::Obj_function& function) {
+        auto count = loxns::opcodes(function.chunk).size();
+        for (const auto constant : function.chunk.constants) {
+            if (loxns::is_obj_type(constant, loxns::Obj_type::function)) {
+                count += count_instructions(*loxns::as_function(constant));
+            }
+        }
+
+        return count;
+    }
+
+    // How many instructions the script compiles to with and without the peephole pass. This is the static count, not
+    // how many run.
+    void print_instruction_counts(const string& script_name, const string& source) {
+        loxns::Heap heap;
+        const auto unoptimized = count_instructions(*loxns::compile(source, heap, false));
+        const auto optimized = count_instructions(*loxns::compile(source, heap));
+
+        cout << left << setw(20) << script_name << right
+            << setw(10) << unoptimized << setw(10) << optimized << "\n";
+    }
+}
+
+int main(int argc, char* argv[]) {
+    // Let the benchmark library take its own options out of argv first
+    benchmark::Initialize(&argc, argv);
+
+    program_options::options_description options_description {
+        "Usage: bench_bytecode_vm_phases [options]\n"
+        "\n"
+        "Options"
+    };
+    options_description.add_options()
+        ("help", "Print usage information and exit.")
+        ("test-scripts-path", program_options::value<string>(), "Required. Path to test scripts.")
+        (
+            "count-instructions",
+            "Print how many instructions each script compiles to before and after the peephole pass, instead of "
+            "benchmarking."
+        );
+
+    program_options::variables_map variables_map;
+    program_options::store(program_options::parse_command_line(argc, argv, options_description), variables_map);
+    program_options::notify(variables_map);
+
+    if (variables_map.count("help") || !variables_map.count("test-scripts-path")) {
+        cout << options_description << "\n";
+        return 0;
+    }
+
+    // Break and continue are cpplox's own additions to Lox, which the VM doesn't have
+    const set<string> cpplox_only_scripts {"loop_control"};
+
+    using Phase = void (*)(Run&);
+    const vector<pair<string, Phase>> phases {{"scan", scan}, {"compile", compile}, {"execute", execute}};
+
+    if (variables_map.count("count-instructions")) {
+        cout << left << setw(20) << "script" << right << setw(10) << "before" << setw(10) << "after" << "\n";
+    }
+
+    for (string script_name : {"binary_trees", "equality", "fib", "invocation", "loop_control", "method_call", "properties", "string_equality"}) {
+        if (cpplox_only_scripts.count(script_name)) {
+            continue;
+        }
+
+        const auto source = bench::read_file(
+            variables_map.at("test-scripts-path").as<string>() + "/" + script_name + ".lox"
+        );
+
+        if (variables_map.count("count-instructions")) {
+            print_instruction_counts(script_name, source);
+            continue;
+        }
+
+        for (auto phase_iter = phases.cbegin(); phase_iter != phases.cend(); ++phase_iter) {
+            benchmark::RegisterBenchmark(
+                ("cpploxbc_" + script_name + "/" + phase_iter->first).c_str(),
+                [source, phase_iter, &phases] (benchmark::State& state) {
+                    bench::bench_phase(
+                        state,
+                        source.size(),
+                        [&] () {
+                            auto run = make_unique<Run>(source);
+                            for (auto earlier_iter = phases.cbegin(); earlier_iter != phase_iter; ++earlier_iter) {
+                                earlier_iter->second(*run);
+                            }
+
+                            return run;
+                        },
+                        phase_iter->second
+                    );
+                }
+            )->Unit(benchmark::kMillisecond);
+        }
+    }
+
+    if (!variables_map.count("count-instructions")) {
+        benchmark::RunSpecifiedBenchmarks();
+    }
+}
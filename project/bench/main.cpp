@@ -1,4 +1,5 @@
 #include <iostream>
+#include <set>
 #include <string>
 
 // (MSVC) Suppress warnings from dependencies; they're not ours to fix
@@ -9,6 +10,7 @@
 #include <boost/program_options.hpp>
 
 using std::cout;
+using std::set;
 using std::string;
 
 namespace process = boost::process;
@@ -23,6 +25,7 @@ int main(int argc, /*const*/ char* argv[]) {
     options_description.add_options()
         ("help", "Print usage information and exit.")
         ("cpplox-file", program_options::value<string>(), "Required. File path to cpplox executable.")
+        ("cpploxbc-file", program_options::value<string>(), "File path to cpploxbc executable.")
         ("test-scripts-path", program_options::value<string>(), "Required. Path to test scripts.")
         ("jlox-file", program_options::value<string>(), "File path to jlox run cmake script.")
         ("node-file", program_options::value<string>(), "File path to node executable.");
@@ -41,7 +44,13 @@ int main(int argc, /*const*/ char* argv[]) {
         return 0;
     }
 
-    for (string script_name : {"binary_trees", "equality", "fib", "invocation", "properties", "string_equality"}) {
+    // Break and continue are cpplox's own additions to Lox, so scripts that use them are skipped by the other Lox
+    // implementations
+    const set<string> cpplox_only_scripts {"loop_control"};
+
+    for (string script_name : {"binary_trees", "equality", "fib", "invocation", "loop_control", "method_call", "properties", "string_equality"}) {
+        const auto is_standard_lox = !cpplox_only_scripts.count(script_name);
+
         benchmark::RegisterBenchmark(("cpplox_" + script_name).c_str(), [script_name, &variables_map] (benchmark::State& state) {
             const auto cpplox = variables_map.at("cpplox-file").as<string>();
             const auto test_script = variables_map.at("test-scripts-path").as<string>() + "/" + script_name + ".lox";
@@ -57,7 +66,20 @@ int main(int argc, /*const*/ char* argv[]) {
             }
         });
 
-        if (variables_map.count("jlox-file") && variables_map.at("jlox-file").as<string>().size()) {
+        if (is_standard_lox && variables_map.count("cpploxbc-file") && variables_map.at("cpploxbc-file").as<string>().size()) {
+            benchmark::RegisterBenchmark(("cpploxbc_" + script_name).c_str(), [script_name, &variables_map] (benchmark::State& state) {
+                const auto cpploxbc = variables_map.at("cpploxbc-file").as<string>();
+                const auto test_script = variables_map.at("test-scripts-path").as<string>() + "/" + script_name + ".lox";
+                const auto cmd = "\"" + cpploxbc + "\" \"" + test_script + "\"";
+
+                for (auto _ : state) {
+                    process::ipstream cpploxbc_out;
+                    process::system(cmd, process::std_out > cpploxbc_out);
+                }
+            });
+        }
+
+        if (is_standard_lox && variables_map.count("jlox-file") && variables_map.at("jlox-file").as<string>().size()) {
             benchmark::RegisterBenchmark(("jlox_" + script_name).c_str(), [script_name, &variables_map] (benchmark::State& state) {
                 const auto jlox = variables_map.at("jlox-file").as<string>();
                 const auto test_script = variables_map.at("test-scripts-path").as<string>() + "/" + script_name + ".lox";
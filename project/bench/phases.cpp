@@ -0,0 +1,75 @@
+#include "phases.hpp"
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <new>
+
+using std::bad_alloc;
+using std::cout;
+using std::free;
+using std::ifstream;
+using std::istreambuf_iterator;
+using std::malloc;
+using std::size_t;
+using std::streamsize;
+using std::string;
+
+// Not exported (internal linkage)
+namespace {
+    // The harnesses are single threaded, so plain counters will do
+    size_t allocation_count {};
+    size_t allocated_bytes {};
+}
+
+// Replacing the global allocation functions counts every allocation the interpreters make, however they make it. The
+// array and sized forms all forward to these.
+void* operator new(size_t size) {
+    ++allocation_count;
+    allocated_bytes += size;
+
+    const auto memory = malloc(size ? size : 1);
+    if (!memory) {
+        throw bad_alloc{};
+    }
+
+    return memory;
+}
+
+void operator delete(void* memory) noexcept {
+    free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept {
+    free(memory);
+}
+
+// Exported (external linkage)
+namespace bench {
+    Allocation_counts allocation_counts() {
+        return {allocation_count, allocated_bytes};
+    }
+
+    string read_file(const string& path) {
+        ifstream in {path};
+        in.exceptions(ifstream::failbit | ifstream::badbit);
+        return string{istreambuf_iterator<char>{in}, istreambuf_iterator<char>{}};
+    }
+
+    Silence_cout::Silence_cout() :
+        cout_buffer_ {cout.rdbuf(&null_buffer_)}
+    {}
+
+    Silence_cout::~Silence_cout() {
+        cout.rdbuf(cout_buffer_);
+    }
+
+    Silence_cout::Null_buffer::int_type Silence_cout::Null_buffer::overflow(int_type c) {
+        return traits_type::not_eof(c);
+    }
+
+    streamsize Silence_cout::Null_buffer::xsputn(const char_type*, streamsize count) {
+        return count;
+    }
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <streambuf>
+#include <string>
+
+// (MSVC) Suppress warnings from dependencies; they're not ours to fix
+#pragma warning(push, 0)
+    #include <benchmark/benchmark.h>
+#pragma warning(pop)
+
+// Helpers shared by the in-process bench harnesses, which time each phase of an interpreter -- scanning, parsing,
+// running, and so on -- separately and without any process startup or file I/O in the numbers.
+namespace bench {
+    // Running totals of every allocation through global operator new since the program started
+    struct Allocation_counts {
+        std::size_t count;
+        std::size_t bytes;
+    };
+
+    Allocation_counts allocation_counts();
+
+    std::string read_file(const std::string& path);
+
+    // Scripts print their results, and the benchmark prints its report to the same stdout, so while a phase runs its
+    // output is thrown away instead
+    class Silence_cout {
+        public:
+            explicit Silence_cout();
+            ~Silence_cout();
+
+            Silence_cout(const Silence_cout&) = delete;
+            Silence_cout& operator=(const Silence_cout&) = delete;
+
+        private:
+            struct Null_buffer : std::streambuf {
+                int_type overflow(int_type c) override;
+                std::streamsize xsputn(const char_type*, std::streamsize count) override;
+            };
+
+            Null_buffer null_buffer_;
+            std::streambuf* cout_buffer_;
+    };
+
+    // Runs `phase` once per iteration on a fresh input made by `setup`, which returns it in a unique_ptr. Only the
+    // phase itself is timed and has its allocations counted; making the input, which usually means running the phases
+    // before this one, and destroying it are not. Throughput is reported in bytes of source.
+    template<typename Setup, typename Phase>
+        void bench_phase(benchmark::State& state, std::size_t source_size, Setup setup, Phase phase) {
+            std::size_t allocations {};
+            std::size_t allocated_bytes {};
+
+            for (auto _ : state) {
+                state.PauseTiming();
+                auto input = setup();
+                state.ResumeTiming();
+
+                const auto before = allocation_counts();
+                {
+                    Silence_cout silence_cout;
+                    phase(*input);
+                }
+                const auto after = allocation_counts();
+                allocations += after.count - before.count;
+                allocated_bytes += after.bytes - before.bytes;
+
+                state.PauseTiming();
+                input.reset();
+                state.ResumeTiming();
+            }
+
+            state.SetBytesProcessed(state.iterations() * source_size);
+            state.counters["allocs"] = static_cast<double>(allocations) / state.iterations();
+            state.counters["alloc_bytes"] = static_cast<double>(allocated_bytes) / state.iterations();
+        }
+}
@@ -0,0 +1,20 @@
+// This benchmark stresses loops that exit early with break and skip ahead with continue.
+
+let start = new Date().getTime();
+let sum = 0;
+for (let i = 0; i < 100; i = i + 1) {
+  let odd = false;
+  let j = 0;
+  while (true) {
+    j = j + 1;
+    if (j > 100) break;
+
+    odd = !odd;
+    if (odd) continue;
+
+    sum = sum + j;
+  }
+}
+
+console.log(sum === 255000);
+console.log(new Date().getTime() - start);
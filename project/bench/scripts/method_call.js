@@ -0,0 +1,33 @@
+// This benchmark compares calling methods right where they're looked up with calling a method that was looked up
+// once ahead of time. The first loop binds a method on every call unless the implementation avoids it, so the gap
+// between the two times is the cost of binding.
+
+class Counter {
+  constructor() {
+    this.count = 0;
+  }
+
+  increment() {
+    this.count = this.count + 1;
+  }
+}
+
+let counter = new Counter();
+let start = new Date().getTime();
+let i = 0;
+while (i < 10000) {
+  counter.increment();
+  i = i + 1;
+}
+console.log(new Date().getTime() - start);
+
+let increment = counter.increment.bind(counter);
+start = new Date().getTime();
+i = 0;
+while (i < 10000) {
+  increment();
+  i = i + 1;
+}
+console.log(new Date().getTime() - start);
+
+console.log(counter.count === 20000);
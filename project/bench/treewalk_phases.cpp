@@ -0,0 +1,119 @@
+#include <iostream>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <boost/program_options.hpp>
+
+#include "lox.hpp"
+#include "phases.hpp"
+#include "scanner.hpp"
+
+using std::cout;
+using std::make_unique;
+using std::pair;
+using std::string;
+using std::vector;
+
+namespace loxns = motts::lox;
+namespace program_options = boost::program_options;
+
+// Not exported (internal linkage)
+namespace {
+    // Everything one run of a script goes through. Each phase's setup runs the phases before it.
+    struct Run {
+        explicit Run(const string& source_arg) :
+            source {source_arg}
+        {}
+
+        const string& source;
+        loxns::Lox lox;
+        vector<const loxns::Stmt*> statements;
+    };
+
+    void scan(Run& run) {
+        auto token_count = 0;
+        for (loxns::Token_iterator token_iter {run.source}; token_iter != loxns::Token_iterator{}; ++token_iter) {
+            ++token_count;
+        }
+        benchmark::DoNotOptimize(token_count);
+    }
+
+    void parse(Run& run) {
+        run.statements = run.lox.parse(loxns::Token_iterator{run.source});
+    }
+
+    void resolve(Run& run) {
+        for (const auto statement : run.statements) {
+            statement->accept(run.lox.resolver);
+        }
+    }
+
+    void optimize(Run& run) {
+        run.statements = run.lox.optimizer.optimize(run.statements);
+    }
+
+    void execute(Run& run) {
+        for (const auto statement : run.statements) {
+            statement->accept(run.lox.interpreter);
+        }
+    }
+}
+
+int main(int argc, char* argv[]) {
+    // Let the benchmark library take its own options out of argv first
+    benchmark::Initialize(&argc, argv);
+
+    program_options::options_description options_description {
+        "Usage: bench_treewalk_phases [options]\n"
+        "\n"
+        "Options"
+    };
+    options_description.add_options()
+        ("help", "Print usage information and exit.")
+        ("test-scripts-path", program_options::value<string>(), "Required. Path to test scripts.");
+
+    program_options::variables_map variables_map;
+    program_options::store(program_options::parse_command_line(argc, argv, options_description), variables_map);
+    program_options::notify(variables_map);
+
+    if (variables_map.count("help") || !variables_map.count("test-scripts-path")) {
+        cout << options_description << "\n";
+        return 0;
+    }
+
+    using Phase = void (*)(Run&);
+    const vector<pair<string, Phase>> phases {
+        {"scan", scan}, {"parse", parse}, {"resolve", resolve}, {"optimize", optimize}, {"execute", execute}
+    };
+
+    for (string script_name : {"binary_trees", "equality", "fib", "invocation", "loop_control", "method_call", "properties", "string_equality"}) {
+        const auto source = bench::read_file(
+            variables_map.at("test-scripts-path").as<string>() + "/" + script_name + ".lox"
+        );
+
+        for (auto phase_iter = phases.cbegin(); phase_iter != phases.cend(); ++phase_iter) {
+            benchmark::RegisterBenchmark(
+                ("cpplox_" + script_name + "/" + phase_iter->first).c_str(),
+                [source, phase_iter, &phases] (benchmark::State& state) {
+                    bench::bench_phase(
+                        state,
+                        source.size(),
+                        [&] () {
+                            auto run = make_unique<Run>(source);
+                            for (auto earlier_iter = phases.cbegin(); earlier_iter != phase_iter; ++earlier_iter) {
+                                earlier_iter->second(*run);
+                            }
+
+                            return run;
+                        },
+                        phase_iter->second
+                    );
+                }
+            )->Unit(benchmark::kMillisecond);
+        }
+    }
+
+    benchmark::RunSpecifiedBenchmarks();
+}
@@ -0,0 +1,320 @@
+#include "bytecode_cache.hpp"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <vector>
+
+#include <boost/interprocess/detail/os_thread_functions.hpp>
+#include <boost/interprocess/exceptions.hpp>
+#include <gsl/gsl_util>
+
+#include "compiler.hpp"
+#include "object.hpp"
+
+using std::memcmp;
+using std::memcpy;
+using std::ofstream;
+using std::random_device;
+using std::remove;
+using std::rename;
+using std::size_t;
+using std::string;
+using std::to_string;
+using std::uint32_t;
+using std::uint64_t;
+using std::uint8_t;
+using std::unique_ptr;
+using std::vector;
+
+using boost::interprocess::file_mapping;
+using boost::interprocess::ipcdetail::get_current_process_id;
+using boost::interprocess::interprocess_exception;
+using boost::interprocess::mapped_region;
+using boost::interprocess::read_only;
+
+using gsl::finally;
+
+using namespace motts::lox;
+
+// Not exported (internal linkage)
+namespace {
+    // Bump whenever the layout below changes
+    constexpr uint32_t format_version {4};
+
+    constexpr char magic[] {'L', 'O', 'X', 'C'};
+
+    struct Header {
+        char magic[4];
+        uint32_t format_version;
+        uint32_t opcodes_hash;
+        uint32_t compiler_version;
+        uint32_t source_hash;
+        uint64_t source_length;
+        uint32_t payload_checksum;
+    };
+
+    enum class Constant_tag : uint8_t {
+        function,
+        number,
+        string
+    };
+
+    // A function without a name (the top-level script) is written with this length instead
+    constexpr uint32_t no_name {0xffff'ffff};
+
+    // Opcode numbers come from their position in the X-macro list, so hashing the names in order catches any added,
+    // removed, or reordered opcode
+    uint32_t hash_opcodes() {
+        #define X(name) #name " "
+        static const char names[] = MOTTS_LOX_OP_CODE_NAMES;
+        #undef X
+
+        return hash_string(names, sizeof(names) - 1);
+    }
+
+    template<typename T>
+        void write_bytes(string& out, const T& value) {
+            out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+        }
+
+    void write_string(string& out, const string& str) {
+        write_bytes(out, static_cast<uint32_t>(str.size()));
+        out += str;
+    }
+
+    // Returns false if the function holds a constant the format can't store
+    bool write_function(string& out, const Obj_function& function) {
+        write_bytes(out, static_cast<uint32_t>(function.arity));
+        write_bytes(out, static_cast<uint32_t>(function.upvalue_count));
+        if (function.name) {
+            write_string(out, function.name->str);
+        } else {
+            write_bytes(out, no_name);
+        }
+
+        const auto& chunk = function.chunk;
+        const auto code = chunk.bytecode();
+        write_bytes(out, static_cast<uint32_t>(code.size()));
+        out.append(reinterpret_cast<const char*>(code.data()), code.size());
+
+        write_bytes(out, static_cast<uint32_t>(chunk.lines.size()));
+        for (const auto& line_start : chunk.lines) {
+            write_bytes(out, static_cast<uint32_t>(line_start.offset));
+            write_bytes(out, line_start.line);
+        }
+
+        write_bytes(out, static_cast<uint32_t>(chunk.constants.size()));
+        for (const auto constant : chunk.constants) {
+            if (constant.is_number()) {
+                write_bytes(out, Constant_tag::number);
+                write_bytes(out, constant.as_number());
+            } else if (is_string(constant)) {
+                write_bytes(out, Constant_tag::string);
+                write_string(out, as_string(constant)->str);
+            } else if (is_obj_type(constant, Obj_type::function)) {
+                write_bytes(out, Constant_tag::function);
+                if (!write_function(out, *as_function(constant))) {
+                    return false;
+                }
+            } else {
+                return false;
+            }
+        }
+
+        // Only the name of each property cache is stored; caches always start out empty
+        write_bytes(out, static_cast<uint32_t>(chunk.property_caches.size()));
+        for (const auto& cache : chunk.property_caches) {
+            write_bytes(out, cache.name_constant);
+        }
+
+        return true;
+    }
+
+    // Reads values out of the mapped file, checking every read against the end, so a truncated or corrupt file is a
+    // miss rather than a crash
+    class Reader {
+        public:
+            explicit Reader(const char* begin, const char* end) :
+                pos_ {begin},
+                end_ {end}
+            {}
+
+            template<typename T>
+                T read() {
+                    T value;
+                    memcpy(&value, skip(sizeof(T)), sizeof(T));
+                    return value;
+                }
+
+            // Returns the start of the skipped bytes
+            const char* skip(size_t length) {
+                if (static_cast<size_t>(end_ - pos_) < length) {
+                    throw Script_cache_error{"Bytecode cache is truncated."};
+                }
+
+                const auto begin = pos_;
+                pos_ += length;
+
+                return begin;
+            }
+
+        private:
+            const char* pos_;
+            const char* end_;
+    };
+
+    string read_string(Reader& reader, uint32_t length) {
+        return string{reader.skip(length), length};
+    }
+
+    // Every object made while loading goes into `loaded`, which the caller keeps reachable until the whole script is
+    // built
+    Obj_function* read_function(Reader& reader, Heap& heap, vector<Obj*>& loaded) {
+        const auto function = heap.make<Obj_function>();
+        loaded.push_back(function);
+        function->arity = reader.read<uint32_t>();
+        function->upvalue_count = reader.read<uint32_t>();
+
+        const auto name_length = reader.read<uint32_t>();
+        if (name_length != no_name) {
+            function->name = heap.make_string(read_string(reader, name_length));
+        }
+
+        auto& chunk = function->chunk;
+
+        // The code is used in place, not copied
+        const auto code_size = reader.read<uint32_t>();
+        chunk.mapped_code = {reinterpret_cast<const uint8_t*>(reader.skip(code_size)), code_size};
+
+        const auto line_count = reader.read<uint32_t>();
+        chunk.lines.reserve(line_count);
+        for (uint32_t i = 0; i != line_count; ++i) {
+            const auto offset = reader.read<uint32_t>();
+            const auto line = reader.read<int>();
+            chunk.lines.push_back({offset, line});
+        }
+
+        const auto constant_count = reader.read<uint32_t>();
+        chunk.constants.reserve(constant_count);
+        for (uint32_t i = 0; i != constant_count; ++i) {
+            switch (reader.read<Constant_tag>()) {
+                case Constant_tag::function:
+                    chunk.constants.push_back(Value{read_function(reader, heap, loaded)});
+                    break;
+
+                case Constant_tag::number:
+                    chunk.constants.push_back(Value{reader.read<double>()});
+                    break;
+
+                case Constant_tag::string:
+                    chunk.constants.push_back(Value{heap.make_string(read_string(reader, reader.read<uint32_t>()))});
+                    break;
+
+                default:
+                    throw Script_cache_error{"Bytecode cache has an unknown constant."};
+            }
+        }
+
+        const auto cache_count = reader.read<uint32_t>();
+        chunk.property_caches.reserve(cache_count);
+        for (uint32_t i = 0; i != cache_count; ++i) {
+            Property_cache cache {};
+            cache.name_constant = reader.read<uint32_t>();
+            if (cache.name_constant >= chunk.constants.size() || !is_string(chunk.constants[cache.name_constant])) {
+                throw Script_cache_error{"Bytecode cache has a bad property name."};
+            }
+            chunk.property_caches.push_back(cache);
+        }
+
+        return function;
+    }
+}
+
+// Exported (external linkage)
+namespace motts { namespace lox {
+    unique_ptr<Mapped_script> load_script_cache(const string& cache_path, const string& source, Heap& heap) {
+        try {
+            auto mapped = std::make_unique<Mapped_script>();
+            mapped->file = file_mapping{cache_path.c_str(), read_only};
+            mapped->region = mapped_region{mapped->file, read_only};
+
+            const auto file_begin = static_cast<const char*>(mapped->region.get_address());
+            const auto file_end = file_begin + mapped->region.get_size();
+            Reader reader {file_begin, file_end};
+
+            const auto header = reader.read<Header>();
+            if (
+                memcmp(header.magic, magic, sizeof(magic)) != 0 ||
+                header.format_version != format_version ||
+                header.opcodes_hash != hash_opcodes() ||
+                header.compiler_version != compiler_version ||
+                header.source_length != source.size() ||
+                header.source_hash != hash_string(source.data(), source.size())
+            ) {
+                return nullptr;
+            }
+
+            const auto payload_begin = file_begin + sizeof(Header);
+            if (header.payload_checksum != hash_string(payload_begin, file_end - payload_begin)) {
+                return nullptr;
+            }
+
+            vector<Obj*> loaded;
+            heap.push_root_marker([&] () {
+                for (const auto object : loaded) {
+                    heap.mark(object);
+                }
+            });
+            const auto _ = finally([&] () {
+                heap.pop_root_marker();
+            });
+            mapped->script = read_function(reader, heap, loaded);
+
+            return mapped;
+        } catch (const interprocess_exception&) {
+            // Usually just that there's no cache file yet
+            return nullptr;
+        } catch (const Script_cache_error&) {
+            return nullptr;
+        }
+    }
+
+    void save_script_cache(const string& cache_path, const string& source, const Obj_function& script) {
+        string payload;
+        if (!write_function(payload, script)) {
+            // A constant the format doesn't know how to store; leave this script uncached
+            return;
+        }
+
+        Header header {};
+        memcpy(header.magic, magic, sizeof(magic));
+        header.format_version = format_version;
+        header.opcodes_hash = hash_opcodes();
+        header.compiler_version = compiler_version;
+        header.source_hash = hash_string(source.data(), source.size());
+        header.source_length = source.size();
+        header.payload_checksum = hash_string(payload.data(), payload.size());
+
+        // Processes warming the same script at once each write their own file, and whichever renames last wins with a
+        // complete cache. The process id keeps apart processes, and the random part keeps apart VMs in one process.
+        const auto temp_path =
+            cache_path + "." + to_string(get_current_process_id()) + "-" + to_string(random_device{}()) + ".tmp";
+
+        // IIFE to close the file before it's renamed
+        const auto written = ([&] () {
+            ofstream out {temp_path, ofstream::binary | ofstream::trunc};
+            out.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+            out.write(payload.data(), payload.size());
+            out.close();
+
+            return static_cast<bool>(out);
+        })();
+
+        if (!written || rename(temp_path.c_str(), cache_path.c_str()) != 0) {
+            remove(temp_path.c_str());
+        }
+    }
+}}
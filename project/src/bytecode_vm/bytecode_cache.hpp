@@ -0,0 +1,47 @@
+#pragma once
+
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+#include "chunk.hpp"
+#include "heap.hpp"
+#include "object.hpp"
+
+namespace motts { namespace lox {
+    /*
+    A compiled script can be cached on disk so that running the same script again skips scanning and compiling.
+
+    The file is a fixed-size header followed by the top-level script function. A function is its arity, upvalue count,
+    name, code, line table, and constant pool, and function constants nest that same layout. The header records the
+    format version, a hash of the opcode list (opcode numbers shift whenever opcodes are added), the compiler version
+    (the code emitted for the same source changes whenever codegen or the peephole pass does), a hash of the source the
+    script was compiled from, and a checksum of everything after the header. A cache is used only if all of those
+    match; anything else counts as a miss, and the caller compiles from source as usual.
+
+    The format is native-endian and is meant to be read back only on the machine that wrote it.
+    */
+
+    // A script loaded from a cache file. The code of the script and of every function in it is read in place from the
+    // mapped file, so the mapping must outlive them all.
+    struct Mapped_script {
+        boost::interprocess::file_mapping file;
+        boost::interprocess::mapped_region region;
+        Obj_function* script {};
+    };
+
+    // Returns null if there's no usable cache at the path for this source. Functions and string constants are made in
+    // the given heap.
+    std::unique_ptr<Mapped_script> load_script_cache(const std::string& cache_path, const std::string& source, Heap&);
+
+    // Best effort. The file is written under a temporary name and then renamed, so a reader never sees it half
+    // written. If it can't be written at all, then the next run just compiles again.
+    void save_script_cache(const std::string& cache_path, const std::string& source, const Obj_function& script);
+
+    struct Script_cache_error : std::runtime_error {
+        using std::runtime_error::runtime_error;
+    };
+}}
@@ -1,8 +1,12 @@
 #include "chunk.hpp"
+
+#include <algorithm>
+
 #include <gsl/gsl_util>
 
 using std::size_t;
 using std::uint8_t;
+using std::upper_bound;
 using std::vector;
 
 using gsl::narrow;
@@ -13,8 +17,10 @@ namespace motts { namespace lox {
     }
 
     void Chunk::bytecode_push_back(uint8_t byte, int line) {
+        if (lines.empty() || lines.back().line != line) {
+            lines.push_back({code.size(), line});
+        }
         code.push_back(byte);
-        lines.push_back(line);
     }
 
     void Chunk::bytecode_push_back(int byte, int line) {
@@ -30,8 +36,24 @@ namespace motts { namespace lox {
     }
 
     vector<Value>::size_type Chunk::constants_push_back(Value value) {
+        const auto found_offset = constant_offsets.find(value.bits());
+        if (found_offset != constant_offsets.end()) {
+            return found_offset->second;
+        }
+
         const auto offset = constants.size();
         constants.push_back(value);
+        constant_offsets.insert({value.bits(), offset});
+
         return offset;
     }
+
+    int Chunk::line_at(vector<uint8_t>::size_type offset) const {
+        // Find the last entry that starts at or before the offset
+        const auto found_next = upper_bound(lines.cbegin(), lines.cend(), offset, [] (auto offset, const auto& line_start) {
+            return offset < line_start.offset;
+        });
+
+        return (found_next - 1)->line;
+    }
 }}
@@ -2,42 +2,109 @@
 
 #include <cstddef>
 #include <cstdint>
+#include <cstring>
+#include <unordered_map>
 #include <vector>
 
+#include <gsl/span>
+
 #include "value.hpp"
 
 namespace motts { namespace lox {
+    // X-macro, so the VM can generate its dispatch table from the same list as the enum
+    #define MOTTS_LOX_OP_CODE_NAMES \
+        X(constant) X(constant_long) X(nil) X(true_) X(false_) X(pop) \
+        X(get_local) X(set_local) X(add_constant_to_local) \
+        X(get_global) X(get_global_long) X(define_global) X(define_global_long) X(set_global) X(set_global_long) \
+        X(get_upvalue) X(set_upvalue) \
+        X(get_property) X(set_property) X(get_super) \
+        X(equal) X(not_equal) X(greater) X(greater_equal) X(less) X(less_equal) \
+        X(add) X(subtract) X(multiply) X(divide) \
+        X(not_) X(negate) \
+        X(print) \
+        X(jump) X(jump_if_false) X(loop) \
+        X(call) X(invoke) X(super_invoke) X(closure) X(closure_long) X(close_upvalue) \
+        X(class_) X(class_long) X(inherit) X(method) X(method_long) \
+        X(return_)
+
     enum class Op_code {
-        constant,
-        nil,
-        true_,
-        false_,
-        pop,
-        get_local,
-        set_local,
-        get_global,
-        define_global,
-        set_global,
-        equal,
-        greater,
-        less,
-        add,
-        subtract,
-        multiply,
-        divide,
-        not_,
-        negate,
-        print,
-        jump,
-        jump_if_false,
-        loop,
-        return_
+        #define X(name) name,
+        MOTTS_LOX_OP_CODE_NAMES
+        #undef X
+    };
+
+    // Instructions that name a constant take a one-byte operand, which covers the first 256 constants. Their "_long"
+    // forms take a three-byte little-endian operand instead, for chunks with more constants than that.
+    constexpr std::uint32_t long_operand_max {0xff'ff'ff};
+
+    inline std::uint32_t read_long_operand(const std::uint8_t* operand) {
+        return operand[0] | (operand[1] << 8) | (operand[2] << 16);
+    }
+
+    // Jumps and loops take a two-byte operand. It's copied a byte at a time, because it's rarely aligned for a uint16.
+    inline std::uint16_t read_jump_operand(const std::uint8_t* operand) {
+        std::uint16_t jump_length;
+        std::memcpy(&jump_length, operand, sizeof(jump_length));
+
+        return jump_length;
+    }
+
+    inline void write_jump_operand(std::uint8_t* operand, std::uint16_t jump_length) {
+        std::memcpy(operand, &jump_length, sizeof(jump_length));
+    }
+
+    struct Obj_closure;
+    struct Obj_shape;
+
+    /*
+    Every instruction that names a property (get_property, set_property, invoke, get_super, and super_invoke) has its
+    own entry in its chunk's table of these, and the instruction's operand is the entry's index. Besides the property's
+    name, the entry remembers what the last lookup at that site found for the last shape it saw, so that when the
+    next instance has the same shape -- which at most sites it nearly always does -- the lookup is a compare and a
+    load. That's a monomorphic inline cache.
+    */
+    struct Property_cache {
+        std::uint32_t name_constant;
+
+        // The rest is filled in by the VM. Shape ids start at 1, so 0 means nothing is cached yet.
+        std::uint64_t shape_id {};
+
+        // Where the field is, if the property is a field
+        int slot {};
+
+        // The method, if the property is a method rather than a field
+        Obj_closure* method {};
+
+        // If a set_property adds a field, the shape the instance moves to
+        Obj_shape* next_shape {};
     };
 
     struct Chunk {
+        // Consecutive bytes almost always come from the same source line, so rather than store a line for every byte,
+        // store a line only where it changes. Each entry covers the code from its offset up to the next entry's.
+        struct Line_start {
+            std::vector<std::uint8_t>::size_type offset;
+            int line;
+        };
+
         std::vector<std::uint8_t> code;
-        std::vector<int> lines;
+        std::vector<Line_start> lines;
         std::vector<Value> constants;
+        std::vector<Property_cache> property_caches;
+
+        // A chunk loaded from the bytecode cache runs straight out of the memory-mapped cache file rather than out of
+        // `code`, which stays empty. This views the mapped bytes, and the mapping must outlive the chunk.
+        gsl::span<const std::uint8_t> mapped_code;
+
+        // The code to run, wherever it lives. Anything that reads code should go through here; only the compiler,
+        // which writes code, touches `code` directly.
+        gsl::span<const std::uint8_t> bytecode() const {
+            return mapped_code.empty() ? gsl::span<const std::uint8_t>{code} : mapped_code;
+        }
+
+        // Where each distinct constant already lives in the pool, keyed by the value's bits. Strings are interned, so
+        // equal strings have equal bits, and repeated literals and identifiers share one slot.
+        std::unordered_map<std::uint64_t, std::vector<Value>::size_type> constant_offsets;
 
         void bytecode_push_back(Op_code, int line);
         void bytecode_push_back(std::uint8_t byte, int line);
@@ -45,5 +112,8 @@ namespace motts { namespace lox {
         void bytecode_push_back(std::size_t byte, int line);
         void bytecode_push_back(std::ptrdiff_t byte, int line);
         std::vector<Value>::size_type constants_push_back(Value);
+
+        // The source line of the byte at `offset`
+        int line_at(std::vector<std::uint8_t>::size_type offset) const;
     };
 }}
@@ -3,6 +3,7 @@
 #include <algorithm>
 #include <cstdint>
 #include <functional>
+#include <limits>
 #include <utility>
 #include <vector>
 
@@ -10,14 +11,17 @@
 #include <gsl/gsl_util>
 
 #include "debug.hpp"
+#include "peephole.hpp"
 
 using std::find_if;
 using std::function;
 using std::move;
+using std::numeric_limits;
 using std::runtime_error;
 using std::string;
 using std::to_string;
 using std::uint16_t;
+using std::uint8_t;
 using std::vector;
 
 using boost::lexical_cast;
@@ -27,6 +31,9 @@ using gsl::narrow;
 using namespace motts::lox;
 
 namespace {
+    const string this_name {"this"};
+    const string super_name {"super"};
+
     enum class Precedence {
         none,
         assignment,  // =
@@ -49,12 +56,12 @@ namespace {
         };
 
         const vector<Parse_rule> rules_ {
-            { &Compiler::compile_grouping, nullptr,                    Precedence::none },   // LEFT_PAREN
+            { &Compiler::compile_grouping, &Compiler::compile_call,    Precedence::call },   // LEFT_PAREN
             { nullptr,                     nullptr,                    Precedence::none },   // RIGHT_PAREN
             { nullptr,                     nullptr,                    Precedence::none },   // LEFT_BRACE
             { nullptr,                     nullptr,                    Precedence::none },   // RIGHT_BRACE
             { nullptr,                     nullptr,                    Precedence::none },   // COMMA
-            { nullptr,                     nullptr,                    Precedence::none },   // DOT
+            { nullptr,                     &Compiler::compile_dot,     Precedence::call },   // DOT
             { &Compiler::compile_unary,    &Compiler::compile_binary,  Precedence::term },   // MINUS
             { nullptr,                     &Compiler::compile_binary,  Precedence::term },   // PLUS
             { nullptr,                     nullptr,                    Precedence::none },   // SEMICOLON
@@ -82,8 +89,8 @@ namespace {
             { nullptr,                     &Compiler::compile_or,      Precedence::or_ },   // OR
             { nullptr,                     nullptr,                    Precedence::none },   // PRINT
             { nullptr,                     nullptr,                    Precedence::none },   // RETURN
-            { nullptr,                     nullptr,                    Precedence::none },   // SUPER
-            { nullptr,                     nullptr,                    Precedence::none },   // THIS
+            { &Compiler::compile_super,    nullptr,                    Precedence::none },   // SUPER
+            { &Compiler::compile_this,     nullptr,                    Precedence::none },   // THIS
             { &Compiler::compile_literal,  nullptr,                    Precedence::none },   // TRUE
             { nullptr,                     nullptr,                    Precedence::none },   // VAR
             { nullptr,                     nullptr,                    Precedence::none },   // WHILE
@@ -96,20 +103,117 @@ namespace {
         }
 
         Token_iterator token_iter_;
-        Chunk chunk_;
+        Heap& heap_;
         function<void(const Compiler_error&)> on_resumable_error_;
 
+        // Once there's an error, the code will never run, and jumps in it may never have been patched
+        bool had_error_ {};
+
+        // Whether each function's code goes through the peephole pass once it's compiled
+        bool optimize_ {true};
+
+        enum class Function_kind {
+            function,
+            initializer,
+            method,
+            script
+        };
+
         struct Local {
             Token name;
             int n_stack_frame {};
+
+            // Captured locals are moved off the stack into their upvalue when they go out of scope
+            bool is_captured {};
         };
-        vector<Local> locals_;
-        int n_stack_frames_ {};
 
-        Compiler(const string& source, function<void(const Compiler_error&)> on_resumable_error) :
+        struct Upvalue {
+            // Slot of the enclosing function's local if is_local, or else index of the enclosing function's upvalue
+            int index;
+            bool is_local;
+        };
+
+        // Each function has its own locals and upvalues while it compiles. Function declarations nest, so the states
+        // form a stack through `enclosing`, and `current_` is the innermost.
+        struct Function_state {
+            Function_state* enclosing {};
+            Obj_function* function {};
+            Function_kind kind {};
+            vector<Local> locals;
+            vector<Upvalue> upvalues;
+            int n_stack_frames {};
+        };
+        Function_state* current_ {};
+
+        // Class declarations nest too, and `this` and `super` need to know whether they're inside one
+        struct Class_state {
+            Class_state* enclosing {};
+            bool has_superclass {};
+        };
+        Class_state* current_class_ {};
+
+        Compiler(const string& source, Heap& heap, function<void(const Compiler_error&)> on_resumable_error) :
             token_iter_ {source},
+            heap_ {heap},
             on_resumable_error_ {move(on_resumable_error)}
-        {}
+        {
+            // The functions being compiled aren't reachable from anything the VM knows about yet
+            heap_.push_root_marker([this] () {
+                for (auto state = current_; state; state = state->enclosing) {
+                    heap_.mark(state->function);
+                }
+            });
+        }
+
+        ~Compiler() {
+            heap_.pop_root_marker();
+        }
+
+        Compiler(const Compiler&) = delete;
+        Compiler& operator=(const Compiler&) = delete;
+
+        // A token for a name that doesn't appear in the source, such as the implicit `this`
+        Token make_token(Token_type type, const string& text) {
+            return Token{type, text.cbegin(), text.cend(), token_iter_->line};
+        }
+
+        Chunk& chunk() {
+            return current_->function->chunk;
+        }
+
+        void push_function_state(Function_state& state, Function_kind kind) {
+            state.enclosing = current_;
+            state.function = heap_.make<Obj_function>();
+            state.kind = kind;
+
+            // Slot zero of every call frame holds the function being called, or for methods, the receiver. In methods,
+            // it's the local `this`. Otherwise, reserve it with a local that has an empty name, so no code can refer
+            // to it.
+            if (kind == Function_kind::method || kind == Function_kind::initializer) {
+                state.locals.push_back({make_token(Token_type::this_, this_name)});
+            } else {
+                state.locals.push_back({Token{Token_type::identifier, token_iter_->begin, token_iter_->begin, token_iter_->line}});
+            }
+
+            current_ = &state;
+        }
+
+        Obj_function* pop_function_state() {
+            emit_implicit_return(token_iter_->line);
+
+            const auto function = current_->function;
+            if (optimize_ && !had_error_) {
+                optimize_peephole(function->chunk);
+            }
+
+            #ifdef MOTTS_LOX_DEBUG_PRINT_CODE
+                disassemble_chunk(function->chunk, function->name ? function->name->str : "<script>");
+            #endif
+
+            current_ = current_->enclosing;
+
+            return function;
+        }
 
         void compile_precedence_or_higher(Precedence min_precedence) {
             const auto can_assign = min_precedence <= Precedence::assignment;
@@ -134,41 +238,86 @@ namespace {
         }
 
         void pop_stack_frame() {
-            while (!locals_.empty() && locals_.back().n_stack_frame == n_stack_frames_) {
-                chunk_.bytecode_push_back(Op_code::pop, token_iter_->line);
-                locals_.pop_back();
+            while (!current_->locals.empty() && current_->locals.back().n_stack_frame == current_->n_stack_frames) {
+                chunk().bytecode_push_back(
+                    current_->locals.back().is_captured ? Op_code::close_upvalue : Op_code::pop,
+                    token_iter_->line
+                );
+                current_->locals.pop_back();
             }
-            --n_stack_frames_;
+            --current_->n_stack_frames;
         }
 
         auto emit_jump(Op_code jump_kind) {
-            const auto jump_instruction_offset = chunk_.code.size();
+            const auto jump_instruction_offset = chunk().code.size();
 
-            chunk_.bytecode_push_back(jump_kind, token_iter_->line);
-            chunk_.bytecode_push_back(0xff, token_iter_->line);
-            chunk_.bytecode_push_back(0xff, token_iter_->line);
+            chunk().bytecode_push_back(jump_kind, token_iter_->line);
+            chunk().bytecode_push_back(0xff, token_iter_->line);
+            chunk().bytecode_push_back(0xff, token_iter_->line);
 
             return jump_instruction_offset;
         }
 
         void patch_jump(int jump_instruction_offset) {
-            patch_jump(jump_instruction_offset, chunk_.code.size() - jump_instruction_offset - 3);
+            patch_jump(jump_instruction_offset, chunk().code.size() - jump_instruction_offset - 3);
         }
 
         void patch_jump(int jump_instruction_offset, int jump_length) {
-            // DANGER! Reinterpret cast: After a jump instruction, there will be two adjacent bytes
-            // that are supposed to represent a single uint16 number
-            reinterpret_cast<uint16_t&>(chunk_.code.at(jump_instruction_offset + 1)) = narrow<uint16_t>(jump_length);
+            if (jump_length > numeric_limits<uint16_t>::max()) {
+                throw Compiler_error{*token_iter_, "Too much code to jump over."};
+            }
+
+            write_jump_operand(&chunk().code.at(jump_instruction_offset + 1), narrow<uint16_t>(jump_length));
+        }
+
+        // Gives the instruction its own property cache entry, which names the property, and emits the instruction with
+        // the entry's index as its operand
+        void emit_property_instruction(Op_code opcode, const string& property_name, int line) {
+            const auto name_constant = chunk().constants_push_back(make_string(property_name));
+
+            const auto cache_index = chunk().property_caches.size();
+            if (cache_index > long_operand_max) {
+                throw Compiler_error{*token_iter_, "Too many property accesses in one function."};
+            }
+            chunk().property_caches.push_back({narrow<uint32_t>(name_constant)});
+
+            chunk().bytecode_push_back(opcode, line);
+            chunk().bytecode_push_back(cache_index & 0xff, line);
+            chunk().bytecode_push_back((cache_index >> 8) & 0xff, line);
+            chunk().bytecode_push_back((cache_index >> 16) & 0xff, line);
+        }
+
+        // Adds the constant to the pool and emits an instruction that names it, picking the short form when the
+        // constant's offset fits in one byte and the long form otherwise
+        void emit_constant_instruction(Op_code opcode, Op_code long_opcode, Value constant, int line) {
+            const auto offset = chunk().constants_push_back(constant);
+
+            if (offset <= numeric_limits<uint8_t>::max()) {
+                chunk().bytecode_push_back(opcode, line);
+                chunk().bytecode_push_back(offset, line);
+            } else if (offset <= long_operand_max) {
+                chunk().bytecode_push_back(long_opcode, line);
+                chunk().bytecode_push_back(offset & 0xff, line);
+                chunk().bytecode_push_back((offset >> 8) & 0xff, line);
+                chunk().bytecode_push_back((offset >> 16) & 0xff, line);
+            } else {
+                throw Compiler_error{*token_iter_, "Too many constants in one chunk."};
+            }
         }
 
         void compile_declaration() {
             try {
-                if (token_iter_->type == Token_type::var) {
+                if (token_iter_->type == Token_type::class_) {
+                    compile_class_declaration();
+                } else if (token_iter_->type == Token_type::fun) {
+                    compile_fun_declaration();
+                } else if (token_iter_->type == Token_type::var) {
                     compile_var_declaration();
                 } else {
                     compile_statement();
                 }
             } catch (const Compiler_error& error) {
+                had_error_ = true;
                 on_resumable_error_(error);
                 recover_to_synchronization_point();
             }
@@ -181,10 +330,12 @@ namespace {
                 compile_for_statement();
             } else if (token_iter_->type == Token_type::if_) {
                 compile_if_statement();
+            } else if (token_iter_->type == Token_type::return_) {
+                compile_return_statement();
             } else if (token_iter_->type == Token_type::while_) {
                 compile_while_statement();
             } else if (token_iter_->type == Token_type::left_brace) {
-                ++n_stack_frames_;
+                ++current_->n_stack_frames;
                 const auto _ = finally([&] () {
                     pop_stack_frame();
                 });
@@ -201,27 +352,27 @@ namespace {
 
             compile_expression();
             consume(Token_type::semicolon, "Expected ';' after value.");
-            chunk_.bytecode_push_back(Op_code::print, line);
+            chunk().bytecode_push_back(Op_code::print, line);
         }
 
         void compile_while_statement() {
             const auto line = token_iter_->line;
             ++token_iter_;
 
-            const auto loop_start_offset = chunk_.code.size();
+            const auto loop_start_offset = chunk().code.size();
             consume(Token_type::left_paren, "Expected '(' after 'while'.");
             compile_expression();
             consume(Token_type::right_paren, "Expected ')' after condition.");
             const auto exit_placeholder_offset = emit_jump(Op_code::jump_if_false);
 
-            chunk_.bytecode_push_back(Op_code::pop, line);
+            chunk().bytecode_push_back(Op_code::pop, line);
             compile_statement();
-            const auto jump_length = chunk_.code.size() - loop_start_offset;
+            const auto jump_length = chunk().code.size() - loop_start_offset;
             const auto loop_placeholder_offset = emit_jump(Op_code::loop);
             patch_jump(loop_placeholder_offset, jump_length);
 
             patch_jump(exit_placeholder_offset);
-            chunk_.bytecode_push_back(Op_code::pop, line);
+            chunk().bytecode_push_back(Op_code::pop, line);
         }
 
         void compile_expression() {
@@ -243,16 +394,8 @@ namespace {
             const auto var_name = string{token_iter_->begin, token_iter_->end};
 
             // Stack frame 0 means global
-            if (n_stack_frames_ != 0) {
-                // It's an error to have two variables with the same name in the same local scope
-                const auto found_same_name = find_if(locals_.cbegin(), locals_.cend(), [&] (const auto& local) {
-                    return local.n_stack_frame == n_stack_frames_ && string{local.name.begin, local.name.end} == var_name;
-                });
-                if (found_same_name != locals_.cend()) {
-                    throw Compiler_error{*token_iter_, "Variable with this name already declared in this scope."};
-                }
-
-                locals_.push_back({*token_iter_, -1});
+            if (current_->n_stack_frames != 0) {
+                declare_local(*token_iter_);
             }
 
             consume(Token_type::identifier, "Expected variable name.");
@@ -260,32 +403,299 @@ namespace {
             if (consume_if_match(Token_type::equal)) {
                 compile_expression();
             } else {
-                chunk_.bytecode_push_back(Op_code::nil, line);
+                chunk().bytecode_push_back(Op_code::nil, line);
             }
             consume(Token_type::semicolon, "Expected ';' after variable declaration.");
 
-            if (n_stack_frames_ != 0) {
-                locals_.back().n_stack_frame = n_stack_frames_;
+            if (current_->n_stack_frames != 0) {
+                current_->locals.back().n_stack_frame = current_->n_stack_frames;
+            } else {
+                emit_constant_instruction(Op_code::define_global, Op_code::define_global_long, make_string(var_name), line);
+            }
+        }
+
+        // Adds a local to the current scope but leaves it uninitialized (stack frame -1), so that the variable's
+        // initializer can't refer to the variable itself
+        void declare_local(const Token& name) {
+            const auto var_name = string{name.begin, name.end};
+
+            // It's an error to have two variables with the same name in the same local scope
+            const auto found_same_name = find_if(current_->locals.cbegin(), current_->locals.cend(), [&] (const auto& local) {
+                return local.n_stack_frame == current_->n_stack_frames && string{local.name.begin, local.name.end} == var_name;
+            });
+            if (found_same_name != current_->locals.cend()) {
+                throw Compiler_error{name, "Variable with this name already declared in this scope."};
+            }
+
+            // Locals are addressed with a one-byte slot operand
+            if (current_->locals.size() > numeric_limits<uint8_t>::max()) {
+                throw Compiler_error{name, "Too many local variables in function."};
+            }
+
+            current_->locals.push_back({name, -1});
+        }
+
+        void compile_fun_declaration() {
+            const auto line = token_iter_->line;
+            ++token_iter_;
+
+            const auto fun_name = string{token_iter_->begin, token_iter_->end};
+
+            if (current_->n_stack_frames != 0) {
+                declare_local(*token_iter_);
+
+                // Unlike a variable, a function can refer to itself (to recurse), so it's initialized right away
+                current_->locals.back().n_stack_frame = current_->n_stack_frames;
+            }
+
+            consume(Token_type::identifier, "Expected function name.");
+            compile_function(Function_kind::function, fun_name, line);
+
+            if (current_->n_stack_frames == 0) {
+                emit_constant_instruction(Op_code::define_global, Op_code::define_global_long, make_string(fun_name), line);
+            }
+        }
+
+        void compile_function(Function_kind kind, const string& name, int line) {
+            Function_state state;
+            push_function_state(state, kind);
+            const auto _ = finally([&] () {
+                // If an error unwinds out of here, the enclosing function should pick up where it left off
+                current_ = state.enclosing;
+            });
+            state.function->name = heap_.make_string(string{name});
+
+            // The parameters and body share one scope. There's no need to pop it at the end, because returning
+            // discards the whole call frame.
+            ++current_->n_stack_frames;
+
+            consume(Token_type::left_paren, "Expected '(' after function name.");
+            if (token_iter_->type != Token_type::right_paren) {
+                do {
+                    if (++state.function->arity > numeric_limits<uint8_t>::max()) {
+                        throw Compiler_error{*token_iter_, "Cannot have more than 255 parameters."};
+                    }
+
+                    declare_local(*token_iter_);
+                    current_->locals.back().n_stack_frame = current_->n_stack_frames;
+                    consume(Token_type::identifier, "Expected parameter name.");
+                } while (consume_if_match(Token_type::comma));
+            }
+            consume(Token_type::right_paren, "Expected ')' after parameters.");
+
+            if (token_iter_->type != Token_type::left_brace) {
+                throw Compiler_error{*token_iter_, "Expected '{' before function body."};
+            }
+            compile_block();
+
+            const auto upvalues = move(state.upvalues);
+            const auto function = pop_function_state();
+
+            // The closure instruction is followed by a pair of operands for each variable the function captures
+            emit_constant_instruction(Op_code::closure, Op_code::closure_long, Value{function}, line);
+            for (const auto& upvalue : upvalues) {
+                chunk().bytecode_push_back(upvalue.is_local ? 1 : 0, line);
+                chunk().bytecode_push_back(upvalue.index, line);
+            }
+        }
+
+        // Falling off the end of a function returns nil, except that initializers always return `this`
+        void emit_implicit_return(int line) {
+            if (current_->kind == Function_kind::initializer) {
+                chunk().bytecode_push_back(Op_code::get_local, line);
+                chunk().bytecode_push_back(0, line);
+            } else {
+                chunk().bytecode_push_back(Op_code::nil, line);
+            }
+            chunk().bytecode_push_back(Op_code::return_, line);
+        }
+
+        void compile_return_statement() {
+            const auto return_token = *token_iter_;
+            ++token_iter_;
+
+            if (current_->kind == Function_kind::script) {
+                throw Compiler_error{return_token, "Cannot return from top-level code."};
+            }
+
+            if (consume_if_match(Token_type::semicolon)) {
+                emit_implicit_return(return_token.line);
+            } else {
+                if (current_->kind == Function_kind::initializer) {
+                    throw Compiler_error{return_token, "Cannot return a value from an initializer."};
+                }
+
+                compile_expression();
+                consume(Token_type::semicolon, "Expected ';' after return value.");
+                chunk().bytecode_push_back(Op_code::return_, return_token.line);
+            }
+        }
+
+        void compile_class_declaration() {
+            const auto line = token_iter_->line;
+            ++token_iter_;
+
+            const auto class_name_token = *token_iter_;
+            const auto class_name = string{class_name_token.begin, class_name_token.end};
+            if (current_->n_stack_frames != 0) {
+                declare_local(*token_iter_);
+            }
+            consume(Token_type::identifier, "Expected class name.");
+
+            emit_constant_instruction(Op_code::class_, Op_code::class_long, make_string(class_name), line);
+            if (current_->n_stack_frames != 0) {
+                current_->locals.back().n_stack_frame = current_->n_stack_frames;
+            } else {
+                emit_constant_instruction(Op_code::define_global, Op_code::define_global_long, make_string(class_name), line);
+            }
+
+            Class_state class_state {current_class_};
+            current_class_ = &class_state;
+            const auto _ = finally([&] () {
+                current_class_ = class_state.enclosing;
+            });
+
+            if (consume_if_match(Token_type::less)) {
+                if (token_iter_->type != Token_type::identifier) {
+                    throw Compiler_error{*token_iter_, "Expected superclass name."};
+                }
+                const auto superclass_name_token = *token_iter_;
+                if (string{superclass_name_token.begin, superclass_name_token.end} == class_name) {
+                    throw Compiler_error{superclass_name_token, "A class cannot inherit from itself."};
+                }
+                ++token_iter_;
+                compile_named_variable(superclass_name_token, false);
+
+                // Methods capture the superclass as a local named `super`, in a scope around the class body
+                ++current_->n_stack_frames;
+                current_->locals.push_back({make_token(Token_type::super, super_name), current_->n_stack_frames});
+
+                compile_named_variable(class_name_token, false);
+                chunk().bytecode_push_back(Op_code::inherit, line);
+                class_state.has_superclass = true;
+            }
+
+            // The method instructions expect the class on the stack
+            compile_named_variable(class_name_token, false);
+            consume(Token_type::left_brace, "Expected '{' before class body.");
+            while (token_iter_->type != Token_type::right_brace && token_iter_->type != Token_type::eof) {
+                compile_method();
+            }
+            consume(Token_type::right_brace, "Expected '}' after class body.");
+            chunk().bytecode_push_back(Op_code::pop, line);
+
+            if (class_state.has_superclass) {
+                pop_stack_frame();
+            }
+        }
+
+        void compile_method() {
+            const auto line = token_iter_->line;
+            const auto method_name = string{token_iter_->begin, token_iter_->end};
+            consume(Token_type::identifier, "Expected method name.");
+
+            compile_function(method_name == "init" ? Function_kind::initializer : Function_kind::method, method_name, line);
+            emit_constant_instruction(Op_code::method, Op_code::method_long, make_string(method_name), line);
+        }
+
+        // Expects the left paren to have been consumed already. Returns the argument count.
+        int compile_arguments() {
+            int arg_count {};
+            if (token_iter_->type != Token_type::right_paren) {
+                do {
+                    compile_expression();
+
+                    if (++arg_count > numeric_limits<uint8_t>::max()) {
+                        throw Compiler_error{*token_iter_, "Cannot have more than 255 arguments."};
+                    }
+                } while (consume_if_match(Token_type::comma));
+            }
+            consume(Token_type::right_paren, "Expected ')' after arguments.");
+
+            return arg_count;
+        }
+
+        void compile_call(bool /*can_assign*/) {
+            const auto line = token_iter_->line;
+            ++token_iter_;
+
+            const auto arg_count = compile_arguments();
+            chunk().bytecode_push_back(Op_code::call, line);
+            chunk().bytecode_push_back(arg_count, line);
+        }
+
+        void compile_dot(bool can_assign) {
+            const auto line = token_iter_->line;
+            ++token_iter_;
+
+            const auto property_name = string{token_iter_->begin, token_iter_->end};
+            consume(Token_type::identifier, "Expected property name after '.'.");
+
+            if (can_assign && consume_if_match(Token_type::equal)) {
+                compile_expression();
+                emit_property_instruction(Op_code::set_property, property_name, line);
+            } else if (consume_if_match(Token_type::left_paren)) {
+                // A method call is fused into one instruction, so calling a method doesn't make a bound method
+                const auto arg_count = compile_arguments();
+                emit_property_instruction(Op_code::invoke, property_name, line);
+                chunk().bytecode_push_back(arg_count, line);
+            } else {
+                emit_property_instruction(Op_code::get_property, property_name, line);
+            }
+        }
+
+        void compile_this(bool /*can_assign*/) {
+            if (!current_class_) {
+                throw Compiler_error{*token_iter_, "Cannot use 'this' outside of a class."};
+            }
+
+            ++token_iter_;
+            compile_named_variable(make_token(Token_type::this_, this_name), false);
+        }
+
+        void compile_super(bool /*can_assign*/) {
+            if (!current_class_) {
+                throw Compiler_error{*token_iter_, "Cannot use 'super' outside of a class."};
+            }
+            if (!current_class_->has_superclass) {
+                throw Compiler_error{*token_iter_, "Cannot use 'super' in a class with no superclass."};
+            }
+
+            const auto line = token_iter_->line;
+            ++token_iter_;
+            consume(Token_type::dot, "Expected '.' after 'super'.");
+            const auto method_name = string{token_iter_->begin, token_iter_->end};
+            consume(Token_type::identifier, "Expected superclass method name.");
+
+            compile_named_variable(make_token(Token_type::this_, this_name), false);
+            if (consume_if_match(Token_type::left_paren)) {
+                const auto arg_count = compile_arguments();
+                compile_named_variable(make_token(Token_type::super, super_name), false);
+                emit_property_instruction(Op_code::super_invoke, method_name, line);
+                chunk().bytecode_push_back(arg_count, line);
             } else {
-                const auto identifier_offset = chunk_.constants_push_back(Value{var_name});
-                chunk_.bytecode_push_back(Op_code::define_global, line);
-                chunk_.bytecode_push_back(identifier_offset, line);
+                compile_named_variable(make_token(Token_type::super, super_name), false);
+                emit_property_instruction(Op_code::get_super, method_name, line);
             }
         }
 
         void compile_and(bool /*can_assign*/) {
+            ++token_iter_;
+
             const auto exit_placeholder_offset = emit_jump(Op_code::jump_if_false);
-            chunk_.bytecode_push_back(Op_code::pop, token_iter_->line);
+            chunk().bytecode_push_back(Op_code::pop, token_iter_->line);
             compile_precedence_or_higher(Precedence::and_);
             patch_jump(exit_placeholder_offset);
         }
 
         void compile_or(bool /*can_assign*/) {
+            ++token_iter_;
+
             const auto else_placeholder_offset = emit_jump(Op_code::jump_if_false);
             const auto exit_placeholder_offset = emit_jump(Op_code::jump);
 
             patch_jump(else_placeholder_offset);
-            chunk_.bytecode_push_back(Op_code::pop, token_iter_->line);
+            chunk().bytecode_push_back(Op_code::pop, token_iter_->line);
             compile_precedence_or_higher(Precedence::or_);
 
             patch_jump(exit_placeholder_offset);
@@ -295,14 +705,14 @@ namespace {
             compile_expression();
             const auto line = token_iter_->line;
             consume(Token_type::semicolon, "Expected ';' after expression.");
-            chunk_.bytecode_push_back(Op_code::pop, line);
+            chunk().bytecode_push_back(Op_code::pop, line);
         }
 
         void compile_for_statement() {
             ++token_iter_;
 
             // If a for statement declares a variable, that variable should be scoped to the loop body
-            ++n_stack_frames_;
+            ++current_->n_stack_frames;
             const auto _ = finally([&] () {
                 pop_stack_frame();
             });
@@ -317,7 +727,7 @@ namespace {
                 compile_expression_statement();
             }
 
-            const auto condition_expression_offset = chunk_.code.size();
+            const auto condition_expression_offset = chunk().code.size();
             const auto empty_offset_sentinel = -1;
 
             const auto jump_to_exit_offset = ([&] () {
@@ -327,7 +737,7 @@ namespace {
 
                 compile_expression();
                 const auto jump_to_exit_offset = narrow<int>(emit_jump(Op_code::jump_if_false));
-                chunk_.bytecode_push_back(Op_code::pop, token_iter_->line);
+                chunk().bytecode_push_back(Op_code::pop, token_iter_->line);
                 consume(Token_type::semicolon, "Expected ';' after loop condition.");
 
                 return jump_to_exit_offset;
@@ -340,12 +750,12 @@ namespace {
 
                 const auto jump_to_body_offset = emit_jump(Op_code::jump);
 
-                const auto increment_expression_offset = narrow<int>(chunk_.code.size());
+                const auto increment_expression_offset = narrow<int>(chunk().code.size());
                 compile_expression();
-                chunk_.bytecode_push_back(Op_code::pop, token_iter_->line);
+                chunk().bytecode_push_back(Op_code::pop, token_iter_->line);
                 consume(Token_type::right_paren, "Expected ')' after for clauses.");
 
-                const auto loop_to_condition_length = chunk_.code.size() - condition_expression_offset;
+                const auto loop_to_condition_length = chunk().code.size() - condition_expression_offset;
                 const auto loop_to_condition_offset = emit_jump(Op_code::loop);
                 patch_jump(loop_to_condition_offset, loop_to_condition_length);
 
@@ -357,7 +767,7 @@ namespace {
             const auto line = token_iter_->line;
             compile_statement();
 
-            const auto loop_length = chunk_.code.size() - (
+            const auto loop_length = chunk().code.size() - (
                 increment_expression_offset != empty_offset_sentinel ?
                     increment_expression_offset :
                     condition_expression_offset
@@ -367,7 +777,7 @@ namespace {
 
             if (jump_to_exit_offset != empty_offset_sentinel) {
                 patch_jump(jump_to_exit_offset);
-                chunk_.bytecode_push_back(Op_code::pop, line);
+                chunk().bytecode_push_back(Op_code::pop, line);
             }
         }
 
@@ -380,12 +790,12 @@ namespace {
             consume(Token_type::right_paren, "Expected ')' after 'condition'.");
             const auto else_placeholder_offset = emit_jump(Op_code::jump_if_false);
 
-            chunk_.bytecode_push_back(Op_code::pop, line);
+            chunk().bytecode_push_back(Op_code::pop, line);
             compile_statement();
             const auto exit_placeholder_offset = emit_jump(Op_code::jump);
 
             patch_jump(else_placeholder_offset);
-            chunk_.bytecode_push_back(Op_code::pop, line);
+            chunk().bytecode_push_back(Op_code::pop, line);
             if (consume_if_match(Token_type::else_)) {
                 compile_statement();
             }
@@ -400,57 +810,108 @@ namespace {
 
         void compile_number(bool /*can_assign*/) {
             const auto value = lexical_cast<double>(string{token_iter_->begin, token_iter_->end});
-            const auto offset = chunk_.constants_push_back(Value{value});
-
-            chunk_.bytecode_push_back(Op_code::constant, token_iter_->line);
-            chunk_.bytecode_push_back(offset, token_iter_->line);
+            emit_constant_instruction(Op_code::constant, Op_code::constant_long, Value{value}, token_iter_->line);
 
             ++token_iter_;
         }
 
         void compile_string(bool /*can_assign*/) {
             // The +1 and -1 parts trim the leading and trailing quotation marks
-            const auto offset = chunk_.constants_push_back(Value{string{token_iter_->begin + 1, token_iter_->end - 1}});
-
-            chunk_.bytecode_push_back(Op_code::constant, token_iter_->line);
-            chunk_.bytecode_push_back(offset, token_iter_->line);
+            emit_constant_instruction(
+                Op_code::constant,
+                Op_code::constant_long,
+                make_string(string{token_iter_->begin + 1, token_iter_->end - 1}),
+                token_iter_->line
+            );
 
             ++token_iter_;
         }
 
-        void compile_variable(bool can_assign) {
-            const auto var_name = string{token_iter_->begin, token_iter_->end};
-            const auto found_local = find_if(locals_.crbegin(), locals_.crend(), [&] (const auto& local) {
+        // Returns the local's slot, or -1 if the function has no local with that name
+        int resolve_local(const Function_state& state, const Token& name) {
+            const auto var_name = string{name.begin, name.end};
+            const auto found_local = find_if(state.locals.crbegin(), state.locals.crend(), [&] (const auto& local) {
                 return string{local.name.begin, local.name.end} == var_name;
             });
+            if (found_local == state.locals.crend()) {
+                return -1;
+            }
 
-            if (found_local != locals_.crend() && found_local->n_stack_frame == -1) {
-                throw Compiler_error{*token_iter_, "Cannot read local variable in its own initializer."};
+            if (found_local->n_stack_frame == -1) {
+                throw Compiler_error{name, "Cannot read local variable in its own initializer."};
             }
 
-            const auto line = token_iter_->line;
+            return found_local.base() - state.locals.cbegin() - 1;
+        }
+
+        // Looks for the variable in each enclosing function in turn, and threads an upvalue through every function
+        // in between. Returns the upvalue's index, or -1 if no enclosing function has a local with that name.
+        int resolve_upvalue(Function_state& state, const Token& name) {
+            if (!state.enclosing) {
+                return -1;
+            }
+
+            const auto enclosing_local = resolve_local(*state.enclosing, name);
+            if (enclosing_local != -1) {
+                state.enclosing->locals.at(enclosing_local).is_captured = true;
+                return add_upvalue(state, enclosing_local, true);
+            }
+
+            const auto enclosing_upvalue = resolve_upvalue(*state.enclosing, name);
+            if (enclosing_upvalue != -1) {
+                return add_upvalue(state, enclosing_upvalue, false);
+            }
+
+            return -1;
+        }
+
+        int add_upvalue(Function_state& state, int index, bool is_local) {
+            // A closure that refers to the same variable several times captures it just once
+            const auto found_upvalue = find_if(state.upvalues.cbegin(), state.upvalues.cend(), [&] (const auto& upvalue) {
+                return upvalue.index == index && upvalue.is_local == is_local;
+            });
+            if (found_upvalue != state.upvalues.cend()) {
+                return found_upvalue - state.upvalues.cbegin();
+            }
+
+            if (state.upvalues.size() > numeric_limits<uint8_t>::max()) {
+                throw Compiler_error{*token_iter_, "Too many closure variables in function."};
+            }
+
+            state.upvalues.push_back({index, is_local});
+            state.function->upvalue_count = state.upvalues.size();
+
+            return state.upvalues.size() - 1;
+        }
+
+        void compile_variable(bool can_assign) {
+            const auto name = *token_iter_;
             ++token_iter_;
 
-            if (can_assign && consume_if_match(Token_type::equal)) {
-                compile_expression();
+            compile_named_variable(name, can_assign);
+        }
 
-                if (found_local != locals_.crend()) {
-                    chunk_.bytecode_push_back(Op_code::set_local, line);
-                } else {
-                    chunk_.bytecode_push_back(Op_code::set_global, line);
-                }
-            } else {
-                if (found_local != locals_.crend()) {
-                    chunk_.bytecode_push_back(Op_code::get_local, line);
-                } else {
-                    chunk_.bytecode_push_back(Op_code::get_global, line);
-                }
+        void compile_named_variable(const Token& name, bool can_assign) {
+            const auto var_name = string{name.begin, name.end};
+            const auto line = name.line;
+            const auto local_slot = resolve_local(*current_, name);
+            const auto upvalue_index = local_slot == -1 ? resolve_upvalue(*current_, name) : -1;
+
+            const auto is_assignment = can_assign && consume_if_match(Token_type::equal);
+            if (is_assignment) {
+                compile_expression();
             }
 
-            if (found_local != locals_.crend()) {
-                chunk_.bytecode_push_back(found_local.base() - locals_.crend().base() - 1, line);
+            if (local_slot != -1) {
+                chunk().bytecode_push_back(is_assignment ? Op_code::set_local : Op_code::get_local, line);
+                chunk().bytecode_push_back(local_slot, line);
+            } else if (upvalue_index != -1) {
+                chunk().bytecode_push_back(is_assignment ? Op_code::set_upvalue : Op_code::get_upvalue, line);
+                chunk().bytecode_push_back(upvalue_index, line);
+            } else if (is_assignment) {
+                emit_constant_instruction(Op_code::set_global, Op_code::set_global_long, make_string(var_name), line);
             } else {
-                chunk_.bytecode_push_back(chunk_.constants_push_back(Value{var_name}), line);
+                emit_constant_instruction(Op_code::get_global, Op_code::get_global_long, make_string(var_name), line);
             }
         }
 
@@ -463,11 +924,11 @@ namespace {
 
             switch (op.type) {
                 case Token_type::bang:
-                    chunk_.bytecode_push_back(Op_code::not_, op.line);
+                    chunk().bytecode_push_back(Op_code::not_, op.line);
                     break;
 
                 case Token_type::minus:
-                    chunk_.bytecode_push_back(Op_code::negate, op.line);
+                    chunk().bytecode_push_back(Op_code::negate, op.line);
                     break;
 
                 default:
@@ -486,46 +947,46 @@ namespace {
 
             switch (op.type) {
                 case Token_type::bang_equal:
-                    chunk_.bytecode_push_back(Op_code::equal, op.line);
-                    chunk_.bytecode_push_back(Op_code::not_, op.line);
+                    chunk().bytecode_push_back(Op_code::equal, op.line);
+                    chunk().bytecode_push_back(Op_code::not_, op.line);
                     break;
 
                 case Token_type::equal_equal:
-                    chunk_.bytecode_push_back(Op_code::equal, op.line);
+                    chunk().bytecode_push_back(Op_code::equal, op.line);
                     break;
 
                 case Token_type::greater:
-                    chunk_.bytecode_push_back(Op_code::greater, op.line);
+                    chunk().bytecode_push_back(Op_code::greater, op.line);
                     break;
 
                 case Token_type::greater_equal:
-                    chunk_.bytecode_push_back(Op_code::less, op.line);
-                    chunk_.bytecode_push_back(Op_code::not_, op.line);
+                    chunk().bytecode_push_back(Op_code::less, op.line);
+                    chunk().bytecode_push_back(Op_code::not_, op.line);
                     break;
 
                 case Token_type::less:
-                    chunk_.bytecode_push_back(Op_code::less, op.line);
+                    chunk().bytecode_push_back(Op_code::less, op.line);
                     break;
 
                 case Token_type::less_equal:
-                    chunk_.bytecode_push_back(Op_code::greater, op.line);
-                    chunk_.bytecode_push_back(Op_code::not_, op.line);
+                    chunk().bytecode_push_back(Op_code::greater, op.line);
+                    chunk().bytecode_push_back(Op_code::not_, op.line);
                     break;
 
                 case Token_type::plus:
-                    chunk_.bytecode_push_back(Op_code::add, op.line);
+                    chunk().bytecode_push_back(Op_code::add, op.line);
                     break;
 
                 case Token_type::minus:
-                    chunk_.bytecode_push_back(Op_code::subtract, op.line);
+                    chunk().bytecode_push_back(Op_code::subtract, op.line);
                     break;
 
                 case Token_type::star:
-                    chunk_.bytecode_push_back(Op_code::multiply, op.line);
+                    chunk().bytecode_push_back(Op_code::multiply, op.line);
                     break;
 
                 case Token_type::slash:
-                    chunk_.bytecode_push_back(Op_code::divide, op.line);
+                    chunk().bytecode_push_back(Op_code::divide, op.line);
                     break;
 
                 default:
@@ -536,15 +997,15 @@ namespace {
         void compile_literal(bool /*can_assign*/) {
             switch (token_iter_->type) {
                 case Token_type::false_:
-                    chunk_.bytecode_push_back(Op_code::false_, token_iter_->line);
+                    chunk().bytecode_push_back(Op_code::false_, token_iter_->line);
                     break;
 
                 case Token_type::nil:
-                    chunk_.bytecode_push_back(Op_code::nil, token_iter_->line);
+                    chunk().bytecode_push_back(Op_code::nil, token_iter_->line);
                     break;
 
                 case Token_type::true_:
-                    chunk_.bytecode_push_back(Op_code::true_, token_iter_->line);
+                    chunk().bytecode_push_back(Op_code::true_, token_iter_->line);
                     break;
 
                 default:
@@ -554,6 +1015,10 @@ namespace {
             ++token_iter_;
         }
 
+        Value make_string(string str) {
+            return Value{heap_.make_string(move(str))};
+        }
+
         void consume(Token_type type, const string& message) {
             if (token_iter_->type != type) {
                 throw Compiler_error{*token_iter_, message};
@@ -597,28 +1062,31 @@ namespace {
 }
 
 namespace motts { namespace lox {
-    Chunk compile(const string& source) {
+    Obj_function* compile(const string& source, Heap& heap, bool optimize) {
         string compiler_errors;
         Compiler compiler {
             source,
+            heap,
             [&] (const Compiler_error& error) {
                 compiler_errors += error.what();
                 compiler_errors += "\n";
             }
         };
+        compiler.optimize_ = optimize;
+        Compiler::Function_state script_state;
+        compiler.push_function_state(script_state, Compiler::Function_kind::script);
+
         while (compiler.token_iter_->type != Token_type::eof) {
             compiler.compile_declaration();
         }
         compiler.consume(Token_type::eof, "Expected end of expression.");
-        compiler.chunk_.bytecode_push_back(Op_code::return_, 0);
+        const auto script = compiler.pop_function_state();
 
         if (!compiler_errors.empty()) {
             throw Compiler_error{compiler_errors};
         }
 
-        disassemble_chunk(compiler.chunk_, "code");
-
-        return move(compiler.chunk_);
+        return script;
     }
 
     Compiler_error::Compiler_error(const Token& token, const string& what) :
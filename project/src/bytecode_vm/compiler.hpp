@@ -1,13 +1,23 @@
 #pragma once
 
+#include <cstdint>
 #include <stdexcept>
 #include <string>
 
 #include "chunk.hpp"
+#include "heap.hpp"
+#include "object.hpp"
 #include "scanner.hpp"
 
 namespace motts { namespace lox {
-    Chunk compile(const std::string& source);
+    // Bump whenever the compiler or the peephole pass would emit different code for the same source, so that bytecode
+    // cached by an older build is compiled again rather than run
+    constexpr std::uint32_t compiler_version {1};
+
+    // Returns the top-level script as a function. It and every object it refers to are allocated on the given heap.
+    // Without `optimize`, the code is left as the compiler emitted it, which is only useful for seeing what the peephole
+    // pass saves.
+    Obj_function* compile(const std::string& source, Heap&, bool optimize = true);
 
     struct Compiler_error : std::runtime_error {
         using std::runtime_error::runtime_error;
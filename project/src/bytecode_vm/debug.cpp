@@ -3,13 +3,14 @@
 #include <iomanip>
 #include <iostream>
 
+#include "object.hpp"
+
 using std::cout;
 using std::left;
 using std::right;
 using std::setfill;
 using std::setw;
 using std::string;
-using std::uint16_t;
 
 using namespace motts::lox;
 
@@ -21,7 +22,7 @@ namespace {
     }
 
     int constant_instruction(const string& name, const Chunk& chunk, int code_offset) {
-        const auto constant_offset = chunk.code.at(code_offset + 1);
+        const auto constant_offset = chunk.bytecode().at(code_offset + 1);
         cout <<
             setw(16) << setfill(' ') << left << name << " " <<
             setw(4) << setfill('0') << right << static_cast<int>(constant_offset) << " '";
@@ -31,8 +32,74 @@ namespace {
         return 2;
     }
 
+    int constant_long_instruction(const string& name, const Chunk& chunk, int code_offset) {
+        const auto constant_offset = read_long_operand(&chunk.bytecode().at(code_offset + 1));
+        cout <<
+            setw(16) << setfill(' ') << left << name << " " <<
+            setw(4) << setfill('0') << right << constant_offset << " '";
+        print_value(chunk.constants.at(constant_offset));
+        cout << "'\n";
+
+        return 4;
+    }
+
+    int closure_instruction(const string& name, const Chunk& chunk, int code_offset, bool is_long) {
+        const auto code = chunk.bytecode();
+        const auto function_offset = is_long ? read_long_operand(&code.at(code_offset + 1)) : code.at(code_offset + 1);
+        const auto function = as_function(chunk.constants.at(function_offset));
+        cout <<
+            setw(16) << setfill(' ') << left << name << " " <<
+            setw(4) << setfill('0') << right << function_offset << " ";
+        print_value(Value{function});
+        cout << "\n";
+
+        // Each captured variable is a pair of bytes after the function operand
+        auto operand_offset = code_offset + (is_long ? 4 : 2);
+        for (auto i = 0; i != function->upvalue_count; ++i) {
+            const auto is_local = code.at(operand_offset);
+            const auto index = code.at(operand_offset + 1);
+            cout <<
+                setw(4) << setfill('0') << right << operand_offset << "    |                     " <<
+                (is_local ? "local" : "upvalue") << " " << static_cast<int>(index) << "\n";
+            operand_offset += 2;
+        }
+
+        return operand_offset - code_offset;
+    }
+
+    int property_instruction(const string& name, const Chunk& chunk, int code_offset, bool has_arg_count) {
+        const auto code = chunk.bytecode();
+        const auto cache_index = read_long_operand(&code.at(code_offset + 1));
+        const auto name_constant = chunk.property_caches.at(cache_index).name_constant;
+        cout <<
+            setw(16) << setfill(' ') << left << name << " " <<
+            setw(4) << setfill('0') << right << cache_index << " '";
+        print_value(chunk.constants.at(name_constant));
+        cout << "'";
+        if (has_arg_count) {
+            cout << " (" << static_cast<int>(code.at(code_offset + 4)) << " args)";
+        }
+        cout << "\n";
+
+        return has_arg_count ? 5 : 4;
+    }
+
+    int local_constant_instruction(const string& name, const Chunk& chunk, int code_offset) {
+        const auto code = chunk.bytecode();
+        const auto slot = code.at(code_offset + 1);
+        const auto constant_offset = code.at(code_offset + 2);
+        cout <<
+            setw(16) << setfill(' ') << left << name << " " <<
+            setw(4) << setfill('0') << right << static_cast<int>(slot) << " " <<
+            setw(4) << setfill('0') << right << static_cast<int>(constant_offset) << " '";
+        print_value(chunk.constants.at(constant_offset));
+        cout << "'\n";
+
+        return 3;
+    }
+
     int byte_instruction(const string& name, const Chunk& chunk, int code_offset) {
-        const auto slot = chunk.code.at(code_offset + 1);
+        const auto slot = chunk.bytecode().at(code_offset + 1);
         cout <<
             setw(16) << setfill(' ') << left << name << " " <<
             setw(4) << setfill('0') << right << static_cast<int>(slot) <<
@@ -50,16 +117,12 @@ namespace {
     }
 
     int jump_instruction(const string& name, const Chunk& chunk, int code_offset) {
-        // DANGER! Reinterpret cast: There will be two adjacent bytes
-        // that are supposed to represent a single uint16 number
-        const auto jump_length = reinterpret_cast<const uint16_t&>(chunk.code.at(code_offset + 1));
+        const auto jump_length = read_jump_operand(&chunk.bytecode().at(code_offset + 1));
         return jump_instruction(name, code_offset, jump_length + 3);
     }
 
     int loop_instruction(const string& name, const Chunk& chunk, int code_offset) {
-        // DANGER! Reinterpret cast: There will be two adjacent bytes
-        // that are supposed to represent a single uint16 number
-        const auto jump_length = reinterpret_cast<const uint16_t&>(chunk.code.at(code_offset + 1));
+        const auto jump_length = read_jump_operand(&chunk.bytecode().at(code_offset + 1));
         return jump_instruction(name, code_offset, -jump_length);
     }
 
@@ -69,16 +132,19 @@ namespace {
 namespace motts { namespace lox {
     int disassemble_instruction(const Chunk& chunk, int offset) {
         cout << setw(4) << setfill('0') << right << offset << " ";
-        if (offset == 0 || chunk.lines.at(offset) != chunk.lines.at(offset - 1)) {
-            cout << setw(4) << setfill(' ') << right << chunk.lines.at(offset) << " ";
+        const auto line = chunk.line_at(offset);
+        if (offset == 0 || line != chunk.line_at(offset - 1)) {
+            cout << setw(4) << setfill(' ') << right << line << " ";
         } else {
             cout << "   | ";
         }
 
-        const auto instruction = static_cast<Op_code>(chunk.code.at(offset));
+        const auto instruction = static_cast<Op_code>(chunk.bytecode().at(offset));
         switch (instruction) {
             case Op_code::constant:
                 return constant_instruction("OP_CONSTANT", chunk, offset);
+            case Op_code::constant_long:
+                return constant_long_instruction("OP_CONSTANT_LONG", chunk, offset);
             case Op_code::nil:
                 return simple_instrunction("OP_NIL");
             case Op_code::true_:
@@ -91,18 +157,42 @@ namespace motts { namespace lox {
                 return byte_instruction("OP_GET_LOCAL", chunk, offset);
             case Op_code::set_local:
                 return byte_instruction("OP_SET_LOCAL", chunk, offset);
+            case Op_code::add_constant_to_local:
+                return local_constant_instruction("OP_ADD_CONSTANT_TO_LOCAL", chunk, offset);
             case Op_code::get_global:
                 return constant_instruction("OP_GET_GLOBAL", chunk, offset);
+            case Op_code::get_global_long:
+                return constant_long_instruction("OP_GET_GLOBAL_LONG", chunk, offset);
             case Op_code::define_global:
                 return constant_instruction("OP_DEFINE_GLOBAL", chunk, offset);
+            case Op_code::define_global_long:
+                return constant_long_instruction("OP_DEFINE_GLOBAL_LONG", chunk, offset);
             case Op_code::set_global:
                 return constant_instruction("OP_SET_GLOBAL", chunk, offset);
+            case Op_code::set_global_long:
+                return constant_long_instruction("OP_SET_GLOBAL_LONG", chunk, offset);
+            case Op_code::get_upvalue:
+                return byte_instruction("OP_GET_UPVALUE", chunk, offset);
+            case Op_code::set_upvalue:
+                return byte_instruction("OP_SET_UPVALUE", chunk, offset);
+            case Op_code::get_property:
+                return property_instruction("OP_GET_PROPERTY", chunk, offset, false);
+            case Op_code::set_property:
+                return property_instruction("OP_SET_PROPERTY", chunk, offset, false);
+            case Op_code::get_super:
+                return property_instruction("OP_GET_SUPER", chunk, offset, false);
             case Op_code::equal:
                 return simple_instrunction("OP_EQUAL");
+            case Op_code::not_equal:
+                return simple_instrunction("OP_NOT_EQUAL");
             case Op_code::greater:
                 return simple_instrunction("OP_GREATER");
+            case Op_code::greater_equal:
+                return simple_instrunction("OP_GREATER_EQUAL");
             case Op_code::less:
                 return simple_instrunction("OP_LESS");
+            case Op_code::less_equal:
+                return simple_instrunction("OP_LESS_EQUAL");
             case Op_code::add:
                 return simple_instrunction("OP_ADD");
             case Op_code::subtract:
@@ -123,6 +213,28 @@ namespace motts { namespace lox {
                 return jump_instruction("OP_JUMP_IF_FALSE", chunk, offset);
             case Op_code::loop:
                 return loop_instruction("OP_LOOP", chunk, offset);
+            case Op_code::call:
+                return byte_instruction("OP_CALL", chunk, offset);
+            case Op_code::invoke:
+                return property_instruction("OP_INVOKE", chunk, offset, true);
+            case Op_code::super_invoke:
+                return property_instruction("OP_SUPER_INVOKE", chunk, offset, true);
+            case Op_code::closure:
+                return closure_instruction("OP_CLOSURE", chunk, offset, false);
+            case Op_code::closure_long:
+                return closure_instruction("OP_CLOSURE_LONG", chunk, offset, true);
+            case Op_code::close_upvalue:
+                return simple_instrunction("OP_CLOSE_UPVALUE");
+            case Op_code::class_:
+                return constant_instruction("OP_CLASS", chunk, offset);
+            case Op_code::class_long:
+                return constant_long_instruction("OP_CLASS_LONG", chunk, offset);
+            case Op_code::inherit:
+                return simple_instrunction("OP_INHERIT");
+            case Op_code::method:
+                return constant_instruction("OP_METHOD", chunk, offset);
+            case Op_code::method_long:
+                return constant_long_instruction("OP_METHOD_LONG", chunk, offset);
             case Op_code::return_:
                 return simple_instrunction("OP_RETURN");
 
@@ -135,8 +247,9 @@ namespace motts { namespace lox {
     void disassemble_chunk(const Chunk& chunk, const string& name) {
         cout << "== " << name << " ==\n";
 
-        for (auto iter = chunk.code.cbegin(); iter != chunk.code.cend(); ) {
-            const auto instruction_length = disassemble_instruction(chunk, iter - chunk.code.cbegin());
+        const auto code = chunk.bytecode();
+        for (auto iter = code.begin(); iter != code.end(); ) {
+            const auto instruction_length = disassemble_instruction(chunk, iter - code.begin());
             iter += instruction_length;
         }
     }
@@ -0,0 +1,9 @@
+#pragma once
+
+#include <stdexcept>
+
+namespace motts { namespace lox {
+    struct VM_error : std::runtime_error {
+        using std::runtime_error::runtime_error;
+    };
+}}
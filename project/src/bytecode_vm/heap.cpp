@@ -0,0 +1,234 @@
+#include "heap.hpp"
+
+using std::function;
+using std::move;
+using std::size_t;
+using std::string;
+
+using namespace motts::lox;
+
+// Not exported (internal linkage)
+namespace {
+    // Must agree with what was counted into bytes_allocated_ for the object over its lifetime
+    size_t object_size(const Obj& object) {
+        switch (object.type) {
+            case Obj_type::bound_method: return sizeof(Obj_bound_method);
+            case Obj_type::class_: return sizeof(Obj_class);
+            case Obj_type::closure: return sizeof(Obj_closure);
+            case Obj_type::function: return sizeof(Obj_function);
+            case Obj_type::native: return sizeof(Obj_native);
+            case Obj_type::shape: return sizeof(Obj_shape);
+            case Obj_type::upvalue: return sizeof(Obj_upvalue);
+
+            case Obj_type::instance:
+                return sizeof(Obj_instance) + static_cast<const Obj_instance&>(object).fields.size() * sizeof(Value);
+
+            case Obj_type::string:
+                return sizeof(Obj_string) + static_cast<const Obj_string&>(object).str.size();
+        }
+
+        return 0;
+    }
+}
+
+// Exported (external linkage)
+namespace motts { namespace lox {
+    Heap::Heap(const Gc_settings& gc_settings) :
+        gc_settings_ {gc_settings}
+    {}
+
+    Heap::~Heap() {
+        while (objects_) {
+            const auto next = objects_->next;
+            delete objects_;
+            objects_ = next;
+        }
+    }
+
+    Obj_string* Heap::make_string(string&& str) {
+        const auto hash = hash_string(str.data(), str.size());
+
+        const auto found_interned = strings_.find({str, hash});
+        if (found_interned != strings_.end()) {
+            return found_interned->second;
+        }
+
+        add_bytes_allocated(str.size());
+        const auto interned = make<Obj_string>(move(str), hash);
+        strings_.insert({{interned->str, hash}, interned});
+
+        return interned;
+    }
+
+    void Heap::add_bytes_allocated(size_t size) {
+        bytes_allocated_ += size;
+
+        #ifdef MOTTS_LOX_STRESS_GC
+            collect_garbage();
+        #else
+            if (bytes_allocated_ > next_gc_) {
+                collect_garbage();
+            }
+        #endif
+    }
+
+    void Heap::push_root_marker(function<void()> root_marker) {
+        root_markers_.push_back(move(root_marker));
+    }
+
+    void Heap::pop_root_marker() {
+        root_markers_.pop_back();
+    }
+
+    void Heap::mark(Obj* object) {
+        if (!object || object->is_marked) {
+            return;
+        }
+
+        object->is_marked = true;
+        gray_stack_.push_back(object);
+    }
+
+    void Heap::mark(Value value) {
+        if (value.is_obj()) {
+            mark(value.as_obj());
+        }
+    }
+
+    void Heap::collect_garbage() {
+        for (const auto& root_marker : root_markers_) {
+            root_marker();
+        }
+
+        while (!gray_stack_.empty()) {
+            const auto object = gray_stack_.back();
+            gray_stack_.pop_back();
+            trace_references(*object);
+        }
+
+        sweep();
+
+        next_gc_ = bytes_allocated_ * gc_settings_.gc_growth_factor;
+        if (next_gc_ < gc_settings_.first_gc_threshold) {
+            next_gc_ = gc_settings_.first_gc_threshold;
+        }
+    }
+
+    size_t Heap::bytes_allocated() const {
+        return bytes_allocated_;
+    }
+
+    void Heap::trace_references(Obj& object) {
+        switch (object.type) {
+            case Obj_type::bound_method: {
+                const auto& bound_method = static_cast<Obj_bound_method&>(object);
+                mark(bound_method.receiver);
+                mark(bound_method.method);
+
+                break;
+            }
+
+            case Obj_type::class_: {
+                const auto& class_ = static_cast<Obj_class&>(object);
+                mark(class_.name);
+                for (const auto& method : class_.methods) {
+                    mark(const_cast<Obj_string*>(method.first));
+                    mark(method.second);
+                }
+                mark(class_.initializer);
+                mark(class_.root_shape);
+
+                break;
+            }
+
+            case Obj_type::closure: {
+                const auto& closure = static_cast<Obj_closure&>(object);
+                mark(closure.function);
+                for (const auto upvalue : closure.upvalues) {
+                    mark(upvalue);
+                }
+
+                break;
+            }
+
+            case Obj_type::function: {
+                const auto& function = static_cast<Obj_function&>(object);
+                mark(function.name);
+                for (const auto constant : function.chunk.constants) {
+                    mark(constant);
+                }
+
+                // Caches are marked too, so that a cache never points at a freed object even after the instances
+                // that filled it are gone
+                for (const auto& cache : function.chunk.property_caches) {
+                    mark(cache.method);
+                    mark(cache.next_shape);
+                }
+
+                break;
+            }
+
+            case Obj_type::instance: {
+                const auto& instance = static_cast<Obj_instance&>(object);
+                mark(instance.class_);
+                mark(instance.shape);
+                for (const auto field : instance.fields) {
+                    mark(field);
+                }
+
+                break;
+            }
+
+            case Obj_type::native:
+                mark(static_cast<Obj_native&>(object).name);
+                break;
+
+            case Obj_type::shape: {
+                // A shape keeps its children alive, so instances that add fields later still find the same shapes
+                const auto& shape = static_cast<Obj_shape&>(object);
+                for (const auto& slot : shape.slots) {
+                    mark(const_cast<Obj_string*>(slot.first));
+                }
+                for (const auto& transition : shape.transitions) {
+                    mark(const_cast<Obj_string*>(transition.first));
+                    mark(transition.second);
+                }
+
+                break;
+            }
+
+            case Obj_type::string:
+                break;
+
+            case Obj_type::upvalue:
+                // While open, the value it points at is on the stack, which is marked anyway
+                mark(static_cast<Obj_upvalue&>(object).closed);
+                break;
+        }
+    }
+
+    void Heap::sweep() {
+        // Drop unreachable strings from the intern table before they're freed, since the table's keys view their
+        // characters
+        for (auto iter = strings_.begin(); iter != strings_.end(); ) {
+            if (iter->second->is_marked) {
+                ++iter;
+            } else {
+                iter = strings_.erase(iter);
+            }
+        }
+
+        auto link = &objects_;
+        while (*link) {
+            const auto object = *link;
+            if (object->is_marked) {
+                object->is_marked = false;
+                link = &object->next;
+            } else {
+                *link = object->next;
+                bytes_allocated_ -= object_size(*object);
+                delete object;
+            }
+        }
+    }
+}}
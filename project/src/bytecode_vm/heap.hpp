@@ -0,0 +1,119 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <boost/utility/string_view.hpp>
+
+#include "object.hpp"
+
+namespace motts { namespace lox {
+    // When the heap collects. A lower threshold or factor keeps the heap smaller at the cost of collecting more often.
+    struct Gc_settings {
+        // Collect once this many bytes have been allocated...
+        std::size_t first_gc_threshold {1024 * 1024};
+
+        // ...and after each collection, once the bytes that survived it have grown by this factor
+        std::size_t gc_growth_factor {2};
+    };
+
+    /*
+    Owns every object the compiler and VM allocate, and frees the ones that can no longer be reached.
+
+    Objects are threaded onto an intrusive list as they're made. The collector is a precise, non-moving mark-sweep:
+    it marks everything reachable from the roots, then walks the list and frees whatever wasn't marked. The heap
+    doesn't know where the roots are, so whoever holds object pointers of its own (the VM's stack, frames, and
+    globals, or the compiler's functions in progress) registers a root marker that marks them.
+
+    A collection can happen during any `make` or `make_string`, so every object a caller still needs must be reachable
+    from a root by the time it allocates again. An object being made is safe; it's the objects made earlier and held
+    only in C++ locals that aren't.
+    */
+    class Heap {
+        public:
+            explicit Heap(const Gc_settings& = {});
+            ~Heap();
+
+            Heap(const Heap&) = delete;
+            Heap& operator=(const Heap&) = delete;
+            Heap(Heap&&) = delete;
+            Heap& operator=(Heap&&) = delete;
+
+            template<typename T, typename... Args>
+                T* make(Args&&... args) {
+                    // Collect before the new object exists, so it can't be swept before the caller has had a chance
+                    // to root it
+                    add_bytes_allocated(sizeof(T));
+
+                    auto object = std::make_unique<T>(std::forward<Args>(args)...);
+                    object->next = objects_;
+                    objects_ = object.get();
+
+                    return object.release();
+                }
+
+            // Strings must be made through here rather than through `make` so that they're interned. If a string
+            // with the same characters already exists, then that existing object is returned.
+            Obj_string* make_string(std::string&&);
+
+            // Objects hold memory the heap doesn't allocate, such as an instance's field vector. Owners report
+            // growth there so it counts toward the next collection.
+            void add_bytes_allocated(std::size_t);
+
+            // Root markers are pushed and popped in stack order. The VM pushes one for its whole lifetime, and the
+            // compiler pushes one for as long as it's compiling.
+            void push_root_marker(std::function<void()>);
+            void pop_root_marker();
+
+            // For root markers to call
+            void mark(Obj*);
+            void mark(Value);
+
+            void collect_garbage();
+
+            std::size_t bytes_allocated() const;
+
+        private:
+            void trace_references(Obj&);
+            void sweep();
+
+            Gc_settings gc_settings_;
+            Obj* objects_ {};
+            std::size_t bytes_allocated_ {};
+            std::size_t next_gc_ {gc_settings_.first_gc_threshold};
+
+            std::vector<std::function<void()>> root_markers_;
+
+            // Marked objects whose references haven't been traced yet. Kept as an explicit stack rather than
+            // recursing, so a long chain of objects can't overflow the C++ stack.
+            std::vector<Obj*> gray_stack_;
+
+            // The key views the characters owned by the interned string object itself, so the table doesn't keep a
+            // second copy of every string
+            struct String_key {
+                boost::string_view str;
+                std::uint32_t hash;
+            };
+
+            struct String_key_hash {
+                std::size_t operator()(const String_key& key) const {
+                    return key.hash;
+                }
+            };
+
+            struct String_key_equal {
+                bool operator()(const String_key& lhs, const String_key& rhs) const {
+                    return lhs.hash == rhs.hash && lhs.str == rhs.str;
+                }
+            };
+
+            // Weak: the table alone doesn't keep a string alive, and strings are dropped from it when they're swept
+            std::unordered_map<String_key, Obj_string*, String_key_hash, String_key_equal> strings_;
+    };
+}}
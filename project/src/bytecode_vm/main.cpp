@@ -1,5 +1,6 @@
 #include <cstdlib>
 
+#include <exception>
 #include <fstream>
 #include <iostream>
 #include <iterator>
@@ -7,10 +8,13 @@
 
 #include <gsl/span>
 
+#include "compiler.hpp"
 #include "vm.hpp"
 
+using std::cerr;
 using std::cin;
 using std::cout;
+using std::exception;
 using std::exit;
 using std::getline;
 using std::ifstream;
@@ -30,7 +34,14 @@ namespace {
             string source_line;
             getline(cin, source_line);
 
-            vm.interpret(source_line);
+            // If the user makes a mistake, it shouldn't kill their entire session
+            try {
+                vm.interpret(source_line);
+            } catch (const loxns::Compiler_error& error) {
+                cerr << error.what() << "\n";
+            } catch (const loxns::VM_error& error) {
+                cerr << error.what() << "\n";
+            }
         }
     }
 
@@ -42,22 +53,35 @@ namespace {
             return string{istreambuf_iterator<char>{in}, istreambuf_iterator<char>{}};
         })();
 
-        vm.interpret(source);
+        // The compiled bytecode is cached next to the script, as "script.loxc" for "script.lox"
+        const auto cache_path = path.size() >= 4 && path.compare(path.size() - 4, 4, ".lox") == 0 ?
+            path + "c" :
+            path + ".loxc";
+
+        vm.interpret(source, cache_path);
     }
 }
 
 int main(int argc, const char* argv[]) {
-    loxns::VM vm;
+    try {
+        loxns::VM vm;
 
-    // STL-like container interface to argv
-    span<const char*> argv_span {argv, argc};
+        // STL-like container interface to argv
+        span<const char*> argv_span {argv, argc};
 
-    if (argv_span.size() == 1) {
-        repl(vm);
-    } else if (argv_span.size() == 2) {
-        run_file(vm, argv_span.at(1));
-    } else {
-        cout << "Usage: cpploxbc [path]\n";
+        if (argv_span.size() == 1) {
+            repl(vm);
+        } else if (argv_span.size() == 2) {
+            run_file(vm, argv_span.at(1));
+        } else {
+            cout << "Usage: cpploxbc [path]\n";
+            exit(EXIT_FAILURE);
+        }
+    } catch (const exception& error) {
+        cerr << error.what() << "\n";
+        exit(EXIT_FAILURE);
+    } catch (...) {
+        cerr << "An unknown error occurred.\n";
         exit(EXIT_FAILURE);
     }
 }
@@ -0,0 +1,159 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+#include "exception.hpp"
+#include "heap.hpp"
+#include "object.hpp"
+#include "value.hpp"
+
+namespace motts { namespace lox {
+    /*
+    Typed natives. A host can define a native from any callable whose parameter and return types are ones that Lox
+    values convert to and from, and the arity and the conversions are worked out at compile time from the callable's
+    signature. Each argument is read straight out of the VM's stack, and a string parameter taken by const reference
+    refers to the string object's own characters, so a call copies nothing. A parameter or return type with no
+    conversion below is a compile error.
+    */
+
+    // Converts an argument to a parameter type, or throws if the argument is the wrong Lox type
+    template<typename T>
+        struct Native_arg;
+
+    template<>
+        struct Native_arg<double> {
+            static double from(Value value, int index) {
+                if (!value.is_number()) {
+                    throw VM_error{"Argument " + std::to_string(index + 1) + " must be a number."};
+                }
+
+                return value.as_number();
+            }
+        };
+
+    template<>
+        struct Native_arg<bool> {
+            static bool from(Value value, int index) {
+                if (!value.is_bool()) {
+                    throw VM_error{"Argument " + std::to_string(index + 1) + " must be a boolean."};
+                }
+
+                return value.as_bool();
+            }
+        };
+
+    template<>
+        struct Native_arg<std::string> {
+            static const std::string& from(Value value, int index) {
+                if (!is_string(value)) {
+                    throw VM_error{"Argument " + std::to_string(index + 1) + " must be a string."};
+                }
+
+                return as_string(value)->str;
+            }
+        };
+
+    // Any Lox value, unconverted
+    template<>
+        struct Native_arg<Value> {
+            static Value from(Value value, int /*index*/) {
+                return value;
+            }
+        };
+
+    // Converts a native's return to a Lox value. A string return is the only one that allocates.
+    template<typename T>
+        struct Native_result;
+
+    template<>
+        struct Native_result<double> {
+            static Value to(Heap&, double result) {
+                return Value{result};
+            }
+        };
+
+    template<>
+        struct Native_result<bool> {
+            static Value to(Heap&, bool result) {
+                return Value{result};
+            }
+        };
+
+    template<>
+        struct Native_result<std::string> {
+            static Value to(Heap& heap, std::string result) {
+                // Nothing else is allocated before the VM pushes the result, so it needs no root in the meantime
+                return Value{heap.make_string(std::move(result))};
+            }
+        };
+
+    template<>
+        struct Native_result<std::nullptr_t> {
+            static Value to(Heap&, std::nullptr_t) {
+                return Value{};
+            }
+        };
+
+    template<>
+        struct Native_result<Value> {
+            static Value to(Heap&, Value result) {
+                return result;
+            }
+        };
+
+    template<typename Result, typename... Params>
+        struct Native_binding {
+            static constexpr int arity {sizeof...(Params)};
+
+            template<typename F>
+                static Native_fn bind(F fn, Heap& heap) {
+                    return [fn = std::move(fn), &heap] (int /*arg_count*/, const Value* args) mutable {
+                        // The VM has already checked the argument count against arity
+                        return call(fn, heap, args, std::index_sequence_for<Params...>{}, std::is_void<Result>{});
+                    };
+                }
+
+            private:
+                template<typename F, std::size_t... indexes>
+                    static Value call(
+                        F& fn, Heap& heap, const Value* args, std::index_sequence<indexes...>, std::false_type /*void*/
+                    ) {
+                        static_cast<void>(args);
+                        return Native_result<std::decay_t<Result>>::to(
+                            heap, fn(Native_arg<std::decay_t<Params>>::from(args[indexes], indexes)...)
+                        );
+                    }
+
+                // A native that returns nothing returns nil
+                template<typename F, std::size_t... indexes>
+                    static Value call(
+                        F& fn, Heap&, const Value* args, std::index_sequence<indexes...>, std::true_type /*void*/
+                    ) {
+                        static_cast<void>(args);
+                        fn(Native_arg<std::decay_t<Params>>::from(args[indexes], indexes)...);
+                        return Value{};
+                    }
+        };
+
+    // Finds the binding from a function pointer's type, or from a lambda's or function object's call operator
+    template<typename F>
+        struct Native_signature : Native_signature<decltype(&F::operator())> {};
+
+    template<typename Result, typename... Params>
+        struct Native_signature<Result (*)(Params...)> {
+            using Binding = Native_binding<Result, Params...>;
+        };
+
+    template<typename Object, typename Result, typename... Params>
+        struct Native_signature<Result (Object::*)(Params...)> {
+            using Binding = Native_binding<Result, Params...>;
+        };
+
+    template<typename Object, typename Result, typename... Params>
+        struct Native_signature<Result (Object::*)(Params...) const> {
+            using Binding = Native_binding<Result, Params...>;
+        };
+}}
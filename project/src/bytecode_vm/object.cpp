@@ -0,0 +1,75 @@
+#include "object.hpp"
+#include <utility>
+
+using std::move;
+using std::size_t;
+using std::string;
+using std::uint32_t;
+using std::uint64_t;
+
+namespace motts { namespace lox {
+    Obj::Obj(Obj_type type_arg) :
+        type {type_arg}
+    {}
+
+    Obj_string::Obj_string(string&& str_arg, uint32_t hash_arg) :
+        Obj {Obj_type::string},
+        str {move(str_arg)},
+        hash {hash_arg}
+    {}
+
+    Obj_function::Obj_function() :
+        Obj {Obj_type::function}
+    {}
+
+    Obj_native::Obj_native(Native_fn fn_arg, int arity_arg, Obj_string* name_arg) :
+        Obj {Obj_type::native},
+        fn {move(fn_arg)},
+        arity {arity_arg},
+        name {name_arg}
+    {}
+
+    Obj_upvalue::Obj_upvalue(Value* location_arg) :
+        Obj {Obj_type::upvalue},
+        location {location_arg}
+    {}
+
+    Obj_closure::Obj_closure(Obj_function* function_arg) :
+        Obj {Obj_type::closure},
+        function {function_arg},
+        upvalues(function_arg->upvalue_count)
+    {}
+
+    Obj_shape::Obj_shape(uint64_t id_arg) :
+        Obj {Obj_type::shape},
+        id {id_arg}
+    {}
+
+    Obj_class::Obj_class(Obj_string* name_arg, Obj_shape* root_shape_arg) :
+        Obj {Obj_type::class_},
+        name {name_arg},
+        root_shape {root_shape_arg}
+    {}
+
+    Obj_instance::Obj_instance(Obj_class* class_arg) :
+        Obj {Obj_type::instance},
+        class_ {class_arg},
+        shape {class_arg->root_shape}
+    {}
+
+    Obj_bound_method::Obj_bound_method(Value receiver_arg, Obj_closure* method_arg) :
+        Obj {Obj_type::bound_method},
+        receiver {receiver_arg},
+        method {method_arg}
+    {}
+
+    uint32_t hash_string(const char* begin, size_t length) {
+        uint32_t hash {2166136261u};
+        for (size_t i {0}; i != length; ++i) {
+            hash ^= static_cast<unsigned char>(begin[i]);
+            hash *= 16777619u;
+        }
+
+        return hash;
+    }
+}}
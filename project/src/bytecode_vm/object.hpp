@@ -0,0 +1,196 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "chunk.hpp"
+#include "value.hpp"
+
+namespace motts { namespace lox {
+    enum class Obj_type {
+        bound_method,
+        class_,
+        closure,
+        function,
+        instance,
+        native,
+        shape,
+        string,
+        upvalue
+    };
+
+    // Every heap-allocated Lox value derives from Obj. The type tag lets the VM check an object's type with a compare
+    // rather than a virtual call or RTTI.
+    struct Obj {
+        const Obj_type type;
+
+        // Intrusive list of every object the heap has allocated, so the heap can sweep them all
+        Obj* next {};
+
+        // Set by the collector for objects it can reach, and cleared again when it sweeps
+        bool is_marked {};
+
+        explicit Obj(Obj_type);
+
+        // Base class boilerplate
+        virtual ~Obj() = default;
+        Obj(const Obj&) = delete;
+        Obj& operator=(const Obj&) = delete;
+        Obj(Obj&&) = delete;
+        Obj& operator=(Obj&&) = delete;
+    };
+
+    // Strings are interned (see Heap::make_string), so two strings with the same characters are always the same
+    // object, and equality is a pointer compare. The hash is computed once when the string is made.
+    struct Obj_string : Obj {
+        const std::string str;
+        const std::uint32_t hash;
+
+        explicit Obj_string(std::string&&, std::uint32_t hash);
+    };
+
+    // FNV-1a
+    std::uint32_t hash_string(const char* begin, std::size_t length);
+
+    // Interned strings can key a hash map by pointer, reusing the hash they already computed
+    struct Obj_string_hash {
+        std::size_t operator()(const Obj_string* string) const {
+            return string->hash;
+        }
+    };
+
+    // The compiled form of a function declaration, or of the top-level script, which has no name. Functions exist only at
+    // compile time and as constants; at runtime, they're always wrapped in a closure.
+    struct Obj_function : Obj {
+        int arity {};
+        int upvalue_count {};
+        Chunk chunk;
+        Obj_string* name {};
+
+        explicit Obj_function();
+    };
+
+    // Natives get their arguments as a window into the VM's stack. A native can be any callable, so a host program can
+    // bind its own state into one.
+    using Native_fn = std::function<Value(int arg_count, const Value* args)>;
+
+    struct Obj_native : Obj {
+        const Native_fn fn;
+        const int arity;
+        Obj_string* const name;
+
+        explicit Obj_native(Native_fn, int arity, Obj_string* name);
+    };
+
+    // A variable captured by a closure. While the variable is still on the stack, the upvalue points at its stack slot
+    // ("open"). When the variable goes out of scope, its value moves into the upvalue itself ("closed"), and the
+    // upvalue points at its own copy.
+    struct Obj_upvalue : Obj {
+        Value* location;
+        Value closed {};
+
+        // The VM keeps open upvalues in a list sorted by stack slot, so that a variable captured by several closures
+        // gets just one upvalue
+        Obj_upvalue* next_open {};
+
+        explicit Obj_upvalue(Value* location);
+    };
+
+    struct Obj_closure : Obj {
+        Obj_function* const function;
+        std::vector<Obj_upvalue*> upvalues;
+
+        explicit Obj_closure(Obj_function*);
+    };
+
+    /*
+    A shape (or "hidden class") describes the layout of an instance's fields: which slot of the instance's field vector
+    holds each field name. Instances that gained the same fields in the same order share a shape.
+
+    Every class has its own root shape, with no fields. Adding a field to an instance moves it from its current shape to
+    a child shape with one more field, and each shape remembers its children so that instances that add fields in the
+    same order walk the same tree. Since shapes never change once made and a shape belongs to just one class, a shape's
+    id identifies both an instance's layout and its class, and property caches can key on the id alone.
+    */
+    struct Obj_shape : Obj {
+        // Ids are never reused, so a cache keyed on an id can't be fooled by a new shape at an old shape's address
+        const std::uint64_t id;
+
+        std::unordered_map<const Obj_string*, int, Obj_string_hash> slots;
+        std::unordered_map<const Obj_string*, Obj_shape*, Obj_string_hash> transitions;
+
+        explicit Obj_shape(std::uint64_t id);
+    };
+
+    struct Obj_class : Obj {
+        Obj_string* const name;
+        std::unordered_map<const Obj_string*, Obj_closure*, Obj_string_hash> methods;
+
+        // Looked up once when methods are defined rather than on every construction
+        Obj_closure* initializer {};
+
+        Obj_shape* const root_shape;
+
+        explicit Obj_class(Obj_string* name, Obj_shape* root_shape);
+    };
+
+    struct Obj_instance : Obj {
+        Obj_class* const class_;
+        Obj_shape* shape;
+        std::vector<Value> fields;
+
+        explicit Obj_instance(Obj_class*);
+    };
+
+    // A method looked up on an instance but not (yet) called, such as `var method = instance.method;`
+    struct Obj_bound_method : Obj {
+        const Value receiver;
+        Obj_closure* const method;
+
+        explicit Obj_bound_method(Value receiver, Obj_closure* method);
+    };
+
+    inline bool is_obj_type(Value value, Obj_type type) {
+        return value.is_obj() && value.as_obj()->type == type;
+    }
+
+    inline bool is_string(Value value) {
+        return is_obj_type(value, Obj_type::string);
+    }
+
+    inline Obj_string* as_string(Value value) {
+        return static_cast<Obj_string*>(value.as_obj());
+    }
+
+    inline Obj_function* as_function(Value value) {
+        return static_cast<Obj_function*>(value.as_obj());
+    }
+
+    inline Obj_native* as_native(Value value) {
+        return static_cast<Obj_native*>(value.as_obj());
+    }
+
+    inline Obj_closure* as_closure(Value value) {
+        return static_cast<Obj_closure*>(value.as_obj());
+    }
+
+    inline bool is_instance(Value value) {
+        return is_obj_type(value, Obj_type::instance);
+    }
+
+    inline Obj_class* as_class(Value value) {
+        return static_cast<Obj_class*>(value.as_obj());
+    }
+
+    inline Obj_instance* as_instance(Value value) {
+        return static_cast<Obj_instance*>(value.as_obj());
+    }
+
+    inline Obj_bound_method* as_bound_method(Value value) {
+        return static_cast<Obj_bound_method*>(value.as_obj());
+    }
+}}
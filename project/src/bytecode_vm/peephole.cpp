@@ -0,0 +1,403 @@
+#include "peephole.hpp"
+
+#include <cstdint>
+#include <limits>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include <gsl/gsl_util>
+
+#include "object.hpp"
+
+using std::move;
+using std::numeric_limits;
+using std::uint16_t;
+using std::uint8_t;
+using std::unordered_map;
+using std::unordered_set;
+using std::vector;
+
+using gsl::narrow;
+
+using namespace motts::lox;
+
+// Not exported (internal linkage)
+namespace {
+    using Offset = vector<uint8_t>::size_type;
+
+    struct Instruction {
+        // Where the instruction started before rewriting, which is what jump targets refer to
+        Offset offset;
+
+        int line;
+        Op_code opcode;
+
+        // Copied as is, except for jumps, whose operand is recomputed from the target
+        vector<uint8_t> operands;
+
+        // For jumps, the original offset of the instruction jumped to
+        Offset target;
+    };
+
+    bool is_jump(Op_code opcode) {
+        return opcode == Op_code::jump || opcode == Op_code::jump_if_false || opcode == Op_code::loop;
+    }
+
+    int operands_length(const Chunk& chunk, Offset offset) {
+        const auto& code = chunk.code;
+        switch (static_cast<Op_code>(code.at(offset))) {
+            case Op_code::constant:
+            case Op_code::get_local:
+            case Op_code::set_local:
+            case Op_code::get_global:
+            case Op_code::define_global:
+            case Op_code::set_global:
+            case Op_code::get_upvalue:
+            case Op_code::set_upvalue:
+            case Op_code::call:
+            case Op_code::class_:
+            case Op_code::method:
+                return 1;
+
+            case Op_code::add_constant_to_local:
+            case Op_code::jump:
+            case Op_code::jump_if_false:
+            case Op_code::loop:
+                return 2;
+
+            case Op_code::constant_long:
+            case Op_code::get_global_long:
+            case Op_code::define_global_long:
+            case Op_code::set_global_long:
+            case Op_code::get_property:
+            case Op_code::set_property:
+            case Op_code::get_super:
+            case Op_code::class_long:
+            case Op_code::method_long:
+                return 3;
+
+            case Op_code::invoke:
+            case Op_code::super_invoke:
+                return 4;
+
+            // The function operand is followed by a pair of bytes for each variable the function captures
+            case Op_code::closure:
+                return 1 + 2 * as_function(chunk.constants.at(code.at(offset + 1)))->upvalue_count;
+            case Op_code::closure_long:
+                return 3 + 2 * as_function(chunk.constants.at(read_long_operand(&code.at(offset + 1))))->upvalue_count;
+
+            default:
+                return 0;
+        }
+    }
+
+    vector<Instruction> decode(const Chunk& chunk) {
+        const auto& code = chunk.code;
+
+        vector<Instruction> instructions;
+        for (Offset offset = 0; offset != code.size(); ) {
+            const auto operand_begin = code.cbegin() + offset + 1;
+            const auto operand_end = operand_begin + operands_length(chunk, offset);
+
+            Instruction instruction {
+                offset, chunk.line_at(offset), static_cast<Op_code>(code.at(offset)), {operand_begin, operand_end}, {}
+            };
+
+            if (is_jump(instruction.opcode)) {
+                const auto jump_length = read_jump_operand(&code.at(offset + 1));
+                instruction.target = instruction.opcode == Op_code::loop ? offset - jump_length : offset + 3 + jump_length;
+            }
+
+            instructions.push_back(move(instruction));
+            offset = operand_end - code.cbegin();
+        }
+
+        return instructions;
+    }
+
+    void thread_jumps(vector<Instruction>& instructions) {
+        unordered_map<Offset, Instruction*> instruction_at;
+        for (auto& instruction : instructions) {
+            instruction_at[instruction.offset] = &instruction;
+        }
+
+        for (auto& instruction : instructions) {
+            if (instruction.opcode != Op_code::jump && instruction.opcode != Op_code::jump_if_false) {
+                continue;
+            }
+
+            // Forward jumps only ever lead further forward, so following them always ends
+            for (;;) {
+                const auto target = instruction_at.at(instruction.target);
+                const auto is_threadable =
+                    target->opcode == Op_code::jump ||
+                    (instruction.opcode == Op_code::jump_if_false && target->opcode == Op_code::jump_if_false);
+                if (!is_threadable) {
+                    break;
+                }
+
+                // Jumping straight to the final destination makes the jump longer, and it may no longer fit in its
+                // operand. Combining instructions never moves two offsets further apart, so a length that fits here
+                // still fits once the code is encoded.
+                if (target->target - instruction.offset - 3 > numeric_limits<uint16_t>::max()) {
+                    break;
+                }
+
+                instruction.target = target->target;
+            }
+        }
+    }
+
+    class Combiner {
+        public:
+            explicit Combiner(Chunk& chunk, const vector<Instruction>& instructions) :
+                chunk_ {chunk}
+            {
+                for (const auto& instruction : instructions) {
+                    if (is_jump(instruction.opcode)) {
+                        jump_targets_.insert(instruction.target);
+                    }
+                }
+            }
+
+            // Appends the instruction, then keeps combining the instructions at the end for as long as any pattern
+            // matches, so that folding one operator can expose the next, as in `1 + 2 + 3`
+            void push_back(Instruction instruction) {
+                combined_.push_back(move(instruction));
+                while (combine_not() || combine_negate() || combine_binary() || combine_add_to_local()) {
+                }
+            }
+
+            vector<Instruction> release() {
+                return move(combined_);
+            }
+
+        private:
+            // The nth instruction from the end, counting from 1, if the last n instructions can be combined
+            Instruction* from_end(vector<Instruction>::size_type n) {
+                if (combined_.size() < n) {
+                    return nullptr;
+                }
+
+                for (auto i = combined_.size() - n + 1; i != combined_.size(); ++i) {
+                    if (jump_targets_.count(combined_[i].offset)) {
+                        return nullptr;
+                    }
+                }
+
+                return &combined_[combined_.size() - n];
+            }
+
+            // Replaces the last n instructions with one, which keeps the first one's offset, since that's where any
+            // jump to them lands, and takes the last one's line, since that's the operator that could fail
+            void replace_end(vector<Instruction>::size_type n, Op_code opcode, vector<uint8_t> operands) {
+                auto& first = combined_[combined_.size() - n];
+                first.line = combined_.back().line;
+                first.opcode = opcode;
+                first.operands = move(operands);
+                combined_.resize(combined_.size() - n + 1);
+            }
+
+            bool replace_end_with_value(vector<Instruction>::size_type n, Value value) {
+                if (value.is_bool()) {
+                    replace_end(n, value.as_bool() ? Op_code::true_ : Op_code::false_, {});
+                    return true;
+                }
+
+                // Only add the folded value to the pool once we know an operand can reach it, so a fold we give up on
+                // leaves the chunk as it was
+                const auto found_offset = chunk_.constant_offsets.find(value.bits());
+                const auto index = found_offset != chunk_.constant_offsets.end() ?
+                    found_offset->second : chunk_.constants.size();
+                if (index > long_operand_max) {
+                    return false;
+                }
+                chunk_.constants_push_back(value);
+                if (index <= 0xff) {
+                    replace_end(n, Op_code::constant, {narrow<uint8_t>(index)});
+                } else {
+                    replace_end(n, Op_code::constant_long, {
+                        narrow<uint8_t>(index & 0xff), narrow<uint8_t>((index >> 8) & 0xff), narrow<uint8_t>(index >> 16)
+                    });
+                }
+
+                return true;
+            }
+
+            bool is_constant(const Instruction& instruction) const {
+                return instruction.opcode == Op_code::constant || instruction.opcode == Op_code::constant_long;
+            }
+
+            Value constant_value(const Instruction& instruction) const {
+                return chunk_.constants.at(
+                    instruction.opcode == Op_code::constant ?
+                        instruction.operands.at(0) :
+                        read_long_operand(instruction.operands.data())
+                );
+            }
+
+            bool combine_not() {
+                const auto first = from_end(2);
+                if (!first || combined_.back().opcode != Op_code::not_) {
+                    return false;
+                }
+
+                switch (first->opcode) {
+                    case Op_code::equal:
+                        replace_end(2, Op_code::not_equal, {});
+                        return true;
+                    case Op_code::less:
+                        replace_end(2, Op_code::greater_equal, {});
+                        return true;
+                    case Op_code::greater:
+                        replace_end(2, Op_code::less_equal, {});
+                        return true;
+
+                    case Op_code::true_:
+                        replace_end(2, Op_code::false_, {});
+                        return true;
+                    case Op_code::false_:
+                    case Op_code::nil:
+                        replace_end(2, Op_code::true_, {});
+                        return true;
+
+                    // Constants are only ever numbers and strings, which are always truthy
+                    case Op_code::constant:
+                    case Op_code::constant_long:
+                        replace_end(2, Op_code::false_, {});
+                        return true;
+
+                    default:
+                        return false;
+                }
+            }
+
+            bool combine_negate() {
+                const auto first = from_end(2);
+                if (!first || combined_.back().opcode != Op_code::negate || !is_constant(*first)) {
+                    return false;
+                }
+
+                const auto value = constant_value(*first);
+                if (!value.is_number()) {
+                    return false;
+                }
+
+                return replace_end_with_value(2, Value{-value.as_number()});
+            }
+
+            bool combine_binary() {
+                const auto first = from_end(3);
+                if (!first || !is_constant(first[0]) || !is_constant(first[1])) {
+                    return false;
+                }
+
+                const auto left_value = constant_value(first[0]);
+                const auto right_value = constant_value(first[1]);
+                if (combined_.back().opcode == Op_code::equal) {
+                    return replace_end_with_value(3, Value{left_value == right_value});
+                }
+
+                // Anything else that isn't two numbers is left to fail, or concatenate, at runtime
+                if (!are_numbers(left_value, right_value)) {
+                    return false;
+                }
+                const auto left = left_value.as_number();
+                const auto right = right_value.as_number();
+
+                switch (combined_.back().opcode) {
+                    case Op_code::add:
+                        return replace_end_with_value(3, Value{left + right});
+                    case Op_code::subtract:
+                        return replace_end_with_value(3, Value{left - right});
+                    case Op_code::multiply:
+                        return replace_end_with_value(3, Value{left * right});
+                    case Op_code::divide:
+                        return replace_end_with_value(3, Value{left / right});
+                    case Op_code::greater:
+                        return replace_end_with_value(3, Value{left > right});
+                    case Op_code::less:
+                        return replace_end_with_value(3, Value{left < right});
+
+                    default:
+                        return false;
+                }
+            }
+
+            bool combine_add_to_local() {
+                const auto first = from_end(4);
+                if (
+                    !first ||
+                    first[0].opcode != Op_code::get_local ||
+                    first[1].opcode != Op_code::constant ||
+                    first[2].opcode != Op_code::add ||
+                    first[3].opcode != Op_code::set_local ||
+                    first[0].operands != first[3].operands
+                ) {
+                    return false;
+                }
+
+                replace_end(4, Op_code::add_constant_to_local, {first[0].operands.at(0), first[1].operands.at(0)});
+                return true;
+            }
+
+            Chunk& chunk_;
+            unordered_set<Offset> jump_targets_;
+            vector<Instruction> combined_;
+    };
+
+    void encode(Chunk& chunk, const vector<Instruction>& instructions) {
+        unordered_map<Offset, Offset> new_offsets;
+        Offset new_offset {};
+        for (const auto& instruction : instructions) {
+            new_offsets[instruction.offset] = new_offset;
+            new_offset += 1 + instruction.operands.size();
+        }
+
+        chunk.code.clear();
+        chunk.lines.clear();
+        for (const auto& instruction : instructions) {
+            const auto offset = chunk.code.size();
+            chunk.bytecode_push_back(instruction.opcode, instruction.line);
+
+            if (!is_jump(instruction.opcode)) {
+                for (const auto byte : instruction.operands) {
+                    chunk.bytecode_push_back(byte, instruction.line);
+                }
+                continue;
+            }
+
+            const auto target = new_offsets.at(instruction.target);
+            const auto jump_length = instruction.opcode == Op_code::loop ? offset - target : target - offset - 3;
+            chunk.bytecode_push_back(0, instruction.line);
+            chunk.bytecode_push_back(0, instruction.line);
+            write_jump_operand(&chunk.code.at(offset + 1), narrow<uint16_t>(jump_length));
+        }
+    }
+}
+
+// Exported (external linkage)
+namespace motts { namespace lox {
+    void optimize_peephole(Chunk& chunk) {
+        auto instructions = decode(chunk);
+        thread_jumps(instructions);
+
+        Combiner combiner {chunk, instructions};
+        for (auto& instruction : instructions) {
+            combiner.push_back(move(instruction));
+        }
+
+        encode(chunk, combiner.release());
+    }
+
+    vector<Op_code> opcodes(const Chunk& chunk) {
+        vector<Op_code> opcodes;
+        for (const auto& instruction : decode(chunk)) {
+            opcodes.push_back(instruction.opcode);
+        }
+
+        return opcodes;
+    }
+}}
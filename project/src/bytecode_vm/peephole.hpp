@@ -0,0 +1,28 @@
+#pragma once
+
+#include <vector>
+
+#include "chunk.hpp"
+
+namespace motts { namespace lox {
+    /*
+    Rewrites a function's freshly compiled code in place, looking a few instructions at a time for sequences the
+    compiler emits naively and replacing them with fewer instructions that do the same thing:
+
+    - A jump that lands on an unconditional jump goes straight to where that one goes, and likewise a jump_if_false
+      that lands on another jump_if_false, which tests the same value still on the stack.
+    - An arithmetic or comparison operator whose operands are both number constants becomes a constant of its result,
+      and so does negating a number constant or notting a literal.
+    - `equal`, `less`, or `greater` followed by `not_` -- which is how `!=`, `>=`, and `<=` compile -- becomes
+      `not_equal`, `greater_equal`, or `less_equal`.
+    - `get_local`, `constant`, `add`, `set_local` of the same slot -- which is how `i = i + 1` compiles -- becomes
+      `add_constant_to_local`.
+
+    Instructions are never combined across a jump target, because control could arrive in the middle of them. Jumps
+    and the line table are rebuilt for the new offsets afterward.
+    */
+    void optimize_peephole(Chunk&);
+
+    // The opcode of each instruction in a freshly compiled chunk, in order, so that what the pass does can be counted
+    std::vector<Op_code> opcodes(const Chunk&);
+}}
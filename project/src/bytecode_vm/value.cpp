@@ -4,44 +4,68 @@
 #include <iostream>
 #include <ostream>
 
+#include "object.hpp"
+
 using std::boolalpha;
 using std::cout;
-using std::nullptr_t;
 using std::ostream;
-using std::string;
 
-using boost::apply_visitor;
-using boost::static_visitor;
+namespace motts { namespace lox {
+    void print_value(Value value) {
+        print_value(cout, value);
+    }
 
-namespace {
-    struct Ostream_visitor : static_visitor<void> {
-        ostream& os;
+    void print_value(ostream& out, Value value) {
+        if (value.is_number()) {
+            out << value.as_number();
+        } else if (value.is_bool()) {
+            out << boolalpha << value.as_bool();
+        } else if (value.is_nil()) {
+            out << "nil";
+        } else {
+            switch (value.as_obj()->type) {
+                case Obj_type::bound_method:
+                    print_value(out, Value{as_bound_method(value)->method});
+                    break;
 
-        explicit Ostream_visitor(ostream& os_arg) :
-            os {os_arg}
-        {}
+                case Obj_type::class_:
+                    out << as_class(value)->name->str;
+                    break;
 
-        auto operator()(const string& value) {
-            os << value;
-        }
+                case Obj_type::closure:
+                    print_value(out, Value{as_closure(value)->function});
+                    break;
 
-        auto operator()(double value) {
-            os << value;
-        }
+                case Obj_type::function: {
+                    const auto function = as_function(value);
+                    if (function->name) {
+                        out << "<fn " << function->name->str << ">";
+                    } else {
+                        out << "<script>";
+                    }
+                    break;
+                }
 
-        auto operator()(bool value) {
-            os << boolalpha << value;
-        }
+                case Obj_type::instance:
+                    out << as_instance(value)->class_->name->str << " instance";
+                    break;
 
-        auto operator()(nullptr_t) {
-            os << "nil";
-        }
-    };
-}
+                case Obj_type::native:
+                    out << "<fn " << as_native(value)->name->str << ">";
+                    break;
 
-namespace motts { namespace lox {
-    void print_value(const Value& value) {
-        Ostream_visitor ostream_visitor {cout};
-        apply_visitor(ostream_visitor, value.variant);
+                case Obj_type::shape:
+                    out << "shape";
+                    break;
+
+                case Obj_type::string:
+                    out << as_string(value)->str;
+                    break;
+
+                case Obj_type::upvalue:
+                    out << "upvalue";
+                    break;
+            }
+        }
     }
 }}
@@ -1,14 +1,123 @@
 #pragma once
 
 #include <cstddef>
-#include <string>
-
-#include <boost/variant.hpp>
+#include <cstdint>
+#include <cstring>
+#include <iosfwd>
 
 namespace motts { namespace lox {
-    struct Value {
-        boost::variant<bool, std::nullptr_t, double, std::string> variant;
+    struct Obj;
+
+    /*
+    The value representation uses NaN boxing. Every Lox value fits in 8 bytes, the same size as a double.
+
+    An IEEE 754 double whose exponent bits are all set and whose highest mantissa bit (the "quiet" bit) is set is a
+    quiet NaN, and real arithmetic only ever produces one particular quiet NaN. That leaves the remaining 51 mantissa
+    bits and the sign bit free to encode everything that isn't a number.
+
+        * Numbers are stored as-is.
+        * nil, false, and true are the quiet NaN pattern with a small tag in the lowest bits.
+        * Object pointers are the quiet NaN pattern with the sign bit set, and the pointer in the low 48 bits.
+
+    The upshot is that the type checks the VM needs in its dispatch loop are a mask and a compare, with no branches
+    and no discriminator stored beside the payload.
+    */
+    class Value {
+        public:
+            // Default is nil
+            explicit Value() = default;
+
+            explicit Value(std::nullptr_t) :
+                bits_ {quiet_nan_ | tag_nil_}
+            {}
+
+            explicit Value(bool value) :
+                bits_ {value ? (quiet_nan_ | tag_true_) : (quiet_nan_ | tag_false_)}
+            {}
+
+            explicit Value(double value) {
+                static_assert(sizeof(double) == sizeof(std::uint64_t), "NaN boxing requires 64-bit doubles.");
+                std::memcpy(&bits_, &value, sizeof(double));
+            }
+
+            explicit Value(Obj* object) :
+                bits_ {sign_bit_ | quiet_nan_ | reinterpret_cast<std::uintptr_t>(object)}
+            {
+                static_assert(sizeof(Obj*) <= sizeof(std::uint64_t), "NaN boxing requires pointers of at most 64 bits.");
+            }
+
+            bool is_nil() const {
+                return bits_ == (quiet_nan_ | tag_nil_);
+            }
+
+            bool is_bool() const {
+                // false and true differ only in the lowest bit
+                return (bits_ | 1) == (quiet_nan_ | tag_true_);
+            }
+
+            bool is_number() const {
+                return (bits_ & quiet_nan_) != quiet_nan_;
+            }
+
+            bool is_obj() const {
+                return (bits_ & (sign_bit_ | quiet_nan_)) == (sign_bit_ | quiet_nan_);
+            }
+
+            // Only false and nil are falsey, everything else is truthy
+            bool is_falsey() const {
+                // Bitwise rather than logical "or" so the compiler doesn't have to branch
+                return (bits_ == (quiet_nan_ | tag_nil_)) | (bits_ == (quiet_nan_ | tag_false_));
+            }
+
+            bool as_bool() const {
+                return bits_ == (quiet_nan_ | tag_true_);
+            }
+
+            double as_number() const {
+                double value;
+                std::memcpy(&value, &bits_, sizeof(double));
+                return value;
+            }
+
+            Obj* as_obj() const {
+                return reinterpret_cast<Obj*>(static_cast<std::uintptr_t>(bits_ & ~(sign_bit_ | quiet_nan_)));
+            }
+
+            std::uint64_t bits() const {
+                return bits_;
+            }
+
+        private:
+            static constexpr std::uint64_t sign_bit_ {0x8000'0000'0000'0000};
+            static constexpr std::uint64_t quiet_nan_ {0x7ffc'0000'0000'0000};
+
+            static constexpr std::uint64_t tag_nil_ {1};
+            static constexpr std::uint64_t tag_false_ {2};
+            static constexpr std::uint64_t tag_true_ {3};
+
+            std::uint64_t bits_ {quiet_nan_ | tag_nil_};
     };
 
-    void print_value(const Value&);
+    // Both operands are numbers; bitwise "and" so the check compiles to a pair of compares and no branch
+    inline bool are_numbers(Value lhs, Value rhs) {
+        return lhs.is_number() & rhs.is_number();
+    }
+
+    inline bool operator==(Value lhs, Value rhs) {
+        // Numbers compare by value rather than by bits, so that NaN != NaN and 0 == -0
+        if (are_numbers(lhs, rhs)) {
+            return lhs.as_number() == rhs.as_number();
+        }
+
+        // Everything else -- nil, bools, and objects -- is equal only if it's the very same value. Strings are
+        // interned, so equal strings are the very same object, and string equality is just this bit compare.
+        return lhs.bits() == rhs.bits();
+    }
+
+    inline bool operator!=(Value lhs, Value rhs) {
+        return !(lhs == rhs);
+    }
+
+    void print_value(Value);
+    void print_value(std::ostream&, Value);
 }}
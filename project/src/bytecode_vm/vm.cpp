@@ -1,314 +1,975 @@
 #include "vm.hpp"
 
+#include <chrono>
 #include <cstddef>
 #include <cstdint>
+#include <ctime>
 #include <iostream>
 #include <utility>
 
+#include <gsl/gsl_util>
+
+#include "bytecode_cache.hpp"
 #include "compiler.hpp"
 #include "debug.hpp"
+#include "object.hpp"
 
+using std::chrono::duration;
+using std::chrono::duration_cast;
+using std::chrono::nanoseconds;
+using std::chrono::steady_clock;
+using std::clock;
 using std::cout;
 using std::move;
-using std::nullptr_t;
+using std::ostream;
+using std::size_t;
 using std::string;
-using std::uint16_t;
+using std::to_string;
+using std::uint8_t;
 
-using boost::apply_visitor;
-using boost::get;
-using boost::static_visitor;
+using gsl::finally;
 
 using namespace motts::lox;
 
+// Labels as values is a GNU extension, so even if the build asked for computed goto, fall back to a switch on
+// compilers that don't support it
+#if defined(MOTTS_LOX_COMPUTED_GOTO) && defined(__GNUC__)
+    #define MOTTS_LOX_USE_COMPUTED_GOTO
+#endif
+
+// Tracing is compiled in only when asked for, so that normal builds pay nothing for it in the dispatch loop
+#ifdef MOTTS_LOX_DEBUG_TRACE_EXECUTION
+    #define MOTTS_LOX_TRACE() trace_execution( \
+        stack_.get(), stack_top, frame->closure->function->chunk, ip - frame->closure->function->chunk.bytecode().data() \
+    )
+#else
+    #define MOTTS_LOX_TRACE()
+#endif
+
+// Not exported (internal linkage)
 namespace {
-    // Only false and nil are falsey, everything else is truthy
-    struct Is_truthy_visitor : static_visitor<bool> {
-        auto operator()(bool value) const {
-            return value;
+    #ifdef MOTTS_LOX_DEBUG_TRACE_EXECUTION
+        void trace_execution(const Value* stack_begin, const Value* stack_top, const Chunk& chunk, int code_offset) {
+            cout << "          ";
+            for (auto slot = stack_begin; slot != stack_top; ++slot) {
+                cout << "[ ";
+                print_value(*slot);
+                cout << " ]";
+            }
+            cout << "\n";
+            disassemble_instruction(chunk, code_offset);
+        }
+    #endif
+
+    // Seconds on a monotonic clock, to as fine a resolution as the platform gives, for timing a script from the inside
+    double clock_native() {
+        return duration<double>{steady_clock::now().time_since_epoch()}.count();
+    }
+
+    // The same clock in whole nanoseconds. A double holds those exactly for over a hundred days of uptime.
+    double nano_time_native() {
+        return static_cast<double>(duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count());
+    }
+
+    // Seconds of processor time the process has used, which doesn't count time spent waiting
+    double cpu_time_native() {
+        return static_cast<double>(clock()) / CLOCKS_PER_SEC;
+    }
+}
+
+// Exported (external linkage)
+namespace motts { namespace lox {
+    VM::VM() :
+        VM {cout}
+    {}
+
+    VM::VM(ostream& out) :
+        VM {out, Gc_settings{}}
+    {}
+
+    VM::VM(ostream& out, const Gc_settings& gc_settings) :
+        out_ {out},
+        heap_ {gc_settings}
+    {
+        heap_.push_root_marker([this] () {
+            mark_roots();
+        });
+
+        define_native("clock", clock_native);
+        define_native("nanoTime", nano_time_native);
+        define_native("cpuTime", cpu_time_native);
+    }
+
+    size_t VM::bytes_allocated() const {
+        return heap_.bytes_allocated();
+    }
+
+    void VM::interpret(const string& source) {
+        execute(::motts::lox::compile(source, heap_));
+    }
+
+    void VM::interpret(const string& source, const string& cache_path) {
+        auto cached = load_script_cache(cache_path, source, heap_);
+        if (cached) {
+            const auto script = cached->script;
+            mapped_scripts_.push_back(move(cached));
+            execute(script);
+            return;
+        }
+
+        const auto script = ::motts::lox::compile(source, heap_);
+        save_script_cache(cache_path, source, *script);
+        execute(script);
+    }
+
+    Program::Program(Obj_function* script) :
+        script_ {script}
+    {}
+
+    Program VM::compile(const string& source) {
+        const auto script = ::motts::lox::compile(source, heap_);
+        compiled_scripts_.push_back(script);
+
+        return Program{script};
+    }
+
+    void VM::execute(const Program& program) {
+        globals_ = natives_;
+        execute(program.script_);
+    }
+
+    void VM::execute(Obj_function* script) {
+        // A runtime error can abandon values and frames, so each script starts from an empty stack
+        stack_top_ = stack_.get();
+        frame_count_ = 0;
+        open_upvalues_ = nullptr;
+
+        // Keep the script reachable while its closure is made
+        *stack_top_++ = Value{script};
+        const auto closure = heap_.make<Obj_closure>(script);
+        stack_top_[-1] = Value{closure};
+        call(closure, 0);
+
+        try {
+            run();
+        } catch (const VM_error& error) {
+            // ip has already moved past the failed instruction's opcode, so look up the byte just behind it
+            const auto& frame = frames_.at(frame_count_ - 1);
+            const auto& chunk = frame.closure->function->chunk;
+            const auto line = chunk.line_at(frame.ip - chunk.bytecode().data() - 1);
+            throw VM_error{"[Line " + to_string(line) + "] Error: " + error.what()};
+        }
+    }
+
+    void VM::call_value(Value callee, int arg_count) {
+        if (callee.is_obj()) {
+            switch (callee.as_obj()->type) {
+                case Obj_type::bound_method: {
+                    // The method's slot zero is `this`, so the receiver takes the callee's place
+                    const auto bound_method = as_bound_method(callee);
+                    stack_top_[-arg_count - 1] = bound_method->receiver;
+                    call(bound_method->method, arg_count);
+
+                    return;
+                }
+
+                case Obj_type::class_: {
+                    const auto class_ = as_class(callee);
+                    stack_top_[-arg_count - 1] = Value{heap_.make<Obj_instance>(class_)};
+
+                    if (class_->initializer) {
+                        call(class_->initializer, arg_count);
+                    } else if (arg_count != 0) {
+                        throw VM_error{"Expected 0 arguments but got " + to_string(arg_count) + "."};
+                    }
+
+                    return;
+                }
+
+                case Obj_type::closure:
+                    call(as_closure(callee), arg_count);
+                    return;
+
+                case Obj_type::native: {
+                    const auto native = as_native(callee);
+                    if (arg_count != native->arity) {
+                        throw VM_error{
+                            "Expected " + to_string(native->arity) + " arguments but got " + to_string(arg_count) + "."
+                        };
+                    }
+
+                    const auto result = native->fn(arg_count, stack_top_ - arg_count);
+                    stack_top_ -= arg_count + 1;
+                    *stack_top_++ = result;
+
+                    return;
+                }
+
+                default:
+                    // Not callable
+                    break;
+            }
+        }
+
+        throw VM_error{"Can only call functions and classes."};
+    }
+
+    void VM::call(Obj_closure* closure, int arg_count) {
+        if (arg_count != closure->function->arity) {
+            throw VM_error{
+                "Expected " + to_string(closure->function->arity) + " arguments but got " + to_string(arg_count) + "."
+            };
+        }
+
+        // This is the only place the stack can overflow. Within a frame, pushes and pops are never checked.
+        if (frame_count_ == frames_max_ || stack_.get() + stack_max_ - stack_top_ < frame_slots_max_) {
+            throw VM_error{"Stack overflow."};
+        }
+
+        auto& frame = frames_[frame_count_++];
+        frame.closure = closure;
+        frame.ip = closure->function->chunk.bytecode().data();
+        frame.slots = stack_top_ - arg_count - 1;
+    }
+
+    const uint8_t* VM::capture_upvalues(Obj_closure& closure, const uint8_t* ip, Value* slots, const Obj_closure& enclosing) {
+        for (auto& upvalue : closure.upvalues) {
+            const auto is_local = *ip++;
+            const auto index = *ip++;
+            upvalue = is_local ? capture_upvalue(slots + index) : enclosing.upvalues[index];
+        }
+
+        return ip;
+    }
+
+    Obj_upvalue* VM::capture_upvalue(Value* local) {
+        // If a closure already captured this variable, then share its upvalue
+        Obj_upvalue* prev_upvalue {};
+        auto upvalue = open_upvalues_;
+        while (upvalue && upvalue->location > local) {
+            prev_upvalue = upvalue;
+            upvalue = upvalue->next_open;
+        }
+        if (upvalue && upvalue->location == local) {
+            return upvalue;
+        }
+
+        const auto new_upvalue = heap_.make<Obj_upvalue>(local);
+        new_upvalue->next_open = upvalue;
+        if (prev_upvalue) {
+            prev_upvalue->next_open = new_upvalue;
+        } else {
+            open_upvalues_ = new_upvalue;
+        }
+
+        return new_upvalue;
+    }
+
+    void VM::close_upvalues(const Value* last) {
+        while (open_upvalues_ && open_upvalues_->location >= last) {
+            const auto upvalue = open_upvalues_;
+            upvalue->closed = *upvalue->location;
+            upvalue->location = &upvalue->closed;
+            open_upvalues_ = upvalue->next_open;
+        }
+    }
+
+    void VM::define_native(const string& name, Native_fn fn, int arity) {
+        // Adding the name to globals first keeps it reachable while the native is made
+        const auto name_string = heap_.make_string(string{name});
+        auto& global = globals_[name_string];
+        global = Value{heap_.make<Obj_native>(move(fn), arity, name_string)};
+        natives_[name_string] = global;
+    }
+
+    void VM::update_get_cache(Property_cache& cache, const Obj_instance& instance, const Obj_string* name) {
+        // Fields shadow methods
+        const auto found_slot = instance.shape->slots.find(name);
+        if (found_slot != instance.shape->slots.end()) {
+            cache.shape_id = instance.shape->id;
+            cache.slot = found_slot->second;
+            cache.method = nullptr;
+
+            return;
+        }
+
+        const auto method = find_method(*instance.class_, name);
+        cache.shape_id = instance.shape->id;
+        cache.method = method;
+    }
+
+    void VM::update_set_cache(Property_cache& cache, const Obj_instance& instance, Obj_string* name) {
+        const auto shape = instance.shape;
+        cache.shape_id = shape->id;
+
+        const auto found_slot = shape->slots.find(name);
+        if (found_slot != shape->slots.end()) {
+            cache.slot = found_slot->second;
+            cache.next_shape = nullptr;
+
+            return;
+        }
+
+        // A new field goes in the next slot, and moves the instance to the child shape that has it. Instances that
+        // add the same field to the same shape share that child.
+        auto& next_shape = shape->transitions[name];
+        if (!next_shape) {
+            next_shape = heap_.make<Obj_shape>(next_shape_id_++);
+            next_shape->slots = shape->slots;
+            next_shape->slots[name] = shape->slots.size();
+        }
+
+        cache.slot = shape->slots.size();
+        cache.next_shape = next_shape;
+    }
+
+    Obj_class* VM::make_class(Obj_string* name) {
+        // Keep the root shape reachable while the class is made
+        *stack_top_++ = Value{heap_.make<Obj_shape>(next_shape_id_++)};
+        const auto class_ = heap_.make<Obj_class>(name, static_cast<Obj_shape*>(stack_top_[-1].as_obj()));
+        --stack_top_;
+
+        return class_;
+    }
+
+    void VM::mark_roots() {
+        for (auto slot = stack_.get(); slot != stack_top_; ++slot) {
+            heap_.mark(*slot);
+        }
+
+        for (auto i = 0; i != frame_count_; ++i) {
+            heap_.mark(frames_[i].closure);
+        }
+
+        for (auto upvalue = open_upvalues_; upvalue; upvalue = upvalue->next_open) {
+            heap_.mark(upvalue);
+        }
+
+        for (const auto& global : globals_) {
+            heap_.mark(const_cast<Obj_string*>(global.first));
+            heap_.mark(global.second);
         }
 
-        auto operator()(nullptr_t) const {
-            return false;
+        for (const auto& native : natives_) {
+            heap_.mark(native.second);
+        }
+
+        for (const auto script : compiled_scripts_) {
+            heap_.mark(script);
+        }
+
+        heap_.mark(init_string_);
+    }
+
+    void VM::define_method(Obj_class* class_, const Obj_string* name, Obj_closure* method) {
+        class_->methods[name] = method;
+        if (name == init_string_) {
+            class_->initializer = method;
+        }
+    }
+
+    Obj_closure* VM::find_method(const Obj_class& class_, const Obj_string* name) {
+        const auto found_method = class_.methods.find(name);
+        if (found_method == class_.methods.end()) {
+            throw VM_error{"Undefined property '" + name->str + "'."};
         }
 
-        template<typename T>
-            auto operator()(const T&) const {
-                return true;
+        return found_method->second;
+    }
+
+    void VM::run() {
+        // Copy the hot VM state into locals so the compiler can keep them in registers for the whole loop, rather
+        // than loading and storing members through `this` on every instruction. Calls and returns switch frames, so
+        // they store these back and reload them from the new frame.
+        Call_frame* frame;
+        const uint8_t* ip;
+        Value* slots;
+        const Value* constants;
+        auto stack_top = stack_top_;
+
+        #define MOTTS_LOX_LOAD_FRAME() \
+            frame = &frames_[frame_count_ - 1]; \
+            ip = frame->ip; \
+            slots = frame->slots; \
+            constants = frame->closure->function->chunk.constants.data()
+
+        MOTTS_LOX_LOAD_FRAME();
+
+        const auto _ = finally([&] () {
+            frame->ip = ip;
+            stack_top_ = stack_top;
+        });
+
+        // Anything that allocates can also collect garbage, and the collector finds the stack's roots through
+        // stack_top_, so handlers store stack_top before they allocate
+
+        /*
+        There are two ways to dispatch instructions, selected at build time.
+
+        The portable way is a switch inside a loop. Every instruction jumps back to the top of the loop, and from
+        there to the next handler, so every instruction shares one indirect branch, and the CPU's branch predictor
+        has little history to go on.
+
+        GCC and Clang support "labels as values", which lets us build a table of handler addresses and have each
+        handler jump directly to the next one (threaded dispatch). Each handler then has its own indirect branch, and
+        the predictor learns common instruction pairs, such as a compare followed by a jump.
+        */
+        #ifdef MOTTS_LOX_USE_COMPUTED_GOTO
+            static const void* const dispatch_table[] {
+                #define X(name) &&op_##name,
+                MOTTS_LOX_OP_CODE_NAMES
+                #undef X
+            };
+
+            #define MOTTS_LOX_CASE(name) op_##name
+            #define MOTTS_LOX_NEXT() \
+                MOTTS_LOX_TRACE(); \
+                goto *dispatch_table[*ip++]
+
+            MOTTS_LOX_NEXT();
+        #else
+            #define MOTTS_LOX_CASE(name) case Op_code::name
+            #define MOTTS_LOX_NEXT() continue
+
+            for (;;) {
+            MOTTS_LOX_TRACE();
+            switch (static_cast<Op_code>(*ip++)) {
+        #endif
+
+        MOTTS_LOX_CASE(constant): {
+            *stack_top++ = constants[*ip++];
+
+            MOTTS_LOX_NEXT();
+        }
+
+        MOTTS_LOX_CASE(constant_long): {
+            *stack_top++ = constants[read_long_operand(ip)];
+            ip += 3;
+
+            MOTTS_LOX_NEXT();
+        }
+
+        MOTTS_LOX_CASE(nil): {
+            *stack_top++ = Value{nullptr};
+            MOTTS_LOX_NEXT();
+        }
+
+        MOTTS_LOX_CASE(true_): {
+            *stack_top++ = Value{true};
+            MOTTS_LOX_NEXT();
+        }
+
+        MOTTS_LOX_CASE(false_): {
+            *stack_top++ = Value{false};
+            MOTTS_LOX_NEXT();
+        }
+
+        MOTTS_LOX_CASE(pop): {
+            --stack_top;
+            MOTTS_LOX_NEXT();
+        }
+
+        MOTTS_LOX_CASE(get_local): {
+            *stack_top++ = slots[*ip++];
+            MOTTS_LOX_NEXT();
+        }
+
+        MOTTS_LOX_CASE(set_local): {
+            slots[*ip++] = stack_top[-1];
+            MOTTS_LOX_NEXT();
+        }
+
+        MOTTS_LOX_CASE(add_constant_to_local): {
+            auto& local = slots[ip[0]];
+            const auto constant = constants[ip[1]];
+            ip += 2;
+
+            if (are_numbers(local, constant)) {
+                local = Value{local.as_number() + constant.as_number()};
+            } else if (is_string(local) && is_string(constant)) {
+                stack_top_ = stack_top;
+                local = Value{heap_.make_string(as_string(local)->str + as_string(constant)->str)};
+            } else {
+                throw VM_error{"Operands must be two numbers or two strings."};
             }
-    };
 
-    struct Is_equal_visitor : static_visitor<bool> {
-        // Different types automatically compare false
-        template<typename T, typename U>
-            auto operator()(const T&, const U&) const {
-                return false;
+            // Leave the value, because assignment is an expression
+            *stack_top++ = local;
+
+            MOTTS_LOX_NEXT();
+        }
+
+        MOTTS_LOX_CASE(get_upvalue): {
+            *stack_top++ = *frame->closure->upvalues[*ip++]->location;
+            MOTTS_LOX_NEXT();
+        }
+
+        MOTTS_LOX_CASE(set_upvalue): {
+            *frame->closure->upvalues[*ip++]->location = stack_top[-1];
+            MOTTS_LOX_NEXT();
+        }
+
+        MOTTS_LOX_CASE(get_property): {
+            auto& cache = frame->closure->function->chunk.property_caches[read_long_operand(ip)];
+            ip += 3;
+
+            const auto receiver = stack_top[-1];
+            if (!is_instance(receiver)) {
+                throw VM_error{"Only instances have properties."};
             }
+            const auto instance = as_instance(receiver);
 
-        // Same types use normal equality test
-        template<typename T>
-            auto operator()(const T& lhs, const T& rhs) const {
-                return lhs == rhs;
+            if (instance->shape->id != cache.shape_id) {
+                update_get_cache(cache, *instance, as_string(constants[cache.name_constant]));
             }
-    };
 
-    struct Plus_visitor : static_visitor<Value> {
-        auto operator()(const string& lhs, const string& rhs) const {
-            return Value{lhs + rhs};
+            stack_top_ = stack_top;
+            stack_top[-1] = cache.method ?
+                Value{heap_.make<Obj_bound_method>(receiver, cache.method)} :
+                instance->fields[cache.slot];
+
+            MOTTS_LOX_NEXT();
         }
 
-        auto operator()(double lhs, double rhs) const {
-            return Value{lhs + rhs};
+        MOTTS_LOX_CASE(set_property): {
+            auto& cache = frame->closure->function->chunk.property_caches[read_long_operand(ip)];
+            ip += 3;
+
+            const auto receiver = stack_top[-2];
+            if (!is_instance(receiver)) {
+                throw VM_error{"Only instances have fields."};
+            }
+            const auto instance = as_instance(receiver);
+
+            stack_top_ = stack_top;
+            if (instance->shape->id != cache.shape_id) {
+                update_set_cache(cache, *instance, as_string(constants[cache.name_constant]));
+            }
+
+            const auto value = stack_top[-1];
+            if (cache.next_shape) {
+                heap_.add_bytes_allocated(sizeof(Value));
+                instance->fields.push_back(value);
+                instance->shape = cache.next_shape;
+            } else {
+                instance->fields[cache.slot] = value;
+            }
+
+            // Pop the instance but leave the value, because assignment is an expression
+            --stack_top;
+            stack_top[-1] = value;
+
+            MOTTS_LOX_NEXT();
         }
 
-        // All other type combinations can't be '+'-ed together
-        template<typename T, typename U>
-            Value operator()(const T&, const U&) const {
-                throw VM_error{"Operands must be two numbers or two strings."};
+        MOTTS_LOX_CASE(get_super): {
+            const auto& cache = frame->closure->function->chunk.property_caches[read_long_operand(ip)];
+            ip += 3;
+
+            const auto superclass = as_class(*--stack_top);
+            const auto method = find_method(*superclass, as_string(constants[cache.name_constant]));
+            stack_top_ = stack_top;
+            stack_top[-1] = Value{heap_.make<Obj_bound_method>(stack_top[-1], method)};
+
+            MOTTS_LOX_NEXT();
+        }
+
+        MOTTS_LOX_CASE(get_global): {
+            const auto name = as_string(constants[*ip++]);
+            const auto found_value = globals_.find(name);
+            if (found_value == globals_.end()) {
+                throw VM_error{"Undefined variable '" + name->str + "'"};
             }
-    };
-}
+            *stack_top++ = found_value->second;
 
-namespace motts { namespace lox {
-    void VM::interpret(const string& source) {
-      const auto chunk = compile(source);
+            MOTTS_LOX_NEXT();
+        }
 
-      chunk_ = &chunk;
-      ip_ = chunk.code.cbegin();
+        MOTTS_LOX_CASE(get_global_long): {
+            const auto name = as_string(constants[read_long_operand(ip)]);
+            ip += 3;
 
-      run();
-    }
+            const auto found_value = globals_.find(name);
+            if (found_value == globals_.end()) {
+                throw VM_error{"Undefined variable '" + name->str + "'"};
+            }
+            *stack_top++ = found_value->second;
 
-    void VM::run() {
-        for (;;) {
-            cout << "          ";
-            for (const auto value : stack_) {
-                cout << "[ ";
-                print_value(value);
-                cout << " ]";
+            MOTTS_LOX_NEXT();
+        }
+
+        MOTTS_LOX_CASE(set_global): {
+            const auto name = as_string(constants[*ip++]);
+            const auto found_value = globals_.find(name);
+            if (found_value == globals_.end()) {
+                throw VM_error{"Undefined variable '" + name->str + "'"};
             }
-            cout << "\n";
-            disassemble_instruction(*chunk_, ip_ - chunk_->code.cbegin());
+            found_value->second = stack_top[-1];
 
-            const auto instruction = static_cast<Op_code>(*ip_++);
-            switch (instruction) {
-                case Op_code::constant: {
-                    const auto constant_offset = *ip_++;
-                    const auto constant = chunk_->constants.at(constant_offset);
-                    stack_.push_back(constant);
+            MOTTS_LOX_NEXT();
+        }
 
-                    break;
-                }
+        MOTTS_LOX_CASE(set_global_long): {
+            const auto name = as_string(constants[read_long_operand(ip)]);
+            ip += 3;
 
-                case Op_code::nil: {
-                    stack_.push_back(Value{nullptr});
-                    break;
-                }
+            const auto found_value = globals_.find(name);
+            if (found_value == globals_.end()) {
+                throw VM_error{"Undefined variable '" + name->str + "'"};
+            }
+            found_value->second = stack_top[-1];
 
-                case Op_code::true_: {
-                    stack_.push_back(Value{true});
-                    break;
-                }
+            MOTTS_LOX_NEXT();
+        }
 
-                case Op_code::false_: {
-                    stack_.push_back(Value{false});
-                    break;
-                }
+        MOTTS_LOX_CASE(define_global): {
+            const auto name = as_string(constants[*ip++]);
+            globals_[name] = *--stack_top;
 
-                case Op_code::pop: {
-                    stack_.pop_back();
-                    break;
-                }
+            MOTTS_LOX_NEXT();
+        }
 
-                case Op_code::get_local: {
-                    stack_.push_back(stack_.at(*ip_++));
-                    break;
-                }
+        MOTTS_LOX_CASE(define_global_long): {
+            const auto name = as_string(constants[read_long_operand(ip)]);
+            ip += 3;
 
-                case Op_code::set_local: {
-                    stack_.at(*ip_++) = stack_.back();
-                    break;
-                }
+            globals_[name] = *--stack_top;
 
-                case Op_code::get_global: {
-                    const auto name = get<string>(chunk_->constants.at(*ip_++).variant);
-                    const auto found_value = globals_.find(name);
-                    if (found_value == globals_.end()) {
-                        throw VM_error{"Undefined variable '" + name + "'"};
-                    }
-                    stack_.push_back(found_value->second);
+            MOTTS_LOX_NEXT();
+        }
 
-                    break;
-                }
+        MOTTS_LOX_CASE(equal): {
+            const auto right_value = *--stack_top;
+            const auto left_value = *--stack_top;
 
-                case Op_code::set_global: {
-                    const auto name = get<string>(chunk_->constants.at(*ip_++).variant);
-                    const auto found_value = globals_.find(name);
-                    if (found_value == globals_.end()) {
-                        throw VM_error{"Undefined variable '" + name + "'"};
-                    }
-                    found_value->second = stack_.back();
+            *stack_top++ = Value{left_value == right_value};
 
-                    break;
-                }
+            MOTTS_LOX_NEXT();
+        }
 
-                case Op_code::define_global: {
-                    const auto name = get<string>(chunk_->constants.at(*ip_++).variant);
-                    globals_[name] = stack_.back();
-                    stack_.pop_back();
+        MOTTS_LOX_CASE(not_equal): {
+            const auto right_value = *--stack_top;
+            const auto left_value = *--stack_top;
 
-                    break;
-                }
+            *stack_top++ = Value{!(left_value == right_value)};
 
-                case Op_code::equal: {
-                    const auto right_value = move(stack_.back());
-                    stack_.pop_back();
+            MOTTS_LOX_NEXT();
+        }
 
-                    const auto left_value = move(stack_.back());
-                    stack_.pop_back();
+        MOTTS_LOX_CASE(greater): {
+            const auto right_value = *--stack_top;
+            const auto left_value = *--stack_top;
 
-                    stack_.push_back(Value{
-                        apply_visitor(Is_equal_visitor{}, left_value.variant, right_value.variant)
-                    });
+            if (!are_numbers(left_value, right_value)) {
+                throw VM_error{"Operands must be numbers."};
+            }
+            *stack_top++ = Value{left_value.as_number() > right_value.as_number()};
 
-                    break;
-                }
+            MOTTS_LOX_NEXT();
+        }
 
-                case Op_code::greater: {
-                    const auto right_value = get<double>(stack_.back().variant);
-                    stack_.pop_back();
+        // `<=` is defined as not `>`, so it is true rather than false when either operand is NaN
+        MOTTS_LOX_CASE(less_equal): {
+            const auto right_value = *--stack_top;
+            const auto left_value = *--stack_top;
 
-                    const auto left_value = get<double>(stack_.back().variant);
-                    stack_.pop_back();
+            if (!are_numbers(left_value, right_value)) {
+                throw VM_error{"Operands must be numbers."};
+            }
+            *stack_top++ = Value{!(left_value.as_number() > right_value.as_number())};
 
-                    stack_.push_back(Value{left_value > right_value});
+            MOTTS_LOX_NEXT();
+        }
 
-                    break;
-                }
+        MOTTS_LOX_CASE(less): {
+            const auto right_value = *--stack_top;
+            const auto left_value = *--stack_top;
 
-                case Op_code::less: {
-                    const auto right_value = get<double>(stack_.back().variant);
-                    stack_.pop_back();
+            if (!are_numbers(left_value, right_value)) {
+                throw VM_error{"Operands must be numbers."};
+            }
+            *stack_top++ = Value{left_value.as_number() < right_value.as_number()};
 
-                    const auto left_value = get<double>(stack_.back().variant);
-                    stack_.pop_back();
+            MOTTS_LOX_NEXT();
+        }
 
-                    stack_.push_back(Value{left_value < right_value});
+        // `>=` is defined as not `<`, so it is true rather than false when either operand is NaN
+        MOTTS_LOX_CASE(greater_equal): {
+            const auto right_value = *--stack_top;
+            const auto left_value = *--stack_top;
 
-                    break;
-                }
+            if (!are_numbers(left_value, right_value)) {
+                throw VM_error{"Operands must be numbers."};
+            }
+            *stack_top++ = Value{!(left_value.as_number() < right_value.as_number())};
 
-                case Op_code::add: {
-                    const auto right_value = move(stack_.back());
-                    stack_.pop_back();
+            MOTTS_LOX_NEXT();
+        }
 
-                    const auto left_value = move(stack_.back());
-                    stack_.pop_back();
+        MOTTS_LOX_CASE(add): {
+            const auto right_value = *--stack_top;
+            const auto left_value = *--stack_top;
+
+            if (are_numbers(left_value, right_value)) {
+                *stack_top++ = Value{left_value.as_number() + right_value.as_number()};
+            } else if (is_string(left_value) && is_string(right_value)) {
+                stack_top_ = stack_top;
+                *stack_top++ = Value{heap_.make_string(
+                    as_string(left_value)->str + as_string(right_value)->str
+                )};
+            } else {
+                throw VM_error{"Operands must be two numbers or two strings."};
+            }
 
-                    stack_.push_back(apply_visitor(Plus_visitor{}, left_value.variant, right_value.variant));
+            MOTTS_LOX_NEXT();
+        }
 
-                    break;
-                }
+        MOTTS_LOX_CASE(subtract): {
+            const auto right_value = *--stack_top;
+            const auto left_value = *--stack_top;
 
-                case Op_code::subtract: {
-                    const auto right_value = get<double>(stack_.back().variant);
-                    stack_.pop_back();
+            if (!are_numbers(left_value, right_value)) {
+                throw VM_error{"Operands must be numbers."};
+            }
+            *stack_top++ = Value{left_value.as_number() - right_value.as_number()};
 
-                    const auto left_value = get<double>(stack_.back().variant);
-                    stack_.pop_back();
+            MOTTS_LOX_NEXT();
+        }
 
-                    stack_.push_back(Value{left_value - right_value});
+        MOTTS_LOX_CASE(multiply): {
+            const auto right_value = *--stack_top;
+            const auto left_value = *--stack_top;
 
-                    break;
-                }
+            if (!are_numbers(left_value, right_value)) {
+                throw VM_error{"Operands must be numbers."};
+            }
+            *stack_top++ = Value{left_value.as_number() * right_value.as_number()};
 
-                case Op_code::multiply: {
-                    const auto right_value = get<double>(stack_.back().variant);
-                    stack_.pop_back();
+            MOTTS_LOX_NEXT();
+        }
 
-                    const auto left_value = get<double>(stack_.back().variant);
-                    stack_.pop_back();
+        MOTTS_LOX_CASE(divide): {
+            const auto right_value = *--stack_top;
+            const auto left_value = *--stack_top;
 
-                    stack_.push_back(Value{left_value * right_value});
+            if (!are_numbers(left_value, right_value)) {
+                throw VM_error{"Operands must be numbers."};
+            }
+            *stack_top++ = Value{left_value.as_number() / right_value.as_number()};
 
-                    break;
-                }
+            MOTTS_LOX_NEXT();
+        }
 
-                case Op_code::divide: {
-                    const auto right_value = get<double>(stack_.back().variant);
-                    stack_.pop_back();
+        MOTTS_LOX_CASE(not_): {
+            stack_top[-1] = Value{stack_top[-1].is_falsey()};
 
-                    const auto left_value = get<double>(stack_.back().variant);
-                    stack_.pop_back();
+            MOTTS_LOX_NEXT();
+        }
 
-                    stack_.push_back(Value{left_value / right_value});
+        MOTTS_LOX_CASE(negate): {
+            const auto value = stack_top[-1];
+            if (!value.is_number()) {
+                throw VM_error{"Operand must be a number."};
+            }
+            stack_top[-1] = Value{-value.as_number()};
 
-                    break;
-                }
+            MOTTS_LOX_NEXT();
+        }
 
-                case Op_code::not_: {
-                    const auto value = apply_visitor(Is_truthy_visitor{}, stack_.back().variant);
-                    stack_.pop_back();
-                    stack_.push_back(Value{!value});
+        MOTTS_LOX_CASE(print): {
+            print_value(out_, *--stack_top);
+            out_ << "\n";
 
-                    break;
-                }
+            MOTTS_LOX_NEXT();
+        }
 
-                case Op_code::negate: {
-                    // TODO Convert error: "Operand must be a number."
-                    const auto value = get<double>(stack_.back().variant);
-                    stack_.pop_back();
-                    stack_.push_back(Value{-value});
+        MOTTS_LOX_CASE(jump): {
+            const auto jump_length = read_jump_operand(ip);
+            ip += 2;
 
-                    break;
-                }
+            ip += jump_length;
 
-                case Op_code::print: {
-                    print_value(stack_.back());
-                    cout << "\n";
-                    stack_.pop_back();
+            MOTTS_LOX_NEXT();
+        }
 
-                    break;
-                }
+        MOTTS_LOX_CASE(jump_if_false): {
+            const auto jump_length = read_jump_operand(ip);
+            ip += 2;
 
-                case Op_code::jump: {
-                    // DANGER! Reinterpret cast: The two bytes following a jump_if_false instruction
-                    // are supposed to represent a single uint16 number
-                    const auto jump_length = reinterpret_cast<const uint16_t&>(*ip_);
-                    ip_ += 2;
+            if (stack_top[-1].is_falsey()) {
+                ip += jump_length;
+            }
 
-                    ip_ += jump_length;
+            MOTTS_LOX_NEXT();
+        }
 
-                    break;
-                }
+        MOTTS_LOX_CASE(loop): {
+            const auto jump_length = read_jump_operand(ip);
+            ip -= 1;
 
-                case Op_code::jump_if_false: {
-                    // DANGER! Reinterpret cast: The two bytes following a jump_if_false instruction
-                    // are supposed to represent a single uint16 number
-                    const auto jump_length = reinterpret_cast<const uint16_t&>(*ip_);
-                    ip_ += 2;
+            ip -= jump_length;
 
-                    if (!apply_visitor(Is_truthy_visitor{}, stack_.back().variant)) {
-                        ip_ += jump_length;
-                    }
+            MOTTS_LOX_NEXT();
+        }
 
-                    break;
-                }
+        MOTTS_LOX_CASE(call): {
+            const auto arg_count = *ip++;
 
-                case Op_code::loop: {
-                    // DANGER! Reinterpret cast: The two bytes following a loop instruction
-                    // are supposed to represent a single uint16 number
-                    const auto jump_length = reinterpret_cast<const uint16_t&>(*ip_);
-                    ip_ -= 1;
+            frame->ip = ip;
+            stack_top_ = stack_top;
+            call_value(stack_top[-1 - arg_count], arg_count);
+            stack_top = stack_top_;
+            MOTTS_LOX_LOAD_FRAME();
 
-                    ip_ -= jump_length;
+            MOTTS_LOX_NEXT();
+        }
 
-                    break;
-                }
+        MOTTS_LOX_CASE(invoke): {
+            auto& cache = frame->closure->function->chunk.property_caches[read_long_operand(ip)];
+            ip += 3;
+            const auto arg_count = *ip++;
 
-                case Op_code::return_: {
-                    return;
-                }
+            const auto receiver = stack_top[-1 - arg_count];
+            if (!is_instance(receiver)) {
+                throw VM_error{"Only instances have properties."};
+            }
+            const auto instance = as_instance(receiver);
+
+            if (instance->shape->id != cache.shape_id) {
+                update_get_cache(cache, *instance, as_string(constants[cache.name_constant]));
+            }
+
+            frame->ip = ip;
+            stack_top_ = stack_top;
+            if (cache.method) {
+                // The receiver is already where the method's `this` goes, so there's no bound method to make
+                call(cache.method, arg_count);
+            } else {
+                // A field holding something callable
+                const auto callee = instance->fields[cache.slot];
+                stack_top_[-1 - arg_count] = callee;
+                call_value(callee, arg_count);
+            }
+            stack_top = stack_top_;
+            MOTTS_LOX_LOAD_FRAME();
+
+            MOTTS_LOX_NEXT();
+        }
+
+        MOTTS_LOX_CASE(super_invoke): {
+            const auto& cache = frame->closure->function->chunk.property_caches[read_long_operand(ip)];
+            ip += 3;
+            const auto arg_count = *ip++;
+
+            const auto superclass = as_class(*--stack_top);
+            const auto method = find_method(*superclass, as_string(constants[cache.name_constant]));
+
+            frame->ip = ip;
+            stack_top_ = stack_top;
+            call(method, arg_count);
+            stack_top = stack_top_;
+            MOTTS_LOX_LOAD_FRAME();
+
+            MOTTS_LOX_NEXT();
+        }
+
+        MOTTS_LOX_CASE(closure): {
+            // Capturing upvalues allocates too, so push the closure before capturing
+            stack_top_ = stack_top;
+            const auto closure = heap_.make<Obj_closure>(as_function(constants[*ip++]));
+            *stack_top++ = Value{closure};
+            stack_top_ = stack_top;
+            ip = capture_upvalues(*closure, ip, slots, *frame->closure);
+
+            MOTTS_LOX_NEXT();
+        }
+
+        MOTTS_LOX_CASE(closure_long): {
+            stack_top_ = stack_top;
+            const auto closure = heap_.make<Obj_closure>(as_function(constants[read_long_operand(ip)]));
+            *stack_top++ = Value{closure};
+            stack_top_ = stack_top;
+            ip = capture_upvalues(*closure, ip + 3, slots, *frame->closure);
+
+            MOTTS_LOX_NEXT();
+        }
+
+        MOTTS_LOX_CASE(close_upvalue): {
+            close_upvalues(stack_top - 1);
+            --stack_top;
+
+            MOTTS_LOX_NEXT();
+        }
+
+        MOTTS_LOX_CASE(class_): {
+            stack_top_ = stack_top;
+            *stack_top++ = Value{make_class(as_string(constants[*ip++]))};
+
+            MOTTS_LOX_NEXT();
+        }
+
+        MOTTS_LOX_CASE(class_long): {
+            stack_top_ = stack_top;
+            *stack_top++ = Value{make_class(as_string(constants[read_long_operand(ip)]))};
+            ip += 3;
+
+            MOTTS_LOX_NEXT();
+        }
+
+        MOTTS_LOX_CASE(inherit): {
+            const auto superclass = stack_top[-2];
+            if (!is_obj_type(superclass, Obj_type::class_)) {
+                throw VM_error{"Superclass must be a class."};
             }
+
+            // Methods are copied down when the subclass is made, so a method call never walks the class chain
+            const auto subclass = as_class(stack_top[-1]);
+            subclass->methods = as_class(superclass)->methods;
+            subclass->initializer = as_class(superclass)->initializer;
+            --stack_top;
+
+            MOTTS_LOX_NEXT();
+        }
+
+        MOTTS_LOX_CASE(method): {
+            define_method(as_class(stack_top[-2]), as_string(constants[*ip++]), as_closure(stack_top[-1]));
+            --stack_top;
+
+            MOTTS_LOX_NEXT();
+        }
+
+        MOTTS_LOX_CASE(method_long): {
+            define_method(as_class(stack_top[-2]), as_string(constants[read_long_operand(ip)]), as_closure(stack_top[-1]));
+            ip += 3;
+            --stack_top;
+
+            MOTTS_LOX_NEXT();
+        }
+
+        MOTTS_LOX_CASE(return_): {
+            const auto result = *--stack_top;
+            close_upvalues(slots);
+
+            // Discard the callee's whole window, including the callee itself and its arguments
+            stack_top = slots;
+            --frame_count_;
+            if (frame_count_ == 0) {
+                return;
+            }
+
+            *stack_top++ = result;
+            MOTTS_LOX_LOAD_FRAME();
+
+            MOTTS_LOX_NEXT();
         }
+
+        #ifndef MOTTS_LOX_USE_COMPUTED_GOTO
+            }
+            }
+        #endif
+
+        #undef MOTTS_LOX_CASE
+        #undef MOTTS_LOX_NEXT
+        #undef MOTTS_LOX_LOAD_FRAME
     }
 }}
@@ -1,27 +1,141 @@
 #pragma once
 
-#include <stdexcept>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <ostream>
 #include <string>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
+#include "bytecode_cache.hpp"
 #include "chunk.hpp"
+#include "exception.hpp"
+#include "heap.hpp"
+#include "native.hpp"
+#include "object.hpp"
 #include "value.hpp"
 
 namespace motts { namespace lox {
+    class VM;
+
+    // A script that's been compiled once, to be executed any number of times. It can only be executed by the VM that
+    // compiled it, and only while that VM lives.
+    class Program {
+        private:
+            friend VM;
+            explicit Program(Obj_function* script);
+
+            Obj_function* script_;
+    };
+
     class VM {
         public:
+            explicit VM();
+
+            // Print statements write to `out` rather than to stdout. It must outlive the VM.
+            explicit VM(std::ostream& out);
+
+            // Like the above, but collects garbage as often as gc_settings says
+            explicit VM(std::ostream& out, const Gc_settings& gc_settings);
+
             void interpret(const std::string& source);
 
+            // Like the above, but runs the bytecode cached at cache_path if it was compiled from this same source, and
+            // otherwise compiles the source and writes the cache for next time
+            void interpret(const std::string& source, const std::string& cache_path);
+
+            // For a host that runs the same script many times. Compiling happens once, and the VM keeps every program
+            // for as long as it lives. Unlike interpret, where each script sees the globals the last one left behind,
+            // each execution starts from fresh globals that hold only the natives, so one run can't leak into the next.
+            Program compile(const std::string& source);
+            void execute(const Program&);
+
+            // Makes a global function that calls back into the host. The VM checks the argument count before calling.
+            void define_native(const std::string& name, Native_fn, int arity);
+
+            // Like the above, but the arity and the argument and return conversions come from fn's signature. See
+            // native.hpp for the types it can take and return.
+            template<typename F>
+                void define_native(const std::string& name, F fn) {
+                    using Binding = typename Native_signature<F>::Binding;
+                    define_native(name, Binding::bind(std::move(fn), heap_), Binding::arity);
+                }
+
+            // Bytes held by objects the VM has made and not yet freed, including garbage not yet collected
+            std::size_t bytes_allocated() const;
+
         private:
+            void execute(Obj_function* script);
             void run();
 
-            const Chunk* chunk_;
-            std::vector<std::uint8_t>::const_iterator ip_;
-            std::vector<Value> stack_;
-            std::unordered_map<std::string, Value> globals_;
-    };
+            // Each of these leaves the VM's stack_top_ and frames_ ready for run to reload
+            void call_value(Value callee, int arg_count);
+            void call(Obj_closure*, int arg_count);
+
+            // Reads the closure instruction's upvalue operands, which start at ip, and returns the ip just past them
+            const std::uint8_t* capture_upvalues(
+                Obj_closure&, const std::uint8_t* ip, Value* slots, const Obj_closure& enclosing
+            );
+            Obj_upvalue* capture_upvalue(Value* local);
+            void close_upvalues(const Value* last);
+
+            void mark_roots();
+
+            // Called on a cache miss. Looks up the property on the instance's current shape and its class, and
+            // re-points the cache at what it finds.
+            void update_get_cache(Property_cache&, const Obj_instance&, const Obj_string* name);
+            void update_set_cache(Property_cache&, const Obj_instance&, Obj_string* name);
+
+            Obj_class* make_class(Obj_string* name);
+            void define_method(Obj_class*, const Obj_string* name, Obj_closure* method);
+
+            // Throws if the class has no such method
+            Obj_closure* find_method(const Obj_class&, const Obj_string* name);
+
+            struct Call_frame {
+                Obj_closure* closure;
+
+                // The caller's ip is saved here while it calls another function
+                const std::uint8_t* ip;
+
+                // This frame's window into the stack. Slot zero is the function being called, then its arguments,
+                // then its locals.
+                Value* slots;
+            };
+
+            static constexpr int frames_max_ {64};
+
+            // Locals are addressed with a one-byte slot operand, so a frame's window is at most this big
+            static constexpr int frame_slots_max_ {256};
+
+            // The stack is allocated once at its full size and never grows, so pushes and pops are a pointer bump
+            // with no bounds check. Overflow is checked only when a call pushes a frame.
+            static constexpr int stack_max_ {frames_max_ * frame_slots_max_};
+
+            std::ostream& out_;
+            Heap heap_;
+            std::array<Call_frame, frames_max_> frames_;
+            int frame_count_ {};
+            std::unique_ptr<Value[]> stack_ {std::make_unique<Value[]>(stack_max_)};
+            Value* stack_top_ {stack_.get()};
+            std::unordered_map<const Obj_string*, Value, Obj_string_hash> globals_;
+
+            // Kept to start each program's globals from
+            std::unordered_map<const Obj_string*, Value, Obj_string_hash> natives_;
+
+            // Sorted by stack slot, highest first
+            Obj_upvalue* open_upvalues_ {};
+
+            std::uint64_t next_shape_id_ {1};
+            Obj_string* const init_string_ {heap_.make_string("init")};
+
+            // Functions loaded from a bytecode cache run straight out of the mapped file, so the mapping has to live
+            // as long as the functions might be called
+            std::vector<std::unique_ptr<Mapped_script>> mapped_scripts_;
 
-    struct VM_error : std::runtime_error {
-        using std::runtime_error::runtime_error;
+            std::vector<Obj_function*> compiled_scripts_;
     };
 }}
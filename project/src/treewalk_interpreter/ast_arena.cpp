@@ -0,0 +1,37 @@
+#include "ast_arena.hpp"
+
+#include <algorithm>
+#include <cstdint>
+
+using std::max;
+using std::size_t;
+using std::uintptr_t;
+
+namespace motts { namespace lox {
+    constexpr size_t Ast_arena::block_size_;
+
+    Ast_arena::~Ast_arena() {
+        // Reverse order, so nodes are destroyed before the nodes they were built from
+        for (auto destructor = destructors_.crbegin(); destructor != destructors_.crend(); ++destructor) {
+            destructor->destroy(destructor->object);
+        }
+    }
+
+    void* Ast_arena::allocate(size_t size, size_t alignment) {
+        const auto padding = (alignment - reinterpret_cast<uintptr_t>(next_) % alignment) % alignment;
+        if (!next_ || static_cast<size_t>(end_ - next_) < padding + size) {
+            // Blocks come from operator new[], so they start aligned for any node type
+            const auto new_block_size = max(block_size_, size);
+            blocks_.push_back(std::make_unique<char[]>(new_block_size));
+            next_ = blocks_.back().get();
+            end_ = next_ + new_block_size;
+
+            return allocate(size, alignment);
+        }
+
+        const auto object = next_ + padding;
+        next_ = object + size;
+
+        return object;
+    }
+}}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+namespace motts { namespace lox {
+    /*
+    AST nodes live as long as the program they were parsed from, and they're never freed one at a time, so rather than
+    giving each node to the garbage collector, nodes are bump-allocated out of large blocks and all freed together when
+    the arena is destroyed. Nodes refer to each other, and the interpreter refers to them, by plain pointer.
+    */
+    class Ast_arena {
+        public:
+            explicit Ast_arena() = default;
+            ~Ast_arena();
+
+            Ast_arena(const Ast_arena&) = delete;
+            Ast_arena& operator=(const Ast_arena&) = delete;
+            Ast_arena(Ast_arena&&) = delete;
+            Ast_arena& operator=(Ast_arena&&) = delete;
+
+            template<typename T, typename... Args>
+                T* make(Args&&... args) {
+                    const auto object = new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+                    destructors_.push_back({object, [] (void* object) {
+                        static_cast<T*>(object)->~T();
+                    }});
+
+                    return object;
+                }
+
+        private:
+            void* allocate(std::size_t size, std::size_t alignment);
+
+            static constexpr std::size_t block_size_ {64 * 1024};
+
+            std::vector<std::unique_ptr<char[]>> blocks_;
+            char* next_ {};
+            char* end_ {};
+
+            // The memory is freed in bulk, but nodes still own strings and vectors that need their destructors run
+            struct Destructor {
+                void* object;
+                void (*destroy)(void*);
+            };
+            std::vector<Destructor> destructors_;
+    };
+}}
@@ -6,30 +6,29 @@ using std::move;
 using std::string;
 
 using boost::lexical_cast;
-using gcpp::deferred_ptr;
 
 namespace motts { namespace lox {
-    void Ast_printer::visit(const deferred_ptr<const Binary_expr>& expr) {
+    void Ast_printer::visit(const Binary_expr* expr) {
         result_ += "(" + expr->op.lexeme + " ";
-        expr->left->accept(expr->left, *this);
+        expr->left->accept(*this);
         result_ += " ";
-        expr->right->accept(expr->right, *this);
+        expr->right->accept(*this);
         result_ += ")";
     }
 
-    void Ast_printer::visit(const deferred_ptr<const Grouping_expr>& expr) {
+    void Ast_printer::visit(const Grouping_expr* expr) {
         result_ += "(group ";
-        expr->expr->accept(expr->expr, *this);
+        expr->expr->accept(*this);
         result_ += ")";
     }
 
-    void Ast_printer::visit(const deferred_ptr<const Literal_expr>& expr) {
+    void Ast_printer::visit(const Literal_expr* expr) {
         result_ += lexical_cast<string>(expr->value);
     }
 
-    void Ast_printer::visit(const deferred_ptr<const Unary_expr>& expr) {
+    void Ast_printer::visit(const Unary_expr* expr) {
         result_ += "(" + expr->op.lexeme + " ";
-        expr->right->accept(expr->right, *this);
+        expr->right->accept(*this);
         result_ += ")";
     }
 
@@ -3,8 +3,8 @@
 #include "callable_fwd.hpp"
 
 #include <string>
-#include <vector>
 
+#include <gsl/span>
 #pragma warning(push, 0)
     #include <deferred_heap.h>
 #pragma warning(pop)
@@ -15,7 +15,7 @@ namespace motts { namespace lox {
     struct Callable {
         virtual Literal call(
             const gcpp::deferred_ptr<Callable>& owner_this,
-            const std::vector<Literal>& arguments
+            gsl::span<const Literal> arguments
         ) = 0;
         virtual int arity() const = 0;
         virtual std::string to_string() const = 0;
@@ -3,38 +3,78 @@
 #include "function.hpp"
 #include "interpreter.hpp"
 
+using std::make_unique;
 using std::string;
+using std::uint64_t;
 using std::unordered_map;
-using std::vector;
 
 using gcpp::deferred_heap;
 using gcpp::deferred_ptr;
 using gcpp::static_pointer_cast;
+using gsl::span;
 
 namespace motts { namespace lox {
+    /*
+        class Shape
+    */
+
+    Shape::Shape(uint64_t& next_id) :
+        next_id_ {next_id},
+        id_ {next_id++}
+    {}
+
+    uint64_t Shape::id() const {
+        return id_;
+    }
+
+    int Shape::find(const string& name) const {
+        const auto found = offsets_.find(name);
+        if (found == offsets_.cend()) {
+            return -1;
+        }
+
+        return found->second;
+    }
+
+    Shape* Shape::with(const string& name) {
+        auto& next = transitions_[name];
+        if (!next) {
+            next = make_unique<Shape>(next_id_);
+            next->offsets_ = offsets_;
+            next->offsets_.emplace(name, static_cast<int>(offsets_.size()));
+        }
+
+        return next.get();
+    }
+
     /*
         class Class
     */
 
     Class::Class(
         deferred_heap& deferred_heap_arg,
+        uint64_t& next_shape_id,
         const string& name,
         const deferred_ptr<Class>& superclass,
         unordered_map<string, deferred_ptr<Function>>&& methods
     ) :
         deferred_heap_ {deferred_heap_arg},
         name_ {name},
-        superclass_ {superclass},
-        methods_ {move(methods)}
-    {}
+        methods_ {move(methods)},
+        empty_shape_ {next_shape_id}
+    {
+        if (superclass) {
+            // Doesn't overwrite the methods this class overrides
+            methods_.insert(superclass->methods_.cbegin(), superclass->methods_.cend());
+        }
+    }
 
-    Literal Class::call(const deferred_ptr<Callable>& owner_this, const vector<Literal>& arguments) {
+    Literal Class::call(const deferred_ptr<Callable>& owner_this, span<const Literal> arguments) {
         auto instance = deferred_heap_.make<Instance>(static_pointer_cast<Class>(owner_this));
 
         const auto found_init = methods_.find("init");
         if (found_init != methods_.cend()) {
-            const auto bound_init = found_init->second->bind(instance);
-            bound_init->call(bound_init, arguments);
+            found_init->second->call_method(instance, arguments);
         }
 
         return Literal{instance};
@@ -53,16 +93,25 @@ namespace motts { namespace lox {
     }
 
     Literal Class::get(const deferred_ptr<Instance>& instance_to_bind, const string& name) const {
-        const auto found_method = methods_.find(name);
-        if (found_method != methods_.cend()) {
-            return Literal{found_method->second->bind(instance_to_bind)};
+        const auto method = find_method(name);
+        if (!method) {
+            throw Runtime_error{"Undefined property '" + name + "'."};
         }
 
-        if (superclass_) {
-            return superclass_->get(instance_to_bind, name);
+        return Literal{method->bind(instance_to_bind)};
+    }
+
+    deferred_ptr<Function> Class::find_method(const string& name) const {
+        const auto found_method = methods_.find(name);
+        if (found_method == methods_.cend()) {
+            return nullptr;
         }
 
-        throw Runtime_error{"Undefined property '" + name + "'."};
+        return found_method->second;
+    }
+
+    Shape* Class::empty_shape() {
+        return &empty_shape_;
     }
 
     /*
@@ -70,27 +119,49 @@ namespace motts { namespace lox {
     */
 
     Instance::Instance(const deferred_ptr<Class>& class_arg) :
-        class_ {class_arg}
+        class_ {class_arg},
+        shape_ {class_->empty_shape()}
     {}
 
     Literal Instance::get(const deferred_ptr<Instance>& owner_this, const string& name) {
-        const auto found_field = fields_.find(name);
-        if (found_field != fields_.cend()) {
-            return found_field->second;
+        const auto offset = shape_->find(name);
+        if (offset != -1) {
+            return fields_[offset];
         }
 
         return class_->get(owner_this, name);
     }
 
     void Instance::set(const string& name, const Literal& value) {
-        const auto found = fields_.find(name);
-        if (found != fields_.end()) {
-            found->second = value;
+        const auto offset = shape_->find(name);
+        if (offset != -1) {
+            fields_[offset] = value;
         } else {
-            fields_[name] = value;
+            add_field(shape_->with(name), value);
         }
     }
 
+    Shape* Instance::shape() const {
+        return shape_;
+    }
+
+    Literal& Instance::field(int offset) {
+        return fields_[offset];
+    }
+
+    void Instance::add_field(Shape* next_shape, const Literal& value) {
+        shape_ = next_shape;
+        fields_.push_back(value);
+    }
+
+    deferred_ptr<Function> Instance::find_method(const string& name) const {
+        if (shape_->find(name) != -1) {
+            return nullptr;
+        }
+
+        return class_->find_method(name);
+    }
+
     string Instance::to_string() const {
         return class_->to_string() + " instance";
     }
@@ -2,6 +2,8 @@
 
 #include "class_fwd.hpp"
 
+#include <cstdint>
+#include <memory>
 #include <string>
 #include <unordered_map>
 #include <vector>
@@ -11,24 +13,63 @@
 #include "literal.hpp"
 
 namespace motts { namespace lox {
+    /*
+    Instances that gained the same fields in the same order share a shape, which maps each field name to the index of
+    its value in the instance's field vector. Adding a field moves an instance along a transition to the next shape, and
+    shapes are made only the first time some instance takes that transition. Each class owns the tree of shapes rooted
+    at its empty shape.
+    */
+    class Shape {
+        public:
+            // Takes its id from next_id, which is the interpreter's, and so do the shapes it transitions to
+            explicit Shape(std::uint64_t& next_id);
+
+            // Unique among all shapes the interpreter ever made, so a cache can tell shapes apart even after one is
+            // freed. It's 64 bits so it can't wrap around to an id a stale cache entry still holds.
+            std::uint64_t id() const;
+
+            // Returns -1 if this shape has no such field
+            int find(const std::string& name) const;
+
+            // The shape of an instance of this shape after it gains the named field
+            Shape* with(const std::string& name);
+
+        private:
+            std::uint64_t& next_id_;
+            std::uint64_t id_;
+            std::unordered_map<std::string, int> offsets_;
+            std::unordered_map<std::string, std::unique_ptr<Shape>> transitions_;
+    };
+
     class Class : public Callable {
         public:
             Class(
                 gcpp::deferred_heap&,
+                std::uint64_t& next_shape_id,
                 const std::string& name,
                 const gcpp::deferred_ptr<Class>& superclass,
                 std::unordered_map<std::string, gcpp::deferred_ptr<Function>>&& methods
             );
-            Literal call(const gcpp::deferred_ptr<Callable>& owner_this, const std::vector<Literal>& arguments) override;
+            Literal call(const gcpp::deferred_ptr<Callable>& owner_this, gsl::span<const Literal> arguments) override;
             int arity() const override;
             std::string to_string() const override;
             Literal get(const gcpp::deferred_ptr<Instance>& instance_to_bind, const std::string& name) const;
 
+            // Returns null if there's no such method
+            gcpp::deferred_ptr<Function> find_method(const std::string& name) const;
+
+            // The shape of a new instance
+            Shape* empty_shape();
+
         private:
             gcpp::deferred_heap& deferred_heap_;
             std::string name_;
-            gcpp::deferred_ptr<Class> superclass_;
+
+            // Includes inherited methods, which are copied in when the class is made, so a lookup never walks the
+            // superclass chain
             std::unordered_map<std::string, gcpp::deferred_ptr<Function>> methods_;
+
+            Shape empty_shape_;
     };
 
     class Instance {
@@ -36,10 +77,23 @@ namespace motts { namespace lox {
             Instance(const gcpp::deferred_ptr<Class>&);
             Literal get(const gcpp::deferred_ptr<Instance>& owner_this, const std::string& name);
             void set(const std::string& name, const Literal& value);
+
+            // Returns null if a field has this name or if there's no such method
+            gcpp::deferred_ptr<Function> find_method(const std::string& name) const;
+
+            // For property caches, which look fields up by offset rather than by name
+            Shape* shape() const;
+            Literal& field(int offset);
+
+            // The next shape must be the current shape's transition for the new field
+            void add_field(Shape* next_shape, const Literal& value);
             std::string to_string() const;
 
         private:
+            // Also keeps alive the shapes, which belong to the class
             gcpp::deferred_ptr<Class> class_;
-            std::unordered_map<std::string, Literal> fields_;
+
+            Shape* shape_;
+            std::vector<Literal> fields_;
     };
 }}
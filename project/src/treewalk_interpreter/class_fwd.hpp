@@ -3,4 +3,5 @@
 namespace motts { namespace lox {
     class Class;
     class Instance;
+    class Shape;
 }}
@@ -1,55 +1,44 @@
 #include "environment.hpp"
 
+using std::size_t;
 using std::string;
 using gcpp::deferred_ptr;
 
 namespace motts { namespace lox {
     Environment::Environment() = default;
 
-    Environment::Environment(const deferred_ptr<Environment>& enclosed) :
+    Environment::Environment(const deferred_ptr<Environment>& enclosed, size_t slot_count) :
         enclosed_ {enclosed}
-    {}
+    {
+        slots_.reserve(slot_count);
+    }
 
-    Environment::iterator Environment::find_in_chain(const string& var_name) {
-        const auto found_own = values_.find(var_name);
-        if (found_own != end()) {
-            return found_own;
-        }
+    Environment::iterator Environment::find(const string& var_name) {
+        return values_.find(var_name);
+    }
 
-        if (enclosed_) {
-            const auto found_enclosed = enclosed_->find_in_chain(var_name);
-            if (found_enclosed != enclosed_->end()) {
-                return found_enclosed;
-            }
-        }
+    Environment::iterator Environment::end() {
+        return values_.end();
+    }
+
+    Literal& Environment::find_own_or_make(const string& var_name) {
+        return values_[var_name];
+    }
 
-        return end();
+    void Environment::define(const Literal& value) {
+        slots_.push_back(value);
     }
 
-    Environment::iterator Environment::find_in_chain(const string& var_name, int depth) {
+    Literal& Environment::get_at(int depth, int slot) {
         auto enclosed_at_depth = this;
         for (; depth; --depth) {
             enclosed_at_depth = enclosed_at_depth->enclosed_.get();
         }
 
-        const auto found_at_depth = enclosed_at_depth->find_in_chain(var_name);
-        if (found_at_depth != enclosed_at_depth->end()) {
-            return found_at_depth;
-        }
-
-        return end();
-    }
-
-    Environment::iterator Environment::end() {
-        return values_.end();
+        return enclosed_at_depth->slots_[slot];
     }
 
-    Literal& Environment::find_own_or_make(const string& var_name) {
-        const auto found_own = values_.find(var_name);
-        if (found_own != end()) {
-            return found_own->second;
-        }
-
-        return values_[var_name];
+    bool Environment::is_global() const {
+        return !enclosed_;
     }
 }}
@@ -1,7 +1,9 @@
 #pragma once
 
+#include <cstddef>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 #pragma warning(push, 0)
     #include <deferred_heap.h>
@@ -10,18 +12,35 @@
 #include "literal.hpp"
 
 namespace motts { namespace lox {
+    /*
+    The global environment looks up variables by name, since globals can be referred to before they're declared and the
+    resolver doesn't track them. Every other environment is a flat array of slots. The resolver numbers each local in
+    the order it's declared in its scope, and the interpreter defines locals in that same order, so a resolved variable
+    is found by hopping up some number of enclosing environments and indexing the slot, with no hashing.
+    */
     class Environment {
         public:
             using iterator = std::unordered_map<std::string, Literal>::iterator;
 
+            // The global environment
             explicit Environment();
-            explicit Environment(const gcpp::deferred_ptr<Environment>& enclosed);
-            iterator find_in_chain(const std::string& var_name);
-            iterator find_in_chain(const std::string& var_name, int depth);
+
+            // A local environment, with room for `slot_count` locals before it has to grow
+            explicit Environment(const gcpp::deferred_ptr<Environment>& enclosed, std::size_t slot_count = 0);
+
+            // Globals
+            iterator find(const std::string& var_name);
             iterator end();
             Literal& find_own_or_make(const std::string& var_name);
 
+            // Locals
+            void define(const Literal&);
+            Literal& get_at(int depth, int slot);
+
+            bool is_global() const;
+
         private:
+            std::vector<Literal> slots_;
             std::unordered_map<std::string, Literal> values_;
             gcpp::deferred_ptr<Environment> enclosed_;
     };
@@ -1,9 +1,6 @@
 #pragma once
 
-#pragma warning(push, 0)
-    #include <deferred_heap.h>
-#pragma warning(pop)
-
+#include "ast_arena.hpp"
 #include "exception.hpp"
 #include "expression_visitor_fwd.hpp"
 #include "token.hpp"
@@ -43,19 +40,21 @@ namespace motts { namespace lox {
             the visitor, then the collector is aware that there's another reference out there. But in C++, `this` is a
             non-owning pointer. If there's an owning smart pointer out there, then `accept` doesn't know about it.
 
-            That turns out to be a problem, because the definition of `accept` needs to be able to pass shared ownership
-            to the visitor. So even though the compiler already generates an implicit `this` parameter, we still need an
-            `owner_this` smart pointer parameter, and the definition of `accept` will need to cast that `owner_this` to
-            the derived type that we know it really is.
+            In an earlier commit, that was a problem, because nodes were owned by smart pointers on the deferred heap,
+            and the definition of `accept` needed to pass shared ownership to the visitor. So `accept` took an extra
+            `owner_this` smart pointer parameter and cast it to the derived type that we knew it really was.
+
+            Now every node is allocated from the `Ast_arena`, which owns them all and frees them all at once when the
+            arena goes away. Nothing else owns a node, so a plain `this` is all the visitor needs.
         */
-        virtual void accept(const gcpp::deferred_ptr<const Expr>& owner_this, Expr_visitor&) const = 0;
+        virtual void accept(Expr_visitor&) const = 0;
 
         // Some derived expression types can be lvalues; some can't. To avoid
         // dynamic_cast tests, implement lvalue-ness polymorphically.
-        virtual gcpp::deferred_ptr<const Expr> make_assignment_expression(
-            gcpp::deferred_ptr<const Expr>&& lhs_expr,
-            gcpp::deferred_ptr<const Expr>&& rhs_expr,
-            gcpp::deferred_heap&,
+        virtual const Expr* make_assignment_expression(
+            const Expr* lhs_expr,
+            const Expr* rhs_expr,
+            Ast_arena&,
             const Runtime_error& throwable_if_not_lvalue
         ) const;
 
@@ -6,35 +6,32 @@ using std::move;
 using std::vector;
 
 using boost::optional;
-using deferred_heap_t = gcpp::deferred_heap;
-using gcpp::deferred_ptr;
-using gcpp::static_pointer_cast;
 
 namespace motts { namespace lox {
     /*
         struct Binary_expr
     */
 
-    Binary_expr::Binary_expr(deferred_ptr<const Expr>&& left_arg, Token&& op_arg, deferred_ptr<const Expr>&& right_arg) :
+    Binary_expr::Binary_expr(const Expr* left_arg, Token&& op_arg, const Expr* right_arg) :
         left {move(left_arg)},
         op {move(op_arg)},
         right {move(right_arg)}
     {}
 
-    void Binary_expr::accept(const deferred_ptr<const Expr>& owner_this, Expr_visitor& visitor) const {
-        visitor.visit(static_pointer_cast<const Binary_expr>(owner_this));
+    void Binary_expr::accept(Expr_visitor& visitor) const {
+        visitor.visit(this);
     }
 
     /*
         struct Grouping_expr
     */
 
-    Grouping_expr::Grouping_expr(deferred_ptr<const Expr>&& expr_arg) :
+    Grouping_expr::Grouping_expr(const Expr* expr_arg) :
         expr {move(expr_arg)}
     {}
 
-    void Grouping_expr::accept(const deferred_ptr<const Expr>& owner_this, Expr_visitor& visitor) const {
-        visitor.visit(static_pointer_cast<const Grouping_expr>(owner_this));
+    void Grouping_expr::accept(Expr_visitor& visitor) const {
+        visitor.visit(this);
     }
 
     /*
@@ -45,21 +42,21 @@ namespace motts { namespace lox {
         value {move(value_arg)}
     {}
 
-    void Literal_expr::accept(const deferred_ptr<const Expr>& owner_this, Expr_visitor& visitor) const {
-        visitor.visit(static_pointer_cast<const Literal_expr>(owner_this));
+    void Literal_expr::accept(Expr_visitor& visitor) const {
+        visitor.visit(this);
     }
 
     /*
         struct Unary_expr
     */
 
-    Unary_expr::Unary_expr(Token&& op_arg, deferred_ptr<const Expr>&& right_arg) :
+    Unary_expr::Unary_expr(Token&& op_arg, const Expr* right_arg) :
         op {move(op_arg)},
         right {move(right_arg)}
     {}
 
-    void Unary_expr::accept(const deferred_ptr<const Expr>& owner_this, Expr_visitor& visitor) const {
-        visitor.visit(static_pointer_cast<const Unary_expr>(owner_this));
+    void Unary_expr::accept(Expr_visitor& visitor) const {
+        visitor.visit(this);
     }
 
     /*
@@ -70,44 +67,44 @@ namespace motts { namespace lox {
         name {move(name_arg)}
     {}
 
-    void Var_expr::accept(const deferred_ptr<const Expr>& owner_this, Expr_visitor& visitor) const {
-        visitor.visit(static_pointer_cast<const Var_expr>(owner_this));
+    void Var_expr::accept(Expr_visitor& visitor) const {
+        visitor.visit(this);
     }
 
-    deferred_ptr<const Expr> Var_expr::make_assignment_expression(
-        deferred_ptr<const Expr>&& lhs_expr,
-        deferred_ptr<const Expr>&& rhs_expr,
-        deferred_heap_t& deferred_heap,
+    const Expr* Var_expr::make_assignment_expression(
+        const Expr* lhs_expr,
+        const Expr* rhs_expr,
+        Ast_arena& arena,
         const Runtime_error& /*throwable_if_not_lvalue*/
     ) const {
-        return deferred_heap.make<Assign_expr>(Token{static_pointer_cast<const Var_expr>(lhs_expr)->name}, move(rhs_expr));
+        return arena.make<Assign_expr>(Token{static_cast<const Var_expr*>(lhs_expr)->name}, move(rhs_expr));
     }
 
     /*
         struct Assign_expr
     */
 
-    Assign_expr::Assign_expr(Token&& name_arg, deferred_ptr<const Expr>&& value_arg) :
+    Assign_expr::Assign_expr(Token&& name_arg, const Expr* value_arg) :
         name {move(name_arg)},
         value {move(value_arg)}
     {}
 
-    void Assign_expr::accept(const deferred_ptr<const Expr>& owner_this, Expr_visitor& visitor) const {
-        visitor.visit(static_pointer_cast<const Assign_expr>(owner_this));
+    void Assign_expr::accept(Expr_visitor& visitor) const {
+        visitor.visit(this);
     }
 
     /*
         struct Logical_expr
     */
 
-    Logical_expr::Logical_expr(deferred_ptr<const Expr>&& left_arg, Token&& op_arg, deferred_ptr<const Expr>&& right_arg) :
+    Logical_expr::Logical_expr(const Expr* left_arg, Token&& op_arg, const Expr* right_arg) :
         left {move(left_arg)},
         op {move(op_arg)},
         right {move(right_arg)}
     {}
 
-    void Logical_expr::accept(const deferred_ptr<const Expr>& owner_this, Expr_visitor& visitor) const {
-        visitor.visit(static_pointer_cast<const Logical_expr>(owner_this));
+    void Logical_expr::accept(Expr_visitor& visitor) const {
+        visitor.visit(this);
     }
 
     /*
@@ -115,41 +112,43 @@ namespace motts { namespace lox {
     */
 
     Call_expr::Call_expr(
-        deferred_ptr<const Expr>&& callee_arg,
+        const Expr* callee_arg,
         Token&& closing_paren_arg,
-        vector<deferred_ptr<const Expr>>&& arguments_arg
+        vector<const Expr*>&& arguments_arg,
+        const Get_expr* method_callee_arg
     ) :
         callee {move(callee_arg)},
         closing_paren {move(closing_paren_arg)},
-        arguments {move(arguments_arg)}
+        arguments {move(arguments_arg)},
+        method_callee {method_callee_arg}
     {}
 
-    void Call_expr::accept(const deferred_ptr<const Expr>& owner_this, Expr_visitor& visitor) const {
-        visitor.visit(static_pointer_cast<const Call_expr>(owner_this));
+    void Call_expr::accept(Expr_visitor& visitor) const {
+        visitor.visit(this);
     }
 
     /*
         struct Get_expr
     */
 
-    Get_expr::Get_expr(deferred_ptr<const Expr>&& object_arg, Token&& name_arg) :
+    Get_expr::Get_expr(const Expr* object_arg, Token&& name_arg) :
         object {move(object_arg)},
         name {move(name_arg)}
     {}
 
-    void Get_expr::accept(const deferred_ptr<const Expr>& owner_this, Expr_visitor& visitor) const {
-        visitor.visit(static_pointer_cast<const Get_expr>(owner_this));
+    void Get_expr::accept(Expr_visitor& visitor) const {
+        visitor.visit(this);
     }
 
-    deferred_ptr<const Expr> Get_expr::make_assignment_expression(
-        deferred_ptr<const Expr>&& lhs_expr,
-        deferred_ptr<const Expr>&& rhs_expr,
-        deferred_heap_t& deferred_heap,
+    const Expr* Get_expr::make_assignment_expression(
+        const Expr* lhs_expr,
+        const Expr* rhs_expr,
+        Ast_arena& arena,
         const Runtime_error& /*throwable_if_not_lvalue*/
     ) const {
-        return deferred_heap.make<Set_expr>(
-            deferred_ptr<const Expr>{static_pointer_cast<const Get_expr>(lhs_expr)->object},
-            Token{static_pointer_cast<const Get_expr>(lhs_expr)->name},
+        return arena.make<Set_expr>(
+            static_cast<const Get_expr*>(lhs_expr)->object,
+            Token{static_cast<const Get_expr*>(lhs_expr)->name},
             move(rhs_expr)
         );
     }
@@ -158,14 +157,14 @@ namespace motts { namespace lox {
         struct Set_expr
     */
 
-    Set_expr::Set_expr(deferred_ptr<const Expr>&& object_arg, Token&& name_arg, deferred_ptr<const Expr>&& value_arg) :
+    Set_expr::Set_expr(const Expr* object_arg, Token&& name_arg, const Expr* value_arg) :
         object {move(object_arg)},
         name {move(name_arg)},
         value {move(value_arg)}
     {}
 
-    void Set_expr::accept(const deferred_ptr<const Expr>& owner_this, Expr_visitor& visitor) const {
-        visitor.visit(static_pointer_cast<const Set_expr>(owner_this));
+    void Set_expr::accept(Expr_visitor& visitor) const {
+        visitor.visit(this);
     }
 
     /*
@@ -176,8 +175,8 @@ namespace motts { namespace lox {
         keyword {move(keyword_arg)}
     {}
 
-    void This_expr::accept(const deferred_ptr<const Expr>& owner_this, Expr_visitor& visitor) const {
-        visitor.visit(static_pointer_cast<const This_expr>(owner_this));
+    void This_expr::accept(Expr_visitor& visitor) const {
+        visitor.visit(this);
     }
 
     /*
@@ -189,8 +188,8 @@ namespace motts { namespace lox {
         method {move(method_arg)}
     {}
 
-    void Super_expr::accept(const deferred_ptr<const Expr>& owner_this, Expr_visitor& visitor) const {
-        visitor.visit(static_pointer_cast<const Super_expr>(owner_this));
+    void Super_expr::accept(Expr_visitor& visitor) const {
+        visitor.visit(this);
     }
 
     /*
@@ -200,14 +199,14 @@ namespace motts { namespace lox {
     Function_expr::Function_expr(
         optional<Token>&& name_arg,
         vector<Token>&& parameters_arg,
-        vector<deferred_ptr<const Stmt>>&& body_arg
+        vector<const Stmt*>&& body_arg
     ) :
         name {std::move(name_arg)},
         parameters {move(parameters_arg)},
         body {move(body_arg)}
     {}
 
-    void Function_expr::accept(const deferred_ptr<const Expr>& owner_this, Expr_visitor& visitor) const {
-        visitor.visit(static_pointer_cast<const Function_expr>(owner_this));
+    void Function_expr::accept(Expr_visitor& visitor) const {
+        visitor.visit(this);
     }
 }}
@@ -1,137 +1,192 @@
 #pragma once
 
+#include <array>
+#include <cstdint>
 #include <vector>
 
 #include <boost/optional.hpp>
 
+#include "class_fwd.hpp"
 #include "expression.hpp"
+#include "function_fwd.hpp"
 #include "literal.hpp"
 #include "statement.hpp"
 #include "token.hpp"
 
 namespace motts { namespace lox {
+    // Calls and function declarations can have at most this many arguments and parameters, which lets the interpreter
+    // gather a call's arguments into a fixed-size buffer rather than a heap-allocated one
+    constexpr int max_arity {8};
+
     struct Binary_expr : Expr {
-        gcpp::deferred_ptr<const Expr> left;
+        const Expr* left;
         Token op;
-        gcpp::deferred_ptr<const Expr> right;
+        const Expr* right;
 
-        explicit Binary_expr(gcpp::deferred_ptr<const Expr>&& left, Token&& op, gcpp::deferred_ptr<const Expr>&& right);
-        void accept(const gcpp::deferred_ptr<const Expr>& owner_this, Expr_visitor&) const override;
+        explicit Binary_expr(const Expr* left, Token&& op, const Expr* right);
+        void accept(Expr_visitor&) const override;
     };
 
     struct Grouping_expr : Expr {
-        gcpp::deferred_ptr<const Expr> expr;
+        const Expr* expr;
 
-        explicit Grouping_expr(gcpp::deferred_ptr<const Expr>&& expr);
-        void accept(const gcpp::deferred_ptr<const Expr>& owner_this, Expr_visitor&) const override;
+        explicit Grouping_expr(const Expr* expr);
+        void accept(Expr_visitor&) const override;
     };
 
     struct Literal_expr : Expr {
         Literal value;
 
         explicit Literal_expr(Literal&& value);
-        void accept(const gcpp::deferred_ptr<const Expr>& owner_this, Expr_visitor&) const override;
+        void accept(Expr_visitor&) const override;
     };
 
     struct Unary_expr : Expr {
         Token op;
-        gcpp::deferred_ptr<const Expr> right;
+        const Expr* right;
+
+        explicit Unary_expr(Token&& op, const Expr* right);
+        void accept(Expr_visitor&) const override;
+    };
 
-        explicit Unary_expr(Token&& op, gcpp::deferred_ptr<const Expr>&& right);
-        void accept(const gcpp::deferred_ptr<const Expr>& owner_this, Expr_visitor&) const override;
+    // Filled in by the resolver. The tree is otherwise immutable once parsed, so these are mutable, and the resolver
+    // writes them through a pointer to const. A variable the resolver didn't find in any local scope keeps a depth of
+    // -1 and is looked up as a global.
+    struct Resolved_local {
+        int depth {-1};
+        int slot {};
+    };
+
+    // Filled in by the interpreter as it runs. Remembers what a property access found on the last few shapes it saw, so
+    // that seeing one of those shapes again skips the lookup by name. Shapes are matched by id rather than by address,
+    // because a shape's memory can be reused after its class is collected.
+    struct Property_cache {
+        struct Entry {
+            std::uint64_t shape_id;
+
+            // Index into the instance's fields, or -1 if the property is a method
+            int offset;
+
+            // Gets only. The method, if offset is -1. It belongs to the class, which outlives every instance with the
+            // shape.
+            Function* method;
+
+            // Sets only. The shape to move the instance to if setting adds the field, or null if the field exists.
+            Shape* next_shape;
+        };
+
+        // One entry is the common case. Past this many, entries are overwritten in turn.
+        static constexpr int max_entries {4};
+
+        std::array<Entry, max_entries> entries;
+        int size {};
+        int next_overwritten {};
     };
 
     struct Var_expr : Expr {
         Token name;
+        mutable Resolved_local local;
 
         explicit Var_expr(Token&& name);
-        void accept(const gcpp::deferred_ptr<const Expr>& owner_this, Expr_visitor&) const override;
-        gcpp::deferred_ptr<const Expr> make_assignment_expression(
-            gcpp::deferred_ptr<const Expr>&& lhs_expr,
-            gcpp::deferred_ptr<const Expr>&& rhs_expr,
-            gcpp::deferred_heap&,
+        void accept(Expr_visitor&) const override;
+        const Expr* make_assignment_expression(
+            const Expr* lhs_expr,
+            const Expr* rhs_expr,
+            Ast_arena&,
             const Runtime_error& throwable_if_not_lvalue
         ) const override;
     };
 
     struct Assign_expr : Expr {
         Token name;
-        gcpp::deferred_ptr<const Expr> value;
+        const Expr* value;
+        mutable Resolved_local local;
 
-        explicit Assign_expr(Token&& name, gcpp::deferred_ptr<const Expr>&& value);
-        void accept(const gcpp::deferred_ptr<const Expr>& owner_this, Expr_visitor&) const override;
+        explicit Assign_expr(Token&& name, const Expr* value);
+        void accept(Expr_visitor&) const override;
     };
 
     struct Logical_expr : Expr {
-        gcpp::deferred_ptr<const Expr> left;
+        const Expr* left;
         Token op;
-        gcpp::deferred_ptr<const Expr> right;
+        const Expr* right;
 
-        explicit Logical_expr(gcpp::deferred_ptr<const Expr>&& left, Token&& op, gcpp::deferred_ptr<const Expr>&& right);
-        void accept(const gcpp::deferred_ptr<const Expr>& owner_this, Expr_visitor&) const override;
+        explicit Logical_expr(const Expr* left, Token&& op, const Expr* right);
+        void accept(Expr_visitor&) const override;
     };
 
+    struct Get_expr;
+
     struct Call_expr : Expr {
-        gcpp::deferred_ptr<const Expr> callee;
+        const Expr* callee;
         Token closing_paren;
-        std::vector<gcpp::deferred_ptr<const Expr>> arguments;
+        std::vector<const Expr*> arguments;
+
+        // The callee again if it's a property access, as in `object.method()`, so the interpreter can call a method
+        // without binding it first. Otherwise null.
+        const Get_expr* method_callee;
 
         explicit Call_expr(
-            gcpp::deferred_ptr<const Expr>&& callee,
+            const Expr* callee,
             Token&& closing_paren,
-            std::vector<gcpp::deferred_ptr<const Expr>>&& arguments
+            std::vector<const Expr*>&& arguments,
+            const Get_expr* method_callee
         );
-        void accept(const gcpp::deferred_ptr<const Expr>& owner_this, Expr_visitor&) const override;
+        void accept(Expr_visitor&) const override;
     };
 
     struct Get_expr : Expr {
-        gcpp::deferred_ptr<const Expr> object;
+        const Expr* object;
         Token name;
-
-        explicit Get_expr(gcpp::deferred_ptr<const Expr>&& object, Token&& name);
-        void accept(const gcpp::deferred_ptr<const Expr>& owner_this, Expr_visitor&) const override;
-        gcpp::deferred_ptr<const Expr> make_assignment_expression(
-            gcpp::deferred_ptr<const Expr>&& lhs_expr,
-            gcpp::deferred_ptr<const Expr>&& rhs_expr,
-            gcpp::deferred_heap&,
+        mutable Property_cache cache;
+
+        explicit Get_expr(const Expr* object, Token&& name);
+        void accept(Expr_visitor&) const override;
+        const Expr* make_assignment_expression(
+            const Expr* lhs_expr,
+            const Expr* rhs_expr,
+            Ast_arena&,
             const Runtime_error& throwable_if_not_lvalue
         ) const override;
     };
 
     struct Set_expr : Expr {
-        gcpp::deferred_ptr<const Expr> object;
+        const Expr* object;
         Token name;
-        gcpp::deferred_ptr<const Expr> value;
+        const Expr* value;
+        mutable Property_cache cache;
 
-        explicit Set_expr(gcpp::deferred_ptr<const Expr>&& object, Token&& name, gcpp::deferred_ptr<const Expr>&& value);
-        void accept(const gcpp::deferred_ptr<const Expr>& owner_this, Expr_visitor&) const override;
+        explicit Set_expr(const Expr* object, Token&& name, const Expr* value);
+        void accept(Expr_visitor&) const override;
     };
 
     struct This_expr : Expr {
         Token keyword;
+        mutable Resolved_local local;
 
         explicit This_expr(Token&& keyword);
-        void accept(const gcpp::deferred_ptr<const Expr>& owner_this, Expr_visitor&) const override;
+        void accept(Expr_visitor&) const override;
     };
 
     struct Super_expr : Expr {
         Token keyword;
         Token method;
+        mutable Resolved_local local;
 
         explicit Super_expr(Token&& keyword, Token&& method);
-        void accept(const gcpp::deferred_ptr<const Expr>& owner_this, Expr_visitor&) const override;
+        void accept(Expr_visitor&) const override;
     };
 
     struct Function_expr : Expr {
         boost::optional<Token> name;
         std::vector<Token> parameters;
-        std::vector<gcpp::deferred_ptr<const Stmt>> body;
+        std::vector<const Stmt*> body;
 
         explicit Function_expr(
             boost::optional<Token>&& name,
             std::vector<Token>&& parameters,
-            std::vector<gcpp::deferred_ptr<const Stmt>>&& body
+            std::vector<const Stmt*>&& body
         );
-        void accept(const gcpp::deferred_ptr<const Expr>& owner_this, Expr_visitor&) const override;
+        void accept(Expr_visitor&) const override;
     };
 }}
@@ -4,35 +4,51 @@
 
 using std::move;
 using std::string;
-using std::vector;
 
 using deferred_heap_t = gcpp::deferred_heap;
 using gcpp::deferred_ptr;
 using gsl::finally;
 using gsl::narrow;
+using gsl::span;
 
 namespace motts { namespace lox {
     Function::Function(
         deferred_heap_t& deferred_heap,
         Interpreter& interpreter,
-        const deferred_ptr<const Function_expr>& declaration,
+        const Function_expr* declaration,
         const deferred_ptr<Environment>& enclosed,
-        bool is_initializer
+        Function_kind kind
     ) :
         deferred_heap_ {deferred_heap},
         interpreter_ {interpreter},
         declaration_ {declaration},
         enclosed_ {enclosed},
-        is_initializer_ {is_initializer}
+        kind_ {kind}
     {}
 
-    Literal Function::call(const deferred_ptr<Callable>& owner_this, const vector<Literal>& arguments) {
-        auto environment = deferred_heap_.make<Environment>(enclosed_);
-        if (declaration_->name) {
-            environment->find_own_or_make(declaration_->name->lexeme) = Literal{owner_this};
+    Literal Function::call(const deferred_ptr<Callable>& owner_this, span<const Literal> arguments) {
+        // Slots in the same order the resolver numbered them: a named function can refer to itself, and a method to
+        // `this`, then the parameters. Sized up front for all of them, so defining them never reallocates.
+        auto environment = deferred_heap_.make<Environment>(enclosed_, arguments.size() + 1);
+        if (kind_ != Function_kind::function) {
+            environment->define(Literal{this_});
+        } else if (declaration_->name) {
+            environment->define(Literal{owner_this});
         }
-        for (auto param_iter = declaration_->parameters.cbegin(); param_iter != declaration_->parameters.cend(); ++param_iter) {
-            environment->find_own_or_make(param_iter->lexeme) = arguments.at(param_iter - declaration_->parameters.cbegin());
+
+        return run(environment, arguments);
+    }
+
+    Literal Function::call_method(const deferred_ptr<Instance>& instance, span<const Literal> arguments) {
+        auto environment = deferred_heap_.make<Environment>(enclosed_, arguments.size() + 1);
+        environment->define(Literal{instance});
+
+        return run(environment, arguments);
+    }
+
+    Literal Function::run(const deferred_ptr<Environment>& environment, span<const Literal> arguments) {
+        for (const auto& argument : arguments) {
+            environment->define(argument);
         }
 
         interpreter_.execute_block(declaration_->body, environment);
@@ -42,8 +58,9 @@ namespace motts { namespace lox {
             return move(interpreter_).result();
         }
 
-        if (is_initializer_) {
-            return enclosed_->find_in_chain("this")->second;
+        if (kind_ == Function_kind::initializer) {
+            // `this` is the first slot
+            return environment->get_at(0, 0);
         }
 
         return Literal{};
@@ -58,8 +75,8 @@ namespace motts { namespace lox {
     }
 
     deferred_ptr<Function> Function::bind(const deferred_ptr<Instance>& instance) const {
-        auto this_environment = deferred_heap_.make<Environment>(enclosed_);
-        this_environment->find_own_or_make("this") = Literal{instance};
-        return deferred_heap_.make<Function>(deferred_heap_, interpreter_, declaration_, this_environment, is_initializer_);
+        auto bound = deferred_heap_.make<Function>(deferred_heap_, interpreter_, declaration_, enclosed_, kind_);
+        bound->this_ = instance;
+        return bound;
     }
 }}
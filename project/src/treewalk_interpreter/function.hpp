@@ -6,25 +6,36 @@
 #include "statement_impls.hpp"
 
 namespace motts { namespace lox {
+    enum class Function_kind { function, method, initializer };
+
     class Function : public Callable {
         public:
             explicit Function(
                 gcpp::deferred_heap&,
                 Interpreter&,
-                const gcpp::deferred_ptr<const Function_expr>& declaration,
+                const Function_expr* declaration,
                 const gcpp::deferred_ptr<Environment>& enclosed,
-                bool is_initializer = false
+                Function_kind = Function_kind::function
             );
-            Literal call(const gcpp::deferred_ptr<Callable>& owner_this, const std::vector<Literal>& arguments) override;
+            Literal call(const gcpp::deferred_ptr<Callable>& owner_this, gsl::span<const Literal> arguments) override;
             int arity() const override;
             std::string to_string() const override;
             gcpp::deferred_ptr<Function> bind(const gcpp::deferred_ptr<Instance>&) const;
 
+            // Calls a method with `this` bound to the instance, without first making a bound copy of the method
+            Literal call_method(const gcpp::deferred_ptr<Instance>&, gsl::span<const Literal> arguments);
+
         private:
             gcpp::deferred_heap& deferred_heap_;
             Interpreter& interpreter_;
-            gcpp::deferred_ptr<const Function_expr> declaration_;
+            const Function_expr* declaration_;
             gcpp::deferred_ptr<Environment> enclosed_;
-            bool is_initializer_;
+            Function_kind kind_;
+
+            // Set only on methods returned by bind
+            gcpp::deferred_ptr<Instance> this_;
+
+            // Takes an environment whose first slot, if any, is already defined
+            Literal run(const gcpp::deferred_ptr<Environment>&, gsl::span<const Literal> arguments);
     };
 }}
@@ -1,10 +1,11 @@
 #include "interpreter.hpp"
 
 #include <cstddef>
+#include <ctime>
 
+#include <array>
 #include <chrono>
 #include <iostream>
-#include <iterator>
 #include <unordered_map>
 
 #include <boost/variant.hpp>
@@ -13,17 +14,19 @@
 #include "class.hpp"
 #include "function.hpp"
 
-using std::back_inserter;
+using std::array;
+using std::cerr;
+using std::chrono::duration;
 using std::chrono::duration_cast;
-using std::chrono::seconds;
-using std::chrono::system_clock;
-using std::cout;
+using std::chrono::nanoseconds;
+using std::chrono::steady_clock;
+using std::clock;
 using std::move;
 using std::nullptr_t;
+using std::ostream;
 using std::pair;
 using std::string;
 using std::to_string;
-using std::transform;
 using std::unordered_map;
 using std::vector;
 
@@ -34,6 +37,7 @@ using deferred_heap_t = gcpp::deferred_heap;
 using gcpp::deferred_ptr;
 using gsl::finally;
 using gsl::narrow;
+using gsl::span;
 
 // Allow the internal linkage section to access names
 using namespace motts::lox;
@@ -44,7 +48,7 @@ namespace {
     A helper function so that...
 
         Visitor visitor;
-        expr->accept(expr, visitor);
+        expr->accept(visitor);
         visitor.result()
 
     ...can instead be written as...
@@ -53,7 +57,7 @@ namespace {
     */
     template<typename Visitor, typename Operand>
         auto apply_visitor(Visitor& visitor, const Operand& operand) {
-            operand->accept(operand, visitor);
+            operand->accept(visitor);
             return std::move(visitor).result();
         }
 
@@ -129,41 +133,103 @@ namespace {
             }
     };
 
-    class Break {};
-    class Continue {};
-}
+    class Native_callable : public Callable {
+        public:
+            explicit Native_callable(const string& name, Native_fn fn, int arity) :
+                name_ {name},
+                fn_ {move(fn)},
+                arity_ {arity}
+            {}
 
-// Exported (external linkage)
-namespace motts { namespace lox {
-    Interpreter::Interpreter(deferred_heap_t& deferred_heap) :
-        deferred_heap_ {deferred_heap}
-    {
-        struct Clock_callable : Callable {
-            Literal call(const deferred_ptr<Callable>& /*owner_this*/, const vector<Literal>& /*arguments*/) override {
-                return Literal{narrow<double>(duration_cast<seconds>(system_clock::now().time_since_epoch()).count())};
+            Literal call(const deferred_ptr<Callable>& /*owner_this*/, span<const Literal> arguments) override {
+                return fn_(arguments);
             }
 
             int arity() const override {
-                return 0;
+                return arity_;
             }
 
             string to_string() const override {
-                return "<fn clock>";
+                return "<fn " + name_ + ">";
             }
-        };
 
-        globals_->find_own_or_make("clock") = Literal{deferred_heap_.make<Clock_callable>()};
+        private:
+            string name_;
+            Native_fn fn_;
+            int arity_;
+    };
+
+    // Script-visible timers. clock is fractional seconds and nanoTime is whole nanoseconds, both from a monotonic
+    // clock so a script can time itself. cpuTime is the processor time the process has used, in seconds.
+    double clock_native() {
+        return duration<double>{steady_clock::now().time_since_epoch()}.count();
     }
 
-    void Interpreter::visit(const deferred_ptr<const Literal_expr>& expr) {
+    double nano_time_native() {
+        return static_cast<double>(duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count());
+    }
+
+    double cpu_time_native() {
+        return static_cast<double>(clock()) / CLOCKS_PER_SEC;
+    }
+
+    const Property_cache::Entry& add_cache_entry(Property_cache& cache, const Property_cache::Entry& entry) {
+        if (cache.size != Property_cache::max_entries) {
+            return cache.entries[cache.size++] = entry;
+        }
+
+        auto& overwritten = cache.entries[cache.next_overwritten];
+        cache.next_overwritten = (cache.next_overwritten + 1) % Property_cache::max_entries;
+
+        return overwritten = entry;
+    }
+}
+
+// Exported (external linkage)
+namespace motts { namespace lox {
+    Interpreter::Interpreter(deferred_heap_t& deferred_heap, ostream& out) :
+        deferred_heap_ {deferred_heap},
+        out_ {out}
+    {
+        define_native("clock", clock_native);
+        define_native("nanoTime", nano_time_native);
+        define_native("cpuTime", cpu_time_native);
+    }
+
+    Interpreter::~Interpreter() {
+        #ifdef MOTTS_LOX_INLINE_CACHE_STATS
+            cerr <<
+                "Property cache hits: " << cache_stats_.first_entry_hits + cache_stats_.other_entry_hits <<
+                " (" << cache_stats_.other_entry_hits << " past the first entry), misses: " << cache_stats_.misses <<
+                "\n";
+        #endif
+    }
+
+    void Interpreter::define_native(const string& name, Native_fn fn, int arity) {
+        const Literal native {deferred_heap_.make<Native_callable>(name, move(fn), arity)};
+        natives_.push_back({name, native});
+        globals_->find_own_or_make(name) = native;
+    }
+
+    void Interpreter::reset_globals() {
+        globals_ = deferred_heap_.make<Environment>();
+        environment_ = globals_;
+        completion_ = Completion::normal;
+
+        for (const auto& native : natives_) {
+            globals_->find_own_or_make(native.first) = native.second;
+        }
+    }
+
+    void Interpreter::visit(const Literal_expr* expr) {
         result_ = expr->value;
     }
 
-    void Interpreter::visit(const deferred_ptr<const Grouping_expr>& expr) {
-        expr->expr->accept(expr->expr, *this);
+    void Interpreter::visit(const Grouping_expr* expr) {
+        expr->expr->accept(*this);
     }
 
-    void Interpreter::visit(const deferred_ptr<const Unary_expr>& expr) {
+    void Interpreter::visit(const Unary_expr* expr) {
         const auto unary_result = ::apply_visitor(*this, expr->right);
 
         result_ = ([&] () {
@@ -185,7 +251,7 @@ namespace motts { namespace lox {
         })();
     }
 
-    void Interpreter::visit(const deferred_ptr<const Binary_expr>& expr) {
+    void Interpreter::visit(const Binary_expr* expr) {
         const auto left_result = ::apply_visitor(*this, expr->left);
         const auto right_result = ::apply_visitor(*this, expr->right);
 
@@ -232,15 +298,15 @@ namespace motts { namespace lox {
         })();
     }
 
-    void Interpreter::visit(const deferred_ptr<const Var_expr>& expr) {
-        result_ = lookup_variable(expr->name.lexeme, *expr)->second;
+    void Interpreter::visit(const Var_expr* expr) {
+        result_ = lookup_variable(expr->name.lexeme, expr->local);
     }
 
-    void Interpreter::visit(const deferred_ptr<const Assign_expr>& expr) {
-        result_ = lookup_variable(expr->name.lexeme, *expr)->second = ::apply_visitor(*this, expr->value);
+    void Interpreter::visit(const Assign_expr* expr) {
+        result_ = lookup_variable(expr->name.lexeme, expr->local) = ::apply_visitor(*this, expr->value);
     }
 
-    void Interpreter::visit(const deferred_ptr<const Logical_expr>& expr) {
+    void Interpreter::visit(const Logical_expr* expr) {
         auto left_result = ::apply_visitor(*this, expr->left);
 
         // Short circuit if possible
@@ -258,87 +324,140 @@ namespace motts { namespace lox {
             throw Interpreter_error{"Unreachable.", expr->op};
         }
 
-        expr->right->accept(expr->right, *this);
-    }
+        expr->right->accept(*this);
+    }
+
+    void Interpreter::visit(const Call_expr* expr) {
+        // The parser caps the argument count, so the arguments fit in a buffer on the C++ stack and a call allocates
+        // nothing for them
+        array<Literal, max_arity> arguments;
+        const auto argument_count = narrow<int>(expr->arguments.size());
+        const auto evaluate_arguments = [&] (const Callable& callable) {
+            if (argument_count != callable.arity()) {
+                throw Interpreter_error{
+                    "Expected " + to_string(callable.arity()) +
+                    " arguments but got " + to_string(argument_count) + ".",
+                    expr->closing_paren
+                };
+            }
 
-    void Interpreter::visit(const deferred_ptr<const Call_expr>& expr) {
-        auto callee_result = ::apply_visitor(*this, expr->callee);
-        const auto callable = boost::apply_visitor(Get_callable_visitor{}, callee_result.value);
+            for (auto i = 0; i != argument_count; ++i) {
+                arguments[i] = ::apply_visitor(*this, expr->arguments[i]);
+            }
 
-        if (narrow<int>(expr->arguments.size()) != callable->arity()) {
-            throw Interpreter_error{
-                "Expected " + to_string(callable->arity()) +
-                " arguments but got " + to_string(expr->arguments.size()) + ".",
-                expr->closing_paren
-            };
-        }
+            return span<const Literal>{arguments.data(), argument_count};
+        };
+
+        Literal callee_result;
+        if (expr->method_callee) {
+            // Calling a method right where it's looked up, as in `object.method()`, skips making the bound method
+            // object that `object.method` on its own would produce
+            const auto get_expr = expr->method_callee;
+            const auto object_result = ::apply_visitor(*this, get_expr->object);
+            deferred_ptr<Instance> instance;
+            try {
+                instance = get<deferred_ptr<Instance>>(object_result.value);
+            } catch (const bad_get&) {
+                // Convert a boost variant error into a Lox error
+                throw Interpreter_error{"Only instances have properties.", get_expr->name};
+            }
 
-        vector<Literal> arguments;
-        transform(
-            expr->arguments.cbegin(), expr->arguments.cend(), back_inserter(arguments),
-            [&] (const auto& argument_expr) {
-                return ::apply_visitor(*this, argument_expr);
+            const auto entry = find_get_entry(get_expr->cache, *instance, get_expr->name.lexeme);
+            if (!entry) {
+                throw Runtime_error{"Undefined property '" + get_expr->name.lexeme + "'."};
             }
-        );
 
-        result_ = callable->call(callable, arguments);
+            // The arguments can run this same call again on other shapes and overwrite the cache entry, so read out
+            // what we need from it before evaluating them
+            const auto method = entry->method;
+            if (method) {
+                const auto arguments = evaluate_arguments(*method);
+                result_ = method->call_method(instance, arguments);
+                return;
+            }
+
+            const auto offset = entry->offset;
+            callee_result = instance->field(offset);
+        } else {
+            callee_result = ::apply_visitor(*this, expr->callee);
+        }
+
+        const auto callable = boost::apply_visitor(Get_callable_visitor{}, callee_result.value);
+        result_ = callable->call(callable, evaluate_arguments(*callable));
     }
 
-    void Interpreter::visit(const deferred_ptr<const Get_expr>& expr) {
+    void Interpreter::visit(const Get_expr* expr) {
         const auto object_result = ::apply_visitor(*this, expr->object);
+        deferred_ptr<Instance> instance;
         try {
-            const auto instance = get<deferred_ptr<Instance>>(object_result.value);
-            result_ = instance->get(instance, expr->name.lexeme);
+            instance = get<deferred_ptr<Instance>>(object_result.value);
         } catch (const bad_get&) {
             // Convert a boost variant error into a Lox error
             throw Interpreter_error{"Only instances have properties.", expr->name};
         }
+
+        const auto entry = find_get_entry(expr->cache, *instance, expr->name.lexeme);
+        if (!entry) {
+            throw Runtime_error{"Undefined property '" + expr->name.lexeme + "'."};
+        }
+
+        result_ = entry->method ? Literal{entry->method->bind(instance)} : instance->field(entry->offset);
     }
 
-    void Interpreter::visit(const deferred_ptr<const Set_expr>& expr) {
+    void Interpreter::visit(const Set_expr* expr) {
         auto object_result = ::apply_visitor(*this, expr->object);
         auto value_result = ::apply_visitor(*this, expr->value);
 
+        deferred_ptr<Instance> instance;
         try {
-            get<deferred_ptr<Instance>>(object_result.value)->set(expr->name.lexeme, Literal{value_result});
+            instance = get<deferred_ptr<Instance>>(object_result.value);
         } catch (const bad_get&) {
             // Convert a boost variant error into a Lox error
             throw Interpreter_error{"Only instances have fields.", expr->name};
         }
 
+        const auto& entry = find_set_entry(expr->cache, *instance, expr->name.lexeme);
+        if (entry.next_shape) {
+            instance->add_field(entry.next_shape, value_result);
+        } else {
+            instance->field(entry.offset) = value_result;
+        }
+
         result_ = move(value_result);
     }
 
-    void Interpreter::visit(const deferred_ptr<const Super_expr>& expr) {
-        const auto found_depth = scope_depths_.find(expr.get());
-        auto superclass = get<deferred_ptr<Class>>(environment_->find_in_chain("super", found_depth->second)->second.value);
-        auto instance = get<deferred_ptr<Instance>>(environment_->find_in_chain("this", found_depth->second - 1)->second.value);
+    void Interpreter::visit(const Super_expr* expr) {
+        // `super` is the only slot of its environment, and `this` the first slot of the method's environment just inside
+        // it
+        const auto depth = expr->local.depth;
+        auto superclass = get<deferred_ptr<Class>>(environment_->get_at(depth, 0).value);
+        auto instance = get<deferred_ptr<Instance>>(environment_->get_at(depth - 1, 0).value);
 
         result_ = superclass->get(instance, expr->method.lexeme);
     }
 
-    void Interpreter::visit(const deferred_ptr<const This_expr>& expr) {
-        result_ = lookup_variable("this", *expr)->second;
+    void Interpreter::visit(const This_expr* expr) {
+        result_ = lookup_variable("this", expr->local);
     }
 
-    void Interpreter::visit(const deferred_ptr<const Function_expr>& expr) {
+    void Interpreter::visit(const Function_expr* expr) {
         result_ = Literal{deferred_heap_.make<Function>(deferred_heap_, *this, expr, environment_)};
     }
 
-    void Interpreter::visit(const deferred_ptr<const Expr_stmt>& stmt) {
-        stmt->expr->accept(stmt->expr, *this);
+    void Interpreter::visit(const Expr_stmt* stmt) {
+        stmt->expr->accept(*this);
     }
 
-    void Interpreter::visit(const deferred_ptr<const If_stmt>& stmt) {
+    void Interpreter::visit(const If_stmt* stmt) {
         const auto condition_result = ::apply_visitor(*this, stmt->condition);
         if (boost::apply_visitor(Is_truthy_visitor{}, condition_result.value)) {
-            stmt->then_branch->accept(stmt->then_branch, *this);
+            stmt->then_branch->accept(*this);
         } else if (stmt->else_branch) {
-            stmt->else_branch->accept(stmt->else_branch, *this);
+            stmt->else_branch->accept(*this);
         }
     }
 
-    void Interpreter::visit(const deferred_ptr<const While_stmt>& stmt) {
+    void Interpreter::visit(const While_stmt* stmt) {
         while (
             // IIFE so I can execute multiple statements inside while condition
             ([&] () {
@@ -346,21 +465,14 @@ namespace motts { namespace lox {
                 return boost::apply_visitor(Is_truthy_visitor{}, condition_result.value);
             })()
         ) {
-            try {
-                stmt->body->accept(stmt->body, *this);
-            } catch (const Break&) {
+            stmt->body->accept(*this);
+            if (loop_should_exit()) {
                 break;
-            } catch (const Continue&) {
-                continue;
-            }
-
-            if (returning_) {
-                return;
             }
         }
     }
 
-    void Interpreter::visit(const deferred_ptr<const For_stmt>& stmt) {
+    void Interpreter::visit(const For_stmt* stmt) {
         for (
             ;
 
@@ -372,51 +484,40 @@ namespace motts { namespace lox {
 
             ::apply_visitor(*this, stmt->increment)
         ) {
-            try {
-                stmt->body->accept(stmt->body, *this);
-            } catch (const Break&) {
+            // A continue still runs the increment
+            stmt->body->accept(*this);
+            if (loop_should_exit()) {
                 break;
-            } catch (const Continue&) {
-                continue;
-            }
-
-            if (returning_) {
-                return;
             }
         }
     }
 
-    void Interpreter::visit(const deferred_ptr<const Break_stmt>&) {
-        // Yes, this is using exceptions for control flow. Yes, that's usually a bad thing. In this case, exceptions
-        // happen to offer exactly the behavior we need. We need to traverse an unknown call stack depth to get back to
-        // the nearest loop statement.
-        throw Break{};
+    void Interpreter::visit(const Break_stmt*) {
+        completion_ = Completion::break_;
     }
 
-    void Interpreter::visit(const deferred_ptr<const Continue_stmt>&) {
-        // Yes, this is using exceptions for control flow. Yes, that's usually a bad thing. In this case, exceptions
-        // happen to offer exactly the behavior we need. We need to traverse an unknown call stack depth to get back to
-        // the nearest loop statement.
-        throw Continue{};
+    void Interpreter::visit(const Continue_stmt*) {
+        completion_ = Completion::continue_;
     }
 
-    void Interpreter::visit(const deferred_ptr<const Print_stmt>& stmt) {
-        cout << ::apply_visitor(*this, stmt->expr) << "\n";
+    void Interpreter::visit(const Print_stmt* stmt) {
+        out_ << ::apply_visitor(*this, stmt->expr) << "\n";
     }
 
-    void Interpreter::visit(const deferred_ptr<const Var_stmt>& stmt) {
-        environment_->find_own_or_make(stmt->name.lexeme) = (
+    void Interpreter::visit(const Var_stmt* stmt) {
+        define_variable(
+            stmt->name.lexeme,
             stmt->initializer ?
                 ::apply_visitor(*this, stmt->initializer) :
                 Literal{}
         );
     }
 
-    void Interpreter::visit(const deferred_ptr<const Block_stmt>& stmt) {
+    void Interpreter::visit(const Block_stmt* stmt) {
         execute_block(stmt->statements, deferred_heap_.make<Environment>(environment_));
     }
 
-    void Interpreter::visit(const deferred_ptr<const Class_stmt>& stmt) {
+    void Interpreter::visit(const Class_stmt* stmt) {
         deferred_ptr<Class> superclass;
         deferred_ptr<Environment> method_environment {environment_};
         unordered_map<string, deferred_ptr<Function>> methods;
@@ -430,23 +531,88 @@ namespace motts { namespace lox {
             }
 
             method_environment = deferred_heap_.make<Environment>(environment_);
-            method_environment->find_own_or_make("super") = Literal{superclass};
+            method_environment->define(Literal{superclass});
         }
 
         for (const auto& method : stmt->methods) {
-            methods[method->expr->name->lexeme] = deferred_heap_.make<Function>(deferred_heap_, *this, method->expr, method_environment, method->expr->name->lexeme == "init");
+            methods[method->expr->name->lexeme] = deferred_heap_.make<Function>(
+                deferred_heap_, *this, method->expr, method_environment,
+                method->expr->name->lexeme == "init" ? Function_kind::initializer : Function_kind::method
+            );
         }
 
-        environment_->find_own_or_make(stmt->name.lexeme) = Literal{deferred_heap_.make<Class>(deferred_heap_, stmt->name.lexeme, move(superclass), move(methods))};
+        define_variable(stmt->name.lexeme, Literal{deferred_heap_.make<Class>(deferred_heap_, next_shape_id_, stmt->name.lexeme, move(superclass), move(methods))});
     }
 
-    void Interpreter::visit(const deferred_ptr<const Function_stmt>& stmt) {
-        environment_->find_own_or_make(stmt->expr->name->lexeme) = Literal{deferred_heap_.make<Function>(deferred_heap_, *this, stmt->expr, environment_)};
+    void Interpreter::visit(const Function_stmt* stmt) {
+        define_variable(stmt->expr->name->lexeme, Literal{deferred_heap_.make<Function>(deferred_heap_, *this, stmt->expr, environment_)});
     }
 
-    void Interpreter::visit(const deferred_ptr<const Return_stmt>& stmt) {
+    void Interpreter::visit(const Return_stmt* stmt) {
         result_ = stmt->value ? ::apply_visitor(*this, stmt->value) : Literal{};
-        returning_ = true;
+        completion_ = Completion::return_;
+    }
+
+    const Property_cache::Entry* Interpreter::find_get_entry(
+        Property_cache& cache,
+        const Instance& instance,
+        const string& name
+    ) {
+        const auto cached = find_cache_entry(cache, instance);
+        if (cached) {
+            return cached;
+        }
+
+        const auto shape = instance.shape();
+        const auto offset = shape->find(name);
+        if (offset != -1) {
+            return &add_cache_entry(cache, {shape->id(), offset, nullptr, nullptr});
+        }
+
+        const auto method = instance.find_method(name);
+        if (method) {
+            return &add_cache_entry(cache, {shape->id(), -1, method.get(), nullptr});
+        }
+
+        return nullptr;
+    }
+
+    const Property_cache::Entry& Interpreter::find_set_entry(
+        Property_cache& cache,
+        const Instance& instance,
+        const string& name
+    ) {
+        const auto cached = find_cache_entry(cache, instance);
+        if (cached) {
+            return *cached;
+        }
+
+        const auto shape = instance.shape();
+        const auto offset = shape->find(name);
+        if (offset != -1) {
+            return add_cache_entry(cache, {shape->id(), offset, nullptr, nullptr});
+        }
+
+        return add_cache_entry(cache, {shape->id(), -1, nullptr, shape->with(name)});
+    }
+
+    const Property_cache::Entry* Interpreter::find_cache_entry(Property_cache& cache, const Instance& instance) {
+        const auto shape_id = instance.shape()->id();
+        for (auto i = 0; i != cache.size; ++i) {
+            if (cache.entries[i].shape_id == shape_id) {
+                #ifdef MOTTS_LOX_INLINE_CACHE_STATS
+                    ++(i == 0 ? cache_stats_.first_entry_hits : cache_stats_.other_entry_hits);
+                #endif
+
+                return &cache.entries[i];
+            }
+        }
+
+        #ifdef MOTTS_LOX_INLINE_CACHE_STATS
+            ++cache_stats_.misses;
+        #endif
+
+        return nullptr;
     }
 
     const Literal& Interpreter::result() const & {
@@ -457,25 +623,28 @@ namespace motts { namespace lox {
         return move(result_);
     }
 
-    Environment::iterator Interpreter::lookup_variable(const string& name, const Expr& expr) {
-        const auto found_depth = scope_depths_.find(&expr);
-        if (found_depth != scope_depths_.cend()) {
-            return environment_->find_in_chain(name, found_depth->second);
+    Literal& Interpreter::lookup_variable(const string& name, const Resolved_local& local) {
+        if (local.depth != -1) {
+            return environment_->get_at(local.depth, local.slot);
         }
 
-        const auto found_global = globals_->find_in_chain(name);
+        const auto found_global = globals_->find(name);
         if (found_global != globals_->end()) {
-            return found_global;
+            return found_global->second;
         }
 
         throw Interpreter_error{"Undefined variable '" + name + "'."};
     }
 
-    void Interpreter::resolve(const Expr* expr, int depth) {
-        scope_depths_[expr] = depth;
+    void Interpreter::define_variable(const string& name, const Literal& value) {
+        if (environment_->is_global()) {
+            environment_->find_own_or_make(name) = value;
+        } else {
+            environment_->define(value);
+        }
     }
 
-    void Interpreter::execute_block(const vector<deferred_ptr<const Stmt>>& statements, const deferred_ptr<Environment>& environment) {
+    void Interpreter::execute_block(const vector<const Stmt*>& statements, const deferred_ptr<Environment>& environment) {
         const auto original_environment = move(environment_);
         const auto _ = finally([&] () {
             environment_ = move(original_environment);
@@ -483,20 +652,40 @@ namespace motts { namespace lox {
         environment_ = environment;
 
         for (const auto& statement : statements) {
-            statement->accept(statement, *this);
+            statement->accept(*this);
 
-            if (returning_) {
+            if (completion_ != Completion::normal) {
                 return;
             }
         }
     }
 
+    bool Interpreter::loop_should_exit() {
+        switch (completion_) {
+            case Completion::normal:
+                return false;
+
+            case Completion::continue_:
+                completion_ = Completion::normal;
+                return false;
+
+            case Completion::break_:
+                completion_ = Completion::normal;
+                return true;
+
+            case Completion::return_:
+                return true;
+        }
+
+        throw Interpreter_error{"Unreachable."};
+    }
+
     bool Interpreter::returning() const {
-        return returning_;
+        return completion_ == Completion::return_;
     }
 
     void Interpreter::returning(bool returning) {
-        returning_ = returning;
+        completion_ = returning ? Completion::return_ : Completion::normal;
     }
 
     Interpreter_error::Interpreter_error(const string& what, const Token& token) :
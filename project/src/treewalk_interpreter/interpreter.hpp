@@ -1,7 +1,11 @@
 #pragma once
 
+#include <cstdint>
+
+#include <ostream>
 #include <string>
-#include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include <gsl/gsl_util>
 #pragma warning(push, 0)
@@ -11,66 +15,113 @@
 #include "environment.hpp"
 #include "exception.hpp"
 #include "expression.hpp"
+#include "expression_impls.hpp"
 #include "expression_visitor.hpp"
 #include "function_fwd.hpp"
 #include "literal.hpp"
-#include "resolver_fwd.hpp"
+#include "native.hpp"
 #include "statement_visitor.hpp"
 #include "token.hpp"
 
 namespace motts { namespace lox {
     class Interpreter : public Expr_visitor, public Stmt_visitor {
         public:
-            explicit Interpreter(gcpp::deferred_heap&);
-
-            void visit(const gcpp::deferred_ptr<const Binary_expr>&) override;
-            void visit(const gcpp::deferred_ptr<const Grouping_expr>&) override;
-            void visit(const gcpp::deferred_ptr<const Literal_expr>&) override;
-            void visit(const gcpp::deferred_ptr<const Unary_expr>&) override;
-            void visit(const gcpp::deferred_ptr<const Var_expr>&) override;
-            void visit(const gcpp::deferred_ptr<const Assign_expr>&) override;
-            void visit(const gcpp::deferred_ptr<const Logical_expr>&) override;
-            void visit(const gcpp::deferred_ptr<const Call_expr>&) override;
-            void visit(const gcpp::deferred_ptr<const Get_expr>&) override;
-            void visit(const gcpp::deferred_ptr<const Set_expr>&) override;
-            void visit(const gcpp::deferred_ptr<const Super_expr>&) override;
-            void visit(const gcpp::deferred_ptr<const This_expr>&) override;
-            void visit(const gcpp::deferred_ptr<const Function_expr>&) override;
-
-            void visit(const gcpp::deferred_ptr<const Expr_stmt>&) override;
-            void visit(const gcpp::deferred_ptr<const If_stmt>&) override;
-            void visit(const gcpp::deferred_ptr<const Print_stmt>&) override;
-            void visit(const gcpp::deferred_ptr<const While_stmt>&) override;
-            void visit(const gcpp::deferred_ptr<const For_stmt>&) override;
-            void visit(const gcpp::deferred_ptr<const Break_stmt>&) override;
-            void visit(const gcpp::deferred_ptr<const Continue_stmt>&) override;
-            void visit(const gcpp::deferred_ptr<const Var_stmt>&) override;
-            void visit(const gcpp::deferred_ptr<const Block_stmt>&) override;
-            void visit(const gcpp::deferred_ptr<const Class_stmt>&) override;
-            void visit(const gcpp::deferred_ptr<const Function_stmt>&) override;
-            void visit(const gcpp::deferred_ptr<const Return_stmt>&) override;
+            // Print statements write to `out`, which must outlive the interpreter
+            explicit Interpreter(gcpp::deferred_heap&, std::ostream& out);
+
+            // Prints property cache statistics if they're enabled
+            ~Interpreter();
+
+            void visit(const Binary_expr*) override;
+            void visit(const Grouping_expr*) override;
+            void visit(const Literal_expr*) override;
+            void visit(const Unary_expr*) override;
+            void visit(const Var_expr*) override;
+            void visit(const Assign_expr*) override;
+            void visit(const Logical_expr*) override;
+            void visit(const Call_expr*) override;
+            void visit(const Get_expr*) override;
+            void visit(const Set_expr*) override;
+            void visit(const Super_expr*) override;
+            void visit(const This_expr*) override;
+            void visit(const Function_expr*) override;
+
+            void visit(const Expr_stmt*) override;
+            void visit(const If_stmt*) override;
+            void visit(const Print_stmt*) override;
+            void visit(const While_stmt*) override;
+            void visit(const For_stmt*) override;
+            void visit(const Break_stmt*) override;
+            void visit(const Continue_stmt*) override;
+            void visit(const Var_stmt*) override;
+            void visit(const Block_stmt*) override;
+            void visit(const Class_stmt*) override;
+            void visit(const Function_stmt*) override;
+            void visit(const Return_stmt*) override;
 
             const Literal& result() const &;
             Literal&& result() &&;
 
+            // Makes a global function that calls back into the host. The interpreter checks the argument count before
+            // calling.
+            void define_native(const std::string& name, Native_fn, int arity);
+
+            // Like the above, but the arity and the argument and return conversions come from fn's signature. See
+            // native.hpp for the types it can take and return.
+            template<typename F>
+                void define_native(const std::string& name, F fn) {
+                    using Binding = typename Native_signature<F>::Binding;
+                    define_native(name, Binding::bind(std::move(fn)), Binding::arity);
+                }
+
+            // Starts over with a new global environment that holds only the natives
+            void reset_globals();
+
         private:
             gcpp::deferred_heap& deferred_heap_;
+            std::ostream& out_;
             gcpp::deferred_ptr<Environment> environment_ {deferred_heap_.make<Environment>()};
             gcpp::deferred_ptr<Environment> globals_ {environment_};
 
+            // Kept to define again when the globals are reset
+            std::vector<std::pair<std::string, Literal>> natives_;
+
+            // Shape ids are per interpreter, like the property caches in this interpreter's tree that hold them
+            std::uint64_t next_shape_id_ {1};
+
             Literal result_;
-            bool returning_ {false};
 
-            std::unordered_map<const Expr*, int> scope_depths_;
-            Environment::iterator lookup_variable(const std::string& name, const Expr&);
+            // How the last statement finished. Break, continue, and return set this rather than unwinding, and every
+            // enclosing block stops early until a loop or a function call consumes it.
+            enum class Completion { normal, break_, continue_, return_ };
+            Completion completion_ {Completion::normal};
+
+            // Called after each loop iteration. Consumes a break or continue, and returns whether the loop should stop.
+            bool loop_should_exit();
+
+            Literal& lookup_variable(const std::string& name, const Resolved_local&);
+
+            // Each returns the cache entry for the instance's current shape, looking the property up by name and
+            // filling in an entry on a miss. The get lookup returns null if there's no such property.
+            const Property_cache::Entry* find_get_entry(Property_cache&, const Instance&, const std::string& name);
+            const Property_cache::Entry& find_set_entry(Property_cache&, const Instance&, const std::string& name);
+            const Property_cache::Entry* find_cache_entry(Property_cache&, const Instance&);
+
+            #ifdef MOTTS_LOX_INLINE_CACHE_STATS
+                struct Cache_stats {
+                    long first_entry_hits {};
+                    long other_entry_hits {};
+                    long misses {};
+                };
+                Cache_stats cache_stats_;
+            #endif
 
-            // Even though Resolver has access to everything, it's only intended to call the functions listed here
-            friend Resolver;
-            void resolve(const Expr*, int depth);
+            // Locals go in the next slot of the current environment, in the order the resolver numbered them
+            void define_variable(const std::string& name, const Literal&);
 
             // Even though Function has access to everything, it's only intended to call the functions listed here
             friend Function;
-            void execute_block(const std::vector<gcpp::deferred_ptr<const Stmt>>& statements, const gcpp::deferred_ptr<Environment>&);
+            void execute_block(const std::vector<const Stmt*>& statements, const gcpp::deferred_ptr<Environment>&);
             bool returning() const;
             void returning(bool);
     };
@@ -0,0 +1,63 @@
+#include "lox.hpp"
+
+#include <iostream>
+#include <utility>
+
+using std::cout;
+using std::move;
+using std::ostream;
+using std::string;
+using std::vector;
+
+namespace motts { namespace lox {
+    Lox::Lox() :
+        Lox {cout}
+    {}
+
+    Lox::Lox(ostream& out) :
+        interpreter {deferred_heap, out}
+    {
+        deferred_heap.set_collect_before_expand(true);
+    }
+
+    Program::Program(vector<const Stmt*>&& statements) :
+        statements_ {move(statements)}
+    {}
+
+    Program Lox::compile(const string& source) {
+        const auto parsed_statements = parse(Token_iterator{source});
+
+        string resolver_errors;
+        for (const auto& statement : parsed_statements) {
+            try {
+                statement->accept(resolver);
+            } catch (const Resolver_error& error) {
+                resolver_errors += error.what();
+                resolver_errors += "\n";
+            }
+        }
+        if (!resolver_errors.empty()) {
+            throw Resolver_error{resolver_errors};
+        }
+
+        return Program{optimizer.optimize(parsed_statements)};
+    }
+
+    void Lox::execute(const Program& program) {
+        interpreter.reset_globals();
+        for (const auto& statement : program.statements_) {
+            statement->accept(interpreter);
+        }
+    }
+
+    void Lox::run(const string& source) {
+        const auto program = compile(source);
+        for (const auto& statement : program.statements_) {
+            statement->accept(interpreter);
+        }
+    }
+
+    void Lox::define_native(const string& name, Native_fn fn, int arity) {
+        interpreter.define_native(name, move(fn), arity);
+    }
+}}
@@ -1,27 +1,75 @@
 #pragma once
 
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
 #pragma warning(push, 0)
     #include <deferred_heap.h>
 #pragma warning(pop)
 
+#include "ast_arena.hpp"
 #include "interpreter.hpp"
+#include "optimizer.hpp"
 #include "parser.hpp"
 #include "resolver.hpp"
+#include "statement.hpp"
 
 namespace motts { namespace lox {
+    struct Lox;
+
+    // A script that's been scanned, parsed, resolved, and optimized once, to be executed any number of times. It can
+    // only be executed by the Lox that compiled it, and only while that Lox lives.
+    class Program {
+        private:
+            friend Lox;
+            explicit Program(std::vector<const Stmt*>&&);
+
+            std::vector<const Stmt*> statements_;
+    };
+
+    /*
+    Everything it takes to run Lox, and the API for a host program that embeds it. A host makes one of these and
+    defines any natives it wants scripts to call. Then it can run source outright, which is what the REPL does, with
+    each run seeing the globals the last one left behind. Or it can compile source into a program once and execute
+    that as many times as it likes, which skips every step but interpreting, and where each execution starts from
+    fresh globals that hold only the natives, so one run can't leak into the next.
+    */
     struct Lox {
+        // Declared first so it's destroyed last; functions on the deferred heap point into the AST
+        Ast_arena ast_arena;
+
         gcpp::deferred_heap deferred_heap;
 
+        Interpreter interpreter;
+
+        Resolver resolver;
+
+        Optimizer optimizer {ast_arena, interpreter};
+
+        explicit Lox();
+
+        // Print statements write to `out` rather than to stdout. It must outlive this.
+        explicit Lox(std::ostream& out);
+
         auto parse(Token_iterator&& token_iter) {
-            return ::motts::lox::parse(deferred_heap, move(token_iter));
+            return ::motts::lox::parse(ast_arena, move(token_iter));
         }
 
-        Interpreter interpreter {deferred_heap};
+        // Throws if the source has errors
+        Program compile(const std::string& source);
 
-        Resolver resolver {interpreter};
+        void execute(const Program&);
 
-        Lox() {
-            deferred_heap.set_collect_before_expand(true);
-        }
+        void run(const std::string& source);
+
+        void define_native(const std::string& name, Native_fn, int arity);
+
+        // The typed form, which takes its arity and conversions from fn's signature. See native.hpp.
+        template<typename F>
+            void define_native(const std::string& name, F fn) {
+                interpreter.define_native(name, std::move(fn));
+            }
     };
 }}
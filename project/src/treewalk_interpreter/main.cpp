@@ -10,7 +10,6 @@
 
 #include "exception.hpp"
 #include "lox.hpp"
-#include "scanner.hpp"
 
 using std::cerr;
 using std::cin;
@@ -28,30 +27,9 @@ namespace loxns = motts::lox;
 
 // Not exported (internal linkage)
 namespace {
-    auto run(const string& source, loxns::Lox& lox) {
-        const auto statements = lox.parse(loxns::Token_iterator{source});
-
-        string resolver_errors;
-        for (const auto& statement : statements) {
-            try {
-                statement->accept(statement, lox.resolver);
-            } catch (const loxns::Resolver_error& error) {
-                resolver_errors += error.what();
-                resolver_errors += "\n";
-            }
-        }
-        if (!resolver_errors.empty()) {
-            throw loxns::Resolver_error{resolver_errors};
-        }
-
-        for (const auto& statement : statements) {
-            statement->accept(statement, lox.interpreter);
-        }
-    }
-
     auto run(const string& source) {
         loxns::Lox lox;
-        run(source, lox);
+        lox.run(source);
     }
 
     auto run_file(const string& path) {
@@ -76,7 +54,7 @@ namespace {
 
             // If the user makes a mistake, it shouldn't kill their entire session
             try {
-                run(source_line, lox);
+                lox.run(source_line);
             } catch (const loxns::Runtime_error& error) {
                 cerr << error.what() << "\n";
             }
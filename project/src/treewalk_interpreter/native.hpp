@@ -0,0 +1,168 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+#include <boost/variant.hpp>
+#include <gsl/span>
+
+#include "exception.hpp"
+#include "literal.hpp"
+
+namespace motts { namespace lox {
+    // Natives get their arguments as a view of the caller's argument buffer. A native can be any callable, so a host
+    // program can bind its own state into one.
+    using Native_fn = std::function<Literal(gsl::span<const Literal> arguments)>;
+
+    /*
+    Typed natives. A host can define a native from any callable whose parameter and return types are ones that Lox
+    literals convert to and from, and the arity and the conversions are worked out at compile time from the callable's
+    signature. A string parameter taken by const reference refers to the caller's own argument, so a call copies
+    nothing. A parameter or return type with no conversion below is a compile error.
+    */
+
+    // Converts an argument to a parameter type, or throws if the argument is the wrong Lox type
+    template<typename T>
+        struct Native_arg;
+
+    template<>
+        struct Native_arg<double> {
+            static double from(const Literal& argument, int index) {
+                const auto value = boost::get<double>(&argument.value);
+                if (!value) {
+                    throw Runtime_error{"Argument " + std::to_string(index + 1) + " must be a number."};
+                }
+
+                return *value;
+            }
+        };
+
+    template<>
+        struct Native_arg<bool> {
+            static bool from(const Literal& argument, int index) {
+                const auto value = boost::get<bool>(&argument.value);
+                if (!value) {
+                    throw Runtime_error{"Argument " + std::to_string(index + 1) + " must be a boolean."};
+                }
+
+                return *value;
+            }
+        };
+
+    template<>
+        struct Native_arg<std::string> {
+            static const std::string& from(const Literal& argument, int index) {
+                const auto value = boost::get<std::string>(&argument.value);
+                if (!value) {
+                    throw Runtime_error{"Argument " + std::to_string(index + 1) + " must be a string."};
+                }
+
+                return *value;
+            }
+        };
+
+    // Any Lox value, unconverted
+    template<>
+        struct Native_arg<Literal> {
+            static const Literal& from(const Literal& argument, int /*index*/) {
+                return argument;
+            }
+        };
+
+    // Converts a native's return to a Lox value
+    template<typename T>
+        struct Native_result;
+
+    template<>
+        struct Native_result<double> {
+            static Literal to(double result) {
+                return Literal{result};
+            }
+        };
+
+    template<>
+        struct Native_result<bool> {
+            static Literal to(bool result) {
+                return Literal{result};
+            }
+        };
+
+    template<>
+        struct Native_result<std::string> {
+            static Literal to(std::string result) {
+                return Literal{std::move(result)};
+            }
+        };
+
+    template<>
+        struct Native_result<std::nullptr_t> {
+            static Literal to(std::nullptr_t result) {
+                return Literal{result};
+            }
+        };
+
+    template<>
+        struct Native_result<Literal> {
+            static Literal to(Literal result) {
+                return result;
+            }
+        };
+
+    template<typename Result, typename... Params>
+        struct Native_binding {
+            static constexpr int arity {sizeof...(Params)};
+
+            template<typename F>
+                static Native_fn bind(F fn) {
+                    return [fn = std::move(fn)] (gsl::span<const Literal> arguments) mutable {
+                        // The interpreter has already checked the argument count against arity
+                        return call(fn, arguments, std::index_sequence_for<Params...>{}, std::is_void<Result>{});
+                    };
+                }
+
+            private:
+                template<typename F, std::size_t... indexes>
+                    static Literal call(
+                        F& fn, gsl::span<const Literal> arguments, std::index_sequence<indexes...>,
+                        std::false_type /*void*/
+                    ) {
+                        static_cast<void>(arguments);
+                        return Native_result<std::decay_t<Result>>::to(
+                            fn(Native_arg<std::decay_t<Params>>::from(arguments[indexes], indexes)...)
+                        );
+                    }
+
+                // A native that returns nothing returns nil
+                template<typename F, std::size_t... indexes>
+                    static Literal call(
+                        F& fn, gsl::span<const Literal> arguments, std::index_sequence<indexes...>,
+                        std::true_type /*void*/
+                    ) {
+                        static_cast<void>(arguments);
+                        fn(Native_arg<std::decay_t<Params>>::from(arguments[indexes], indexes)...);
+                        return Literal{};
+                    }
+        };
+
+    // Finds the binding from a function pointer's type, or from a lambda's or function object's call operator
+    template<typename F>
+        struct Native_signature : Native_signature<decltype(&F::operator())> {};
+
+    template<typename Result, typename... Params>
+        struct Native_signature<Result (*)(Params...)> {
+            using Binding = Native_binding<Result, Params...>;
+        };
+
+    template<typename Object, typename Result, typename... Params>
+        struct Native_signature<Result (Object::*)(Params...)> {
+            using Binding = Native_binding<Result, Params...>;
+        };
+
+    template<typename Object, typename Result, typename... Params>
+        struct Native_signature<Result (Object::*)(Params...) const> {
+            using Binding = Native_binding<Result, Params...>;
+        };
+}}
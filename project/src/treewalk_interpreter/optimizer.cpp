@@ -0,0 +1,315 @@
+#include "optimizer.hpp"
+
+#include <cstddef>
+
+#include <boost/variant.hpp>
+
+using std::move;
+using std::nullptr_t;
+using std::vector;
+
+using boost::optional;
+using boost::static_visitor;
+
+// Allow the internal linkage section to access names
+using namespace motts::lox;
+
+// Not exported (internal linkage)
+namespace {
+    // Only false and nil are falsey, everything else is truthy
+    struct Is_truthy_visitor : static_visitor<bool> {
+        auto operator()(bool value) const {
+            return value;
+        }
+
+        auto operator()(nullptr_t) const {
+            return false;
+        }
+
+        template<typename T>
+            auto operator()(const T&) const {
+                return true;
+            }
+    };
+
+    bool is_truthy(const Literal_expr* literal) {
+        return boost::apply_visitor(Is_truthy_visitor{}, literal->value.value);
+    }
+}
+
+// Exported (external linkage)
+namespace motts { namespace lox {
+    Optimizer::Optimizer(Ast_arena& arena, Interpreter& interpreter) :
+        arena_ {arena},
+        interpreter_ {interpreter}
+    {}
+
+    vector<const Stmt*> Optimizer::optimize(const vector<const Stmt*>& statements) {
+        vector<const Stmt*> optimized;
+        for (const auto statement : statements) {
+            const auto optimized_statement = optimize(statement);
+            if (optimized_statement) {
+                optimized.push_back(optimized_statement);
+            }
+        }
+
+        return optimized;
+    }
+
+    void Optimizer::visit(const Binary_expr* expr) {
+        const auto left = optimize(expr->left);
+        const auto right = optimize(expr->right);
+
+        const auto binary_expr = left.expr == expr->left && right.expr == expr->right ?
+            expr :
+            arena_.make<Binary_expr>(left.expr, Token{expr->op}, right.expr);
+
+        expr_result_ = left.literal && right.literal ? fold(binary_expr) : Optimized_expr{binary_expr, nullptr};
+    }
+
+    void Optimizer::visit(const Grouping_expr* expr) {
+        const auto inner = optimize(expr->expr);
+        if (inner.literal) {
+            // Parentheses around a literal don't do anything
+            expr_result_ = inner;
+            return;
+        }
+
+        expr_result_ = {inner.expr == expr->expr ? expr : arena_.make<Grouping_expr>(inner.expr), nullptr};
+    }
+
+    void Optimizer::visit(const Literal_expr* expr) {
+        expr_result_ = {expr, expr};
+    }
+
+    void Optimizer::visit(const Unary_expr* expr) {
+        const auto right = optimize(expr->right);
+
+        const auto unary_expr = right.expr == expr->right ?
+            expr :
+            arena_.make<Unary_expr>(Token{expr->op}, right.expr);
+
+        expr_result_ = right.literal ? fold(unary_expr) : Optimized_expr{unary_expr, nullptr};
+    }
+
+    void Optimizer::visit(const Var_expr* expr) {
+        expr_result_ = {expr, nullptr};
+    }
+
+    void Optimizer::visit(const Assign_expr* expr) {
+        const auto value = optimize(expr->value);
+        if (value.expr == expr->value) {
+            expr_result_ = {expr, nullptr};
+            return;
+        }
+
+        const auto assign_expr = arena_.make<Assign_expr>(Token{expr->name}, value.expr);
+        assign_expr->local = expr->local;
+        expr_result_ = {assign_expr, nullptr};
+    }
+
+    void Optimizer::visit(const Logical_expr* expr) {
+        const auto left = optimize(expr->left);
+        const auto right = optimize(expr->right);
+
+        // A literal on the left decides right now whether the result is the left operand or the right one
+        if (left.literal) {
+            const auto is_or = expr->op.type == Token_type::or_;
+            expr_result_ = is_truthy(left.literal) == is_or ? left : right;
+            return;
+        }
+
+        expr_result_ = {
+            left.expr == expr->left && right.expr == expr->right ?
+                expr :
+                arena_.make<Logical_expr>(left.expr, Token{expr->op}, right.expr),
+            nullptr
+        };
+    }
+
+    void Optimizer::visit(const Call_expr* expr) {
+        const auto callee = optimize(expr->callee);
+        auto is_changed = callee.expr != expr->callee;
+
+        vector<const Expr*> arguments;
+        for (const auto argument : expr->arguments) {
+            arguments.push_back(optimize(argument).expr);
+            is_changed = is_changed || arguments.back() != argument;
+        }
+
+        if (!is_changed) {
+            expr_result_ = {expr, nullptr};
+            return;
+        }
+
+        // Optimizing a property access gives back a property access
+        const auto method_callee = expr->method_callee ? static_cast<const Get_expr*>(callee.expr) : nullptr;
+
+        expr_result_ = {
+            arena_.make<Call_expr>(callee.expr, Token{expr->closing_paren}, move(arguments), method_callee),
+            nullptr
+        };
+    }
+
+    void Optimizer::visit(const Get_expr* expr) {
+        const auto object = optimize(expr->object);
+        expr_result_ = {
+            object.expr == expr->object ? expr : arena_.make<Get_expr>(object.expr, Token{expr->name}),
+            nullptr
+        };
+    }
+
+    void Optimizer::visit(const Set_expr* expr) {
+        const auto object = optimize(expr->object);
+        const auto value = optimize(expr->value);
+        expr_result_ = {
+            object.expr == expr->object && value.expr == expr->value ?
+                expr :
+                arena_.make<Set_expr>(object.expr, Token{expr->name}, value.expr),
+            nullptr
+        };
+    }
+
+    void Optimizer::visit(const Super_expr* expr) {
+        expr_result_ = {expr, nullptr};
+    }
+
+    void Optimizer::visit(const This_expr* expr) {
+        expr_result_ = {expr, nullptr};
+    }
+
+    void Optimizer::visit(const Function_expr* expr) {
+        expr_result_ = {optimize(expr), nullptr};
+    }
+
+    void Optimizer::visit(const Expr_stmt* stmt) {
+        const auto expr = optimize(stmt->expr).expr;
+        stmt_result_ = expr == stmt->expr ? stmt : arena_.make<Expr_stmt>(expr);
+    }
+
+    void Optimizer::visit(const If_stmt* stmt) {
+        const auto condition = optimize(stmt->condition);
+        if (condition.literal) {
+            if (is_truthy(condition.literal)) {
+                stmt_result_ = optimize(stmt->then_branch);
+            } else {
+                stmt_result_ = stmt->else_branch ? optimize(stmt->else_branch) : nullptr;
+            }
+
+            return;
+        }
+
+        const auto then_branch = optimize_required(stmt->then_branch);
+        const auto else_branch = stmt->else_branch ? optimize(stmt->else_branch) : nullptr;
+        const auto is_changed =
+            condition.expr != stmt->condition || then_branch != stmt->then_branch || else_branch != stmt->else_branch;
+        stmt_result_ = is_changed ? arena_.make<If_stmt>(condition.expr, then_branch, else_branch) : stmt;
+    }
+
+    void Optimizer::visit(const Print_stmt* stmt) {
+        const auto expr = optimize(stmt->expr).expr;
+        stmt_result_ = expr == stmt->expr ? stmt : arena_.make<Print_stmt>(expr);
+    }
+
+    void Optimizer::visit(const While_stmt* stmt) {
+        const auto condition = optimize(stmt->condition);
+        if (condition.literal && !is_truthy(condition.literal)) {
+            stmt_result_ = nullptr;
+            return;
+        }
+
+        const auto body = optimize_required(stmt->body);
+        stmt_result_ = condition.expr == stmt->condition && body == stmt->body ?
+            stmt :
+            arena_.make<While_stmt>(condition.expr, body);
+    }
+
+    void Optimizer::visit(const For_stmt* stmt) {
+        const auto condition = optimize(stmt->condition);
+        if (condition.literal && !is_truthy(condition.literal)) {
+            stmt_result_ = nullptr;
+            return;
+        }
+
+        const auto increment = optimize(stmt->increment).expr;
+        const auto body = optimize_required(stmt->body);
+        stmt_result_ = condition.expr == stmt->condition && increment == stmt->increment && body == stmt->body ?
+            stmt :
+            arena_.make<For_stmt>(condition.expr, increment, body);
+    }
+
+    void Optimizer::visit(const Break_stmt* stmt) {
+        stmt_result_ = stmt;
+    }
+
+    void Optimizer::visit(const Continue_stmt* stmt) {
+        stmt_result_ = stmt;
+    }
+
+    void Optimizer::visit(const Var_stmt* stmt) {
+        const auto initializer = stmt->initializer ? optimize(stmt->initializer).expr : nullptr;
+        stmt_result_ = initializer == stmt->initializer ? stmt : arena_.make<Var_stmt>(Token{stmt->name}, initializer);
+    }
+
+    void Optimizer::visit(const Block_stmt* stmt) {
+        auto statements = optimize(stmt->statements);
+        stmt_result_ = statements == stmt->statements ? stmt : arena_.make<Block_stmt>(move(statements));
+    }
+
+    void Optimizer::visit(const Class_stmt* stmt) {
+        auto is_changed = false;
+        vector<const Function_stmt*> methods;
+        for (const auto method : stmt->methods) {
+            const auto method_expr = optimize(method->expr);
+            methods.push_back(method_expr == method->expr ? method : arena_.make<Function_stmt>(method_expr));
+            is_changed = is_changed || methods.back() != method;
+        }
+
+        stmt_result_ = is_changed ? arena_.make<Class_stmt>(Token{stmt->name}, stmt->superclass, move(methods)) : stmt;
+    }
+
+    void Optimizer::visit(const Function_stmt* stmt) {
+        const auto expr = optimize(stmt->expr);
+        stmt_result_ = expr == stmt->expr ? stmt : arena_.make<Function_stmt>(expr);
+    }
+
+    void Optimizer::visit(const Return_stmt* stmt) {
+        const auto value = stmt->value ? optimize(stmt->value).expr : nullptr;
+        stmt_result_ = value == stmt->value ? stmt : arena_.make<Return_stmt>(Token{stmt->keyword}, value);
+    }
+
+    Optimizer::Optimized_expr Optimizer::optimize(const Expr* expr) {
+        expr->accept(*this);
+        return expr_result_;
+    }
+
+    const Stmt* Optimizer::optimize(const Stmt* stmt) {
+        stmt->accept(*this);
+        return stmt_result_;
+    }
+
+    const Stmt* Optimizer::optimize_required(const Stmt* stmt) {
+        const auto optimized = optimize(stmt);
+        return optimized ? optimized : arena_.make<Block_stmt>(vector<const Stmt*>{});
+    }
+
+    const Function_expr* Optimizer::optimize(const Function_expr* expr) {
+        auto body = optimize(expr->body);
+        if (body == expr->body) {
+            return expr;
+        }
+
+        return arena_.make<Function_expr>(optional<Token>{expr->name}, vector<Token>{expr->parameters}, move(body));
+    }
+
+    Optimizer::Optimized_expr Optimizer::fold(const Expr* expr) {
+        try {
+            expr->accept(interpreter_);
+        } catch (const Runtime_error&) {
+            return {expr, nullptr};
+        }
+
+        const auto literal = arena_.make<Literal_expr>(Literal{interpreter_.result()});
+        return {literal, literal};
+    }
+}}
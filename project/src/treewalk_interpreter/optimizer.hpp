@@ -0,0 +1,82 @@
+#pragma once
+
+#include <vector>
+
+#include "ast_arena.hpp"
+#include "expression_impls.hpp"
+#include "expression_visitor.hpp"
+#include "interpreter.hpp"
+#include "statement_impls.hpp"
+#include "statement_visitor.hpp"
+
+namespace motts { namespace lox {
+    /*
+    Runs between the resolver and the interpreter. Folds operators whose operands are all literals, short-circuits
+    logical operators whose left operand is a literal, and drops branches and loops that a literal condition makes
+    unreachable.
+
+    The tree is immutable, so a node whose children changed is copied into the arena with the new children, resolved
+    locations and all, and a node whose children didn't change is kept as is. Folding evaluates the node with the
+    interpreter itself, so a folded value is exactly what the interpreter would have computed. An operator that would
+    fail at runtime, such as adding a number to a string, isn't folded, so the error still happens at runtime.
+    */
+    class Optimizer : public Expr_visitor, public Stmt_visitor {
+        public:
+            explicit Optimizer(Ast_arena&, Interpreter&);
+
+            std::vector<const Stmt*> optimize(const std::vector<const Stmt*>&);
+
+            void visit(const Binary_expr*) override;
+            void visit(const Grouping_expr*) override;
+            void visit(const Literal_expr*) override;
+            void visit(const Unary_expr*) override;
+            void visit(const Var_expr*) override;
+            void visit(const Assign_expr*) override;
+            void visit(const Logical_expr*) override;
+            void visit(const Call_expr*) override;
+            void visit(const Get_expr*) override;
+            void visit(const Set_expr*) override;
+            void visit(const Super_expr*) override;
+            void visit(const This_expr*) override;
+            void visit(const Function_expr*) override;
+
+            void visit(const Expr_stmt*) override;
+            void visit(const If_stmt*) override;
+            void visit(const Print_stmt*) override;
+            void visit(const While_stmt*) override;
+            void visit(const For_stmt*) override;
+            void visit(const Break_stmt*) override;
+            void visit(const Continue_stmt*) override;
+            void visit(const Var_stmt*) override;
+            void visit(const Block_stmt*) override;
+            void visit(const Class_stmt*) override;
+            void visit(const Function_stmt*) override;
+            void visit(const Return_stmt*) override;
+
+        private:
+            // The literal is set only if the optimized expression is a literal
+            struct Optimized_expr {
+                const Expr* expr;
+                const Literal_expr* literal;
+            };
+
+            Optimized_expr optimize(const Expr*);
+
+            // Returns null for a statement that does nothing at all
+            const Stmt* optimize(const Stmt*);
+
+            // For a statement that has to stay a statement, such as a loop body. Never returns null.
+            const Stmt* optimize_required(const Stmt*);
+
+            const Function_expr* optimize(const Function_expr*);
+
+            // Evaluates an operator whose operands are all literals. Keeps the operator if evaluating it fails.
+            Optimized_expr fold(const Expr*);
+
+            Ast_arena& arena_;
+            Interpreter& interpreter_;
+
+            Optimized_expr expr_result_ {};
+            const Stmt* stmt_result_ {};
+    };
+}}
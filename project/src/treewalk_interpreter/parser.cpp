@@ -3,6 +3,8 @@
 #include <functional>
 #include <utility>
 
+#include <gsl/gsl_util>
+
 #include "expression_impls.hpp"
 #include "statement_impls.hpp"
 
@@ -13,8 +15,7 @@ using std::to_string;
 using std::vector;
 
 using boost::optional;
-using deferred_heap_t = gcpp::deferred_heap;
-using gcpp::deferred_ptr;
+using gsl::narrow;
 
 // Allow the internal linkage section to access names
 using namespace motts::lox;
@@ -23,11 +24,11 @@ using namespace motts::lox;
 namespace {
     // There's no invariant being maintained here; this exists primarily to avoid lots of manual argument passing
     struct Parser {
-        deferred_heap_t& deferred_heap;
+        Ast_arena& arena;
         Token_iterator& token_iter;
         function<void(const Parser_error&)> on_resumable_error;
 
-        deferred_ptr<const Stmt> consume_declaration() {
+        const Stmt* consume_declaration() {
             try {
                 if (advance_if_match(Token_type::class_)) return consume_class_declaration();
                 if (advance_if_match(Token_type::fun_)) return consume_function_declaration();
@@ -40,46 +41,46 @@ namespace {
             }
         }
 
-        deferred_ptr<const Stmt> consume_var_declaration() {
+        const Stmt* consume_var_declaration() {
             auto var_name = consume(Token_type::identifier, "Expected variable name.");
 
-            deferred_ptr<const Expr> initializer;
+            const Expr* initializer {};
             if (advance_if_match(Token_type::equal)) {
                 initializer = consume_expression();
             }
 
             consume(Token_type::semicolon, "Expected ';' after variable declaration.");
 
-            return deferred_heap.make<Var_stmt>(move(var_name), move(initializer));
+            return arena.make<Var_stmt>(move(var_name), move(initializer));
         }
 
-        deferred_ptr<const Stmt> consume_class_declaration() {
+        const Stmt* consume_class_declaration() {
             auto name = consume(Token_type::identifier, "Expected class name.");
 
-            deferred_ptr<const Var_expr> superclass;
+            const Var_expr* superclass {};
             if (advance_if_match(Token_type::less)) {
                 auto super_name = consume(Token_type::identifier, "Expected superclass name.");
-                superclass = deferred_heap.make<Var_expr>(move(super_name));
+                superclass = arena.make<Var_expr>(move(super_name));
             }
 
             consume(Token_type::left_brace, "Expected '{' before class body.");
 
-            vector<deferred_ptr<const Function_stmt>> methods;
+            vector<const Function_stmt*> methods;
             while (token_iter->type != Token_type::right_brace && token_iter->type != Token_type::eof) {
                 methods.push_back(consume_function_declaration());
             }
 
             consume(Token_type::right_brace, "Expected '}' after class body.");
 
-            return deferred_heap.make<Class_stmt>(move(name), move(superclass), move(methods));
+            return arena.make<Class_stmt>(move(name), move(superclass), move(methods));
         }
 
-        deferred_ptr<const Function_stmt> consume_function_declaration() {
+        const Function_stmt* consume_function_declaration() {
             auto name = consume(Token_type::identifier, "Expected function name.");
-            return deferred_heap.make<Function_stmt>(consume_finish_function(move(name)));
+            return arena.make<Function_stmt>(consume_finish_function(move(name)));
         }
 
-        deferred_ptr<const Function_expr> consume_function_expression() {
+        const Function_expr* consume_function_expression() {
             optional<Token> name;
             if (token_iter->type == Token_type::identifier) {
                 name = *move(token_iter);
@@ -89,7 +90,7 @@ namespace {
             return consume_finish_function(std::move(name));
         }
 
-        deferred_ptr<const Function_expr> consume_finish_function(optional<Token>&& name) {
+        const Function_expr* consume_finish_function(optional<Token>&& name) {
             consume(Token_type::left_paren, "Expected '(' after function name.");
             vector<Token> parameters;
             if (token_iter->type != Token_type::right_paren) {
@@ -97,8 +98,8 @@ namespace {
                     parameters.push_back(consume(Token_type::identifier, "Expected parameter name."));
                 } while (advance_if_match(Token_type::comma));
 
-                if (parameters.size() > 8) {
-                    throw Parser_error{"Cannot have more than 8 parameters.", *token_iter};
+                if (narrow<int>(parameters.size()) > max_arity) {
+                    throw Parser_error{"Cannot have more than " + to_string(max_arity) + " parameters.", *token_iter};
                 }
             }
             consume(Token_type::right_paren, "Expected ')' after parameters.");
@@ -106,10 +107,10 @@ namespace {
             consume(Token_type::left_brace, "Expected '{' before function body.");
             auto body = consume_block_statement();
 
-            return deferred_heap.make<Function_expr>(std::move(name), move(parameters), move(body));
+            return arena.make<Function_expr>(std::move(name), move(parameters), move(body));
         }
 
-        deferred_ptr<const Stmt> consume_statement() {
+        const Stmt* consume_statement() {
             if (advance_if_match(Token_type::for_)) return consume_for_statement();
             if (advance_if_match(Token_type::if_)) return consume_if_statement();
             if (advance_if_match(Token_type::print_)) return consume_print_statement();
@@ -119,21 +120,29 @@ namespace {
                 return consume_return_statement(move(keyword));
             }
             if (advance_if_match(Token_type::while_)) return consume_while_statement();
-            if (advance_if_match(Token_type::left_brace)) return deferred_heap.make<Block_stmt>(consume_block_statement());
-            if (advance_if_match(Token_type::break_)) return consume_break_statement();
-            if (advance_if_match(Token_type::continue_)) return consume_continue_statement();
+            if (advance_if_match(Token_type::left_brace)) return arena.make<Block_stmt>(consume_block_statement());
+            if (token_iter->type == Token_type::break_) {
+                auto keyword = *move(token_iter);
+                ++token_iter;
+                return consume_break_statement(move(keyword));
+            }
+            if (token_iter->type == Token_type::continue_) {
+                auto keyword = *move(token_iter);
+                ++token_iter;
+                return consume_continue_statement(move(keyword));
+            }
             return consume_expression_statement();
         }
 
-        deferred_ptr<const Stmt> consume_expression_statement() {
+        const Stmt* consume_expression_statement() {
             auto expr = consume_expression();
             consume(Token_type::semicolon, "Expected ';' after expression.");
 
-            return deferred_heap.make<Expr_stmt>(move(expr));
+            return arena.make<Expr_stmt>(move(expr));
         }
 
-        vector<deferred_ptr<const Stmt>> consume_block_statement() {
-            vector<deferred_ptr<const Stmt>> statements;
+        vector<const Stmt*> consume_block_statement() {
+            vector<const Stmt*> statements;
             while (token_iter->type != Token_type::right_brace && token_iter->type != Token_type::eof) {
                 statements.push_back(consume_declaration());
             }
@@ -142,10 +151,10 @@ namespace {
             return statements;
         }
 
-        deferred_ptr<const Stmt> consume_for_statement() {
+        const Stmt* consume_for_statement() {
             consume(Token_type::left_paren, "Expected '(' after 'for'.");
 
-            deferred_ptr<const Stmt> initializer;
+            const Stmt* initializer {};
             if (advance_if_match(Token_type::semicolon)) {
                 // initializer is already null
             } else if (advance_if_match(Token_type::var_)) {
@@ -154,86 +163,86 @@ namespace {
                 initializer = consume_expression_statement();
             }
 
-            deferred_ptr<const Expr> condition {
+            const Expr* condition {
                 token_iter->type != Token_type::semicolon ?
                     consume_expression() :
-                    deferred_heap.make<Literal_expr>(Literal{true})
+                    arena.make<Literal_expr>(Literal{true})
             };
             consume(Token_type::semicolon, "Expected ';' after loop condition.");
 
-            deferred_ptr<const Expr> increment {
+            const Expr* increment {
                 token_iter->type != Token_type::right_paren ?
                     consume_expression() :
-                    deferred_heap.make<Literal_expr>(Literal{})
+                    arena.make<Literal_expr>(Literal{})
             };
 
             consume(Token_type::right_paren, "Expected ')' after for clauses.");
             auto body = consume_statement();
-            body = deferred_heap.make<For_stmt>(move(condition), move(increment), move(body));
+            body = arena.make<For_stmt>(move(condition), move(increment), move(body));
             if (initializer) {
-                body = deferred_heap.make<Block_stmt>(vector<deferred_ptr<const Stmt>>{move(initializer), move(body)});
+                body = arena.make<Block_stmt>(vector<const Stmt*>{move(initializer), move(body)});
             }
 
             return body;
         }
 
-        deferred_ptr<const Stmt> consume_if_statement() {
+        const Stmt* consume_if_statement() {
             consume(Token_type::left_paren, "Expected '(' after 'if'.");
             auto condition = consume_expression();
             consume(Token_type::right_paren, "Expected ')' after if condition.");
 
             auto then_branch = consume_statement();
 
-            deferred_ptr<const Stmt> else_branch;
+            const Stmt* else_branch {};
             if (advance_if_match(Token_type::else_)) {
                 else_branch = consume_statement();
             }
 
-            return deferred_heap.make<If_stmt>(move(condition), move(then_branch), move(else_branch));
+            return arena.make<If_stmt>(move(condition), move(then_branch), move(else_branch));
         }
 
-        deferred_ptr<const Stmt> consume_while_statement() {
+        const Stmt* consume_while_statement() {
             consume(Token_type::left_paren, "Expected '(' after 'while'.");
             auto condition = consume_expression();
             consume(Token_type::right_paren, "Expected ')' after condition.");
 
             auto body = consume_statement();
 
-            return deferred_heap.make<While_stmt>(move(condition), move(body));
+            return arena.make<While_stmt>(move(condition), move(body));
         }
 
-        deferred_ptr<const Stmt> consume_print_statement() {
+        const Stmt* consume_print_statement() {
             auto value = consume_expression();
             consume(Token_type::semicolon, "Expected ';' after value.");
 
-            return deferred_heap.make<Print_stmt>(move(value));
+            return arena.make<Print_stmt>(move(value));
         }
 
-        deferred_ptr<const Stmt> consume_return_statement(Token&& keyword) {
-            deferred_ptr<const Expr> value;
+        const Stmt* consume_return_statement(Token&& keyword) {
+            const Expr* value {};
             if (token_iter->type != Token_type::semicolon) {
                 value = consume_expression();
             }
             consume(Token_type::semicolon, "Expected ';' after return value.");
 
-            return deferred_heap.make<Return_stmt>(move(keyword), move(value));
+            return arena.make<Return_stmt>(move(keyword), move(value));
         }
 
-        deferred_ptr<const Stmt> consume_break_statement() {
+        const Stmt* consume_break_statement(Token&& keyword) {
             consume(Token_type::semicolon, "Expected ';' after 'break'.");
-            return deferred_heap.make<Break_stmt>();
+            return arena.make<Break_stmt>(move(keyword));
         }
 
-        deferred_ptr<const Stmt> consume_continue_statement() {
+        const Stmt* consume_continue_statement(Token&& keyword) {
             consume(Token_type::semicolon, "Expected ';' after 'continue'.");
-            return deferred_heap.make<Continue_stmt>();
+            return arena.make<Continue_stmt>(move(keyword));
         }
 
-        deferred_ptr<const Expr> consume_expression() {
+        const Expr* consume_expression() {
             return consume_assignment();
         }
 
-        deferred_ptr<const Expr> consume_assignment() {
+        const Expr* consume_assignment() {
             auto left_expr = consume_or();
 
             if (token_iter->type == Token_type::equal) {
@@ -249,7 +258,7 @@ namespace {
                 return left_expr->make_assignment_expression(
                     move(left_expr),
                     move(right_expr),
-                    deferred_heap,
+                    arena,
                     Parser_error{"Invalid assignment target.", op}
                 );
             }
@@ -257,7 +266,7 @@ namespace {
             return left_expr;
         }
 
-        deferred_ptr<const Expr> consume_or() {
+        const Expr* consume_or() {
             auto left_expr = consume_and();
 
             while (token_iter->type == Token_type::or_) {
@@ -265,13 +274,13 @@ namespace {
                 ++token_iter;
                 auto right_expr = consume_and();
 
-                left_expr = deferred_heap.make<Logical_expr>(move(left_expr), move(op), move(right_expr));
+                left_expr = arena.make<Logical_expr>(move(left_expr), move(op), move(right_expr));
             }
 
             return left_expr;
         }
 
-        deferred_ptr<const Expr> consume_and() {
+        const Expr* consume_and() {
             auto left_expr = consume_equality();
 
             while (token_iter->type == Token_type::and_) {
@@ -279,13 +288,13 @@ namespace {
                 ++token_iter;
                 auto right_expr = consume_equality();
 
-                left_expr = deferred_heap.make<Logical_expr>(move(left_expr), move(op), move(right_expr));
+                left_expr = arena.make<Logical_expr>(move(left_expr), move(op), move(right_expr));
             }
 
             return left_expr;
         }
 
-        deferred_ptr<const Expr> consume_equality() {
+        const Expr* consume_equality() {
             auto left_expr = consume_comparison();
 
             while (token_iter->type == Token_type::bang_equal || token_iter->type == Token_type::equal_equal) {
@@ -293,13 +302,13 @@ namespace {
                 ++token_iter;
                 auto right_expr = consume_comparison();
 
-                left_expr = deferred_heap.make<Binary_expr>(move(left_expr), move(op), move(right_expr));
+                left_expr = arena.make<Binary_expr>(move(left_expr), move(op), move(right_expr));
             }
 
             return left_expr;
         }
 
-        deferred_ptr<const Expr> consume_comparison() {
+        const Expr* consume_comparison() {
             auto left_expr = consume_addition();
 
             while (
@@ -310,13 +319,13 @@ namespace {
                 ++token_iter;
                 auto right_expr = consume_addition();
 
-                left_expr = deferred_heap.make<Binary_expr>(move(left_expr), move(op), move(right_expr));
+                left_expr = arena.make<Binary_expr>(move(left_expr), move(op), move(right_expr));
             }
 
             return left_expr;
         }
 
-        deferred_ptr<const Expr> consume_addition() {
+        const Expr* consume_addition() {
             auto left_expr = consume_multiplication();
 
             while (token_iter->type == Token_type::minus || token_iter->type == Token_type::plus) {
@@ -324,13 +333,13 @@ namespace {
                 ++token_iter;
                 auto right_expr = consume_multiplication();
 
-                left_expr = deferred_heap.make<Binary_expr>(move(left_expr), move(op), move(right_expr));
+                left_expr = arena.make<Binary_expr>(move(left_expr), move(op), move(right_expr));
             }
 
             return left_expr;
         }
 
-        deferred_ptr<const Expr> consume_multiplication() {
+        const Expr* consume_multiplication() {
             auto left_expr = consume_unary();
 
             while (token_iter->type == Token_type::slash || token_iter->type == Token_type::star) {
@@ -338,36 +347,38 @@ namespace {
                 ++token_iter;
                 auto right_expr = consume_unary();
 
-                left_expr = deferred_heap.make<Binary_expr>(move(left_expr), move(op), move(right_expr));
+                left_expr = arena.make<Binary_expr>(move(left_expr), move(op), move(right_expr));
             }
 
             return left_expr;
         }
 
-        deferred_ptr<const Expr> consume_unary() {
+        const Expr* consume_unary() {
             if (token_iter->type == Token_type::bang || token_iter->type == Token_type::minus) {
                 auto op = *move(token_iter);
                 ++token_iter;
                 auto right_expr = consume_unary();
 
-                return deferred_heap.make<Unary_expr>(move(op), move(right_expr));
+                return arena.make<Unary_expr>(move(op), move(right_expr));
             }
 
             return consume_call();
         }
 
-        deferred_ptr<const Expr> consume_call() {
+        const Expr* consume_call() {
             auto expr = consume_primary();
+            const Get_expr* get_expr {};
 
             while (true) {
                 if (advance_if_match(Token_type::left_paren)) {
-                    expr = consume_finish_call(move(expr));
+                    expr = consume_finish_call(move(expr), expr == get_expr ? get_expr : nullptr);
                     continue;
                 }
 
                 if (advance_if_match(Token_type::dot)) {
                     auto name = consume(Token_type::identifier, "Expected property name after '.'.");
-                    expr = deferred_heap.make<Get_expr>(move(expr), move(name));
+                    get_expr = arena.make<Get_expr>(move(expr), move(name));
+                    expr = get_expr;
                     continue;
                 }
 
@@ -377,29 +388,29 @@ namespace {
             return expr;
         }
 
-        deferred_ptr<const Expr> consume_finish_call(deferred_ptr<const Expr>&& callee) {
-            vector<deferred_ptr<const Expr>> arguments;
+        const Expr* consume_finish_call(const Expr* callee, const Get_expr* method_callee) {
+            vector<const Expr*> arguments;
             if (token_iter->type != Token_type::right_paren) {
                 do {
                     arguments.push_back(consume_expression());
                 } while (advance_if_match(Token_type::comma));
 
-                if (arguments.size() > 8) {
-                    throw Parser_error{"Cannot have more than 8 arguments.", *token_iter};
+                if (narrow<int>(arguments.size()) > max_arity) {
+                    throw Parser_error{"Cannot have more than " + to_string(max_arity) + " arguments.", *token_iter};
                 }
             }
             auto closing_paren = consume(Token_type::right_paren, "Expected ')' after arguments.");
 
-            return deferred_heap.make<Call_expr>(move(callee), move(closing_paren), move(arguments));
+            return arena.make<Call_expr>(move(callee), move(closing_paren), move(arguments), method_callee);
         }
 
-        deferred_ptr<const Expr> consume_primary() {
-            if (advance_if_match(Token_type::false_)) return deferred_heap.make<Literal_expr>(Literal{false});
-            if (advance_if_match(Token_type::true_)) return deferred_heap.make<Literal_expr>(Literal{true});
-            if (advance_if_match(Token_type::nil_)) return deferred_heap.make<Literal_expr>(Literal{nullptr});
+        const Expr* consume_primary() {
+            if (advance_if_match(Token_type::false_)) return arena.make<Literal_expr>(Literal{false});
+            if (advance_if_match(Token_type::true_)) return arena.make<Literal_expr>(Literal{true});
+            if (advance_if_match(Token_type::nil_)) return arena.make<Literal_expr>(Literal{nullptr});
 
             if (token_iter->type == Token_type::number || token_iter->type == Token_type::string) {
-                auto expr = deferred_heap.make<Literal_expr>(*((*move(token_iter)).literal));
+                auto expr = arena.make<Literal_expr>(*((*move(token_iter)).literal));
                 ++token_iter;
                 return expr;
             }
@@ -409,13 +420,13 @@ namespace {
                 ++token_iter;
                 consume(Token_type::dot, "Expected '.' after 'super'.");
                 auto method = consume(Token_type::identifier, "Expected superclass method name.");
-                return deferred_heap.make<Super_expr>(move(keyword), move(method));
+                return arena.make<Super_expr>(move(keyword), move(method));
             }
 
             if (token_iter->type == Token_type::this_) {
                 auto keyword = *move(token_iter);
                 ++token_iter;
-                return deferred_heap.make<This_expr>(move(keyword));
+                return arena.make<This_expr>(move(keyword));
             }
 
             if (advance_if_match(Token_type::fun_)) {
@@ -423,7 +434,7 @@ namespace {
             }
 
             if (token_iter->type == Token_type::identifier) {
-                auto expr = deferred_heap.make<Var_expr>(*move(token_iter));
+                auto expr = arena.make<Var_expr>(*move(token_iter));
                 ++token_iter;
                 return expr;
             }
@@ -431,7 +442,7 @@ namespace {
             if (advance_if_match(Token_type::left_paren)) {
                 auto expr = consume_expression();
                 consume(Token_type::right_paren, "Expected ')' after expression.");
-                return deferred_heap.make<Grouping_expr>(move(expr));
+                return arena.make<Grouping_expr>(move(expr));
             }
 
             throw Parser_error{"Expected expression.", *token_iter};
@@ -485,12 +496,12 @@ namespace {
 
 // Exported (external linkage)
 namespace motts { namespace lox {
-    vector<deferred_ptr<const Stmt>> parse(deferred_heap_t& deferred_heap, Token_iterator&& token_iter) {
-        vector<deferred_ptr<const Stmt>> statements;
+    vector<const Stmt*> parse(Ast_arena& arena, Token_iterator&& token_iter) {
+        vector<const Stmt*> statements;
 
         string parser_errors;
         Parser parser {
-            deferred_heap,
+            arena,
             token_iter,
             [&] (const Parser_error& error) {
                 parser_errors += error.what();
@@ -3,10 +3,7 @@
 #include <string>
 #include <vector>
 
-#pragma warning(push, 0)
-    #include <deferred_heap.h>
-#pragma warning(pop)
-
+#include "ast_arena.hpp"
 #include "exception.hpp"
 #include "scanner.hpp"
 #include "statement.hpp"
@@ -22,7 +19,8 @@ namespace motts { namespace lox {
     iterator directly rather than on a vector of tokens. This way I was able to eliminate the intermediate data
     structure altogether.
     */
-    std::vector<gcpp::deferred_ptr<const Stmt>> parse(gcpp::deferred_heap&, Token_iterator&&);
+    // Nodes are allocated in the given arena, and live as long as it does
+    std::vector<const Stmt*> parse(Ast_arena&, Token_iterator&&);
 
     struct Parser_error : Runtime_error {
         explicit Parser_error(const std::string& what, const Token&);
@@ -9,27 +9,24 @@ using std::function;
 using std::string;
 using std::to_string;
 
-using gcpp::deferred_ptr;
 using gsl::final_act;
 using gsl::finally;
 using gsl::narrow;
 
 namespace motts { namespace lox {
-    Resolver::Resolver(Interpreter& interpreter) :
-        interpreter_ {interpreter}
-    {}
+    Resolver::Resolver() = default;
 
-    void Resolver::visit(const gcpp::deferred_ptr<const Block_stmt>& stmt) {
+    void Resolver::visit(const Block_stmt* stmt) {
         scopes_.push_back({});
         const auto _ = finally([&] () {
             scopes_.pop_back();
         });
         for (const auto& statement : stmt->statements) {
-            statement->accept(statement, *this);
+            statement->accept(*this);
         }
     }
 
-    void Resolver::visit(const gcpp::deferred_ptr<const Class_stmt>& stmt) {
+    void Resolver::visit(const Class_stmt* stmt) {
         if (!scopes_.empty()) {
             declare_var(stmt->name) = Var_binding::defined;
         }
@@ -43,22 +40,16 @@ namespace motts { namespace lox {
         final_act<function<void()>> _2 {[] () {}};
         if (stmt->superclass) {
             current_class_type_ = Class_type::subclass;
-            stmt->superclass->accept(stmt->superclass, *this);
+            stmt->superclass->accept(*this);
 
             scopes_.push_back({});
             _2 = finally(function<void()>{[&] () {
                 scopes_.pop_back();
             }});
 
-            scopes_.back()["super"] = Var_binding::defined;
+            scopes_.back()["super"] = {Var_binding::defined, 0};
         }
 
-        scopes_.push_back({});
-        const auto _3 = finally([&] () {
-            scopes_.pop_back();
-        });
-        scopes_.back()["this"] = Var_binding::defined;
-
         for (const auto& method : stmt->methods) {
             resolve_function(
                 method->expr,
@@ -69,37 +60,37 @@ namespace motts { namespace lox {
         }
     }
 
-    void Resolver::visit(const gcpp::deferred_ptr<const Var_stmt>& stmt) {
+    void Resolver::visit(const Var_stmt* stmt) {
         if (!scopes_.empty()) {
             declare_var(stmt->name);
         }
 
         if (stmt->initializer) {
-            stmt->initializer->accept(stmt->initializer, *this);
+            stmt->initializer->accept(*this);
         }
 
         if (!scopes_.empty()) {
-            scopes_.back()[stmt->name.lexeme] = Var_binding::defined;
+            scopes_.back()[stmt->name.lexeme].binding = Var_binding::defined;
         }
     }
 
-    void Resolver::visit(const gcpp::deferred_ptr<const Var_expr>& expr) {
+    void Resolver::visit(const Var_expr* expr) {
         if (!scopes_.empty()) {
             const auto found_declared_in_scope = scopes_.back().find(expr->name.lexeme);
-            if (found_declared_in_scope != scopes_.back().cend() && found_declared_in_scope->second == Var_binding::declared) {
+            if (found_declared_in_scope != scopes_.back().cend() && found_declared_in_scope->second.binding == Var_binding::declared) {
                 throw Resolver_error{"Cannot read local variable in its own initializer.", expr->name};
             }
         }
 
-        resolve_local(expr, expr->name.lexeme);
+        resolve_local(expr->local, expr->name.lexeme);
     }
 
-    void Resolver::visit(const gcpp::deferred_ptr<const Assign_expr>& expr) {
-        expr->value->accept(expr->value, *this);
-        resolve_local(expr, expr->name.lexeme);
+    void Resolver::visit(const Assign_expr* expr) {
+        expr->value->accept(*this);
+        resolve_local(expr->local, expr->name.lexeme);
     }
 
-    void Resolver::visit(const gcpp::deferred_ptr<const Function_stmt>& stmt) {
+    void Resolver::visit(const Function_stmt* stmt) {
         if (!scopes_.empty()) {
             declare_var(*(stmt->expr->name)) = Var_binding::defined;
         }
@@ -107,23 +98,23 @@ namespace motts { namespace lox {
         resolve_function(stmt->expr, Function_type::function);
     }
 
-    void Resolver::visit(const gcpp::deferred_ptr<const Expr_stmt>& stmt) {
-        stmt->expr->accept(stmt->expr, *this);
+    void Resolver::visit(const Expr_stmt* stmt) {
+        stmt->expr->accept(*this);
     }
 
-    void Resolver::visit(const gcpp::deferred_ptr<const If_stmt>& stmt) {
-        stmt->condition->accept(stmt->condition, *this);
-        stmt->then_branch->accept(stmt->then_branch, *this);
+    void Resolver::visit(const If_stmt* stmt) {
+        stmt->condition->accept(*this);
+        stmt->then_branch->accept(*this);
         if (stmt->else_branch) {
-            stmt->else_branch->accept(stmt->else_branch, *this);
+            stmt->else_branch->accept(*this);
         }
     }
 
-    void Resolver::visit(const gcpp::deferred_ptr<const Print_stmt>& stmt) {
-        stmt->expr->accept(stmt->expr, *this);
+    void Resolver::visit(const Print_stmt* stmt) {
+        stmt->expr->accept(*this);
     }
 
-    void Resolver::visit(const gcpp::deferred_ptr<const Return_stmt>& stmt) {
+    void Resolver::visit(const Return_stmt* stmt) {
         if (current_function_type_ == Function_type::none) {
             throw Resolver_error{"Cannot return from top-level code.", stmt->keyword};
         }
@@ -133,47 +124,67 @@ namespace motts { namespace lox {
                 throw Resolver_error{"Cannot return a value from an initializer.", stmt->keyword};
             }
 
-            stmt->value->accept(stmt->value, *this);
+            stmt->value->accept(*this);
         }
     }
 
-    void Resolver::visit(const gcpp::deferred_ptr<const While_stmt>& stmt) {
-        stmt->condition->accept(stmt->condition, *this);
-        stmt->body->accept(stmt->body, *this);
+    void Resolver::visit(const While_stmt* stmt) {
+        stmt->condition->accept(*this);
+
+        const auto enclosing_in_loop = in_loop_;
+        in_loop_ = true;
+        const auto _ = finally([&] () {
+            in_loop_ = enclosing_in_loop;
+        });
+        stmt->body->accept(*this);
     }
 
-    void Resolver::visit(const gcpp::deferred_ptr<const For_stmt>& stmt) {
-        stmt->condition->accept(stmt->condition, *this);
-        stmt->increment->accept(stmt->increment, *this);
-        stmt->body->accept(stmt->body, *this);
+    void Resolver::visit(const For_stmt* stmt) {
+        stmt->condition->accept(*this);
+        stmt->increment->accept(*this);
+
+        const auto enclosing_in_loop = in_loop_;
+        in_loop_ = true;
+        const auto _ = finally([&] () {
+            in_loop_ = enclosing_in_loop;
+        });
+        stmt->body->accept(*this);
     }
 
-    void Resolver::visit(const gcpp::deferred_ptr<const Break_stmt>& /*stmt*/) {}
+    void Resolver::visit(const Break_stmt* stmt) {
+        if (!in_loop_) {
+            throw Resolver_error{"Cannot break outside of a loop.", stmt->keyword};
+        }
+    }
 
-    void Resolver::visit(const gcpp::deferred_ptr<const Continue_stmt>& /*stmt*/) {}
+    void Resolver::visit(const Continue_stmt* stmt) {
+        if (!in_loop_) {
+            throw Resolver_error{"Cannot continue outside of a loop.", stmt->keyword};
+        }
+    }
 
-    void Resolver::visit(const gcpp::deferred_ptr<const Binary_expr>& expr) {
-        expr->left->accept(expr->left, *this);
-        expr->right->accept(expr->right, *this);
+    void Resolver::visit(const Binary_expr* expr) {
+        expr->left->accept(*this);
+        expr->right->accept(*this);
     }
 
-    void Resolver::visit(const gcpp::deferred_ptr<const Call_expr>& expr) {
-        expr->callee->accept(expr->callee, *this);
+    void Resolver::visit(const Call_expr* expr) {
+        expr->callee->accept(*this);
         for (const auto& argument : expr->arguments) {
-            argument->accept(argument, *this);
+            argument->accept(*this);
         }
     }
 
-    void Resolver::visit(const gcpp::deferred_ptr<const Get_expr>& expr) {
-        expr->object->accept(expr->object, *this);
+    void Resolver::visit(const Get_expr* expr) {
+        expr->object->accept(*this);
     }
 
-    void Resolver::visit(const gcpp::deferred_ptr<const Set_expr>& expr) {
-        expr->value->accept(expr->value, *this);
-        expr->object->accept(expr->object, *this);
+    void Resolver::visit(const Set_expr* expr) {
+        expr->value->accept(*this);
+        expr->object->accept(*this);
     }
 
-    void Resolver::visit(const gcpp::deferred_ptr<const Super_expr>& expr) {
+    void Resolver::visit(const Super_expr* expr) {
         if (current_class_type_ == Class_type::none) {
             throw Resolver_error{"Cannot use 'super' outside of a class.", expr->keyword};
         }
@@ -181,77 +192,90 @@ namespace motts { namespace lox {
             throw Resolver_error{"Cannot use 'super' in a class with no superclass.", expr->keyword};
         }
 
-        resolve_local(expr, expr->keyword.lexeme);
+        resolve_local(expr->local, expr->keyword.lexeme);
     }
 
-    void Resolver::visit(const gcpp::deferred_ptr<const This_expr>& expr) {
+    void Resolver::visit(const This_expr* expr) {
         if (current_class_type_ == Class_type::none) {
             throw Resolver_error{"Cannot use 'this' outside of a class.", expr->keyword};
         }
 
-        resolve_local(expr, expr->keyword.lexeme);
+        resolve_local(expr->local, expr->keyword.lexeme);
     }
 
-    void Resolver::visit(const gcpp::deferred_ptr<const Function_expr>& expr) {
+    void Resolver::visit(const Function_expr* expr) {
         resolve_function(expr, Function_type::function);
     }
 
-    void Resolver::visit(const gcpp::deferred_ptr<const Grouping_expr>& expr) {
-        expr->expr->accept(expr->expr, *this);
+    void Resolver::visit(const Grouping_expr* expr) {
+        expr->expr->accept(*this);
     }
 
-    void Resolver::visit(const gcpp::deferred_ptr<const Literal_expr>&) {}
+    void Resolver::visit(const Literal_expr*) {}
 
-    void Resolver::visit(const gcpp::deferred_ptr<const Logical_expr>& expr) {
-        expr->left->accept(expr->left, *this);
-        expr->right->accept(expr->right, *this);
+    void Resolver::visit(const Logical_expr* expr) {
+        expr->left->accept(*this);
+        expr->right->accept(*this);
     }
 
-    void Resolver::visit(const gcpp::deferred_ptr<const Unary_expr>& expr) {
-        expr->right->accept(expr->right, *this);
+    void Resolver::visit(const Unary_expr* expr) {
+        expr->right->accept(*this);
     }
 
     Resolver::Var_binding& Resolver::declare_var(const Token& name) {
-        const auto found_in_scope = scopes_.back().find(name.lexeme);
-        if (found_in_scope != scopes_.back().cend()) {
+        auto& scope = scopes_.back();
+        const auto found_in_scope = scope.find(name.lexeme);
+        if (found_in_scope != scope.cend()) {
             throw Resolver_error{"Variable with this name already declared in this scope.", name};
         }
 
-        return scopes_.back()[name.lexeme] = Var_binding::declared;
+        const auto slot = narrow<int>(scope.size());
+        auto& local = scope[name.lexeme] = {Var_binding::declared, slot};
+
+        return local.binding;
     }
 
-    void Resolver::resolve_local(const deferred_ptr<const Expr>& expr, const string& name) {
+    void Resolver::resolve_local(Resolved_local& local, const string& name) {
         for (auto scope = scopes_.crbegin(); scope != scopes_.crend(); ++scope) {
             const auto found_in_scope = scope->find(name);
             if (found_in_scope != scope->cend()) {
-                interpreter_.resolve(expr.get(), narrow<int>(scope - scopes_.crbegin()));
+                local = {narrow<int>(scope - scopes_.crbegin()), found_in_scope->second.slot};
                 return;
             }
         }
 
         // Not found; assume it is global
+        local = {};
     }
 
-    void Resolver::resolve_function(const gcpp::deferred_ptr<const Function_expr>& expr, Function_type function_type) {
+    void Resolver::resolve_function(const Function_expr* expr, Function_type function_type) {
         scopes_.push_back({});
         const auto _ = finally([&] () {
             scopes_.pop_back();
         });
 
         const auto enclosing_function_type = current_function_type_;
+        const auto enclosing_in_loop = in_loop_;
         current_function_type_ = function_type;
+        in_loop_ = false;
         const auto _2 = finally([&] () {
             current_function_type_ = enclosing_function_type;
+            in_loop_ = enclosing_in_loop;
         });
 
-        if (function_type == Function_type::function && expr->name) {
-            declare_var(*(expr->name)) = Var_binding::defined;
+        // A method's `this` shares the method's own scope, so binding a method doesn't need an environment of its own
+        if (function_type == Function_type::function) {
+            if (expr->name) {
+                declare_var(*(expr->name)) = Var_binding::defined;
+            }
+        } else {
+            scopes_.back()["this"] = {Var_binding::defined, 0};
         }
         for (const auto& param : expr->parameters) {
             declare_var(param) = Var_binding::defined;
         }
         for (const auto& statement : expr->body) {
-            statement->accept(statement, *this);
+            statement->accept(*this);
         }
     }
 
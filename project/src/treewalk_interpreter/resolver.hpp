@@ -9,7 +9,6 @@
 #include "exception.hpp"
 #include "expression_impls.hpp"
 #include "expression_visitor.hpp"
-#include "interpreter.hpp"
 #include "statement_impls.hpp"
 #include "statement_visitor.hpp"
 #include "token.hpp"
@@ -17,49 +16,57 @@
 namespace motts { namespace lox {
     class Resolver : public Expr_visitor, public Stmt_visitor {
         public:
-            explicit Resolver(Interpreter&);
+            explicit Resolver();
 
-            void visit(const gcpp::deferred_ptr<const Block_stmt>&) override;
-            void visit(const gcpp::deferred_ptr<const Class_stmt>&) override;
-            void visit(const gcpp::deferred_ptr<const Var_stmt>&) override;
-            void visit(const gcpp::deferred_ptr<const Var_expr>&) override;
-            void visit(const gcpp::deferred_ptr<const Assign_expr>&) override;
-            void visit(const gcpp::deferred_ptr<const Function_stmt>&) override;
-            void visit(const gcpp::deferred_ptr<const Expr_stmt>&) override;
-            void visit(const gcpp::deferred_ptr<const If_stmt>&) override;
-            void visit(const gcpp::deferred_ptr<const Print_stmt>&) override;
-            void visit(const gcpp::deferred_ptr<const Return_stmt>&) override;
-            void visit(const gcpp::deferred_ptr<const While_stmt>&) override;
-            void visit(const gcpp::deferred_ptr<const For_stmt>&) override;
-            void visit(const gcpp::deferred_ptr<const Break_stmt>&) override;
-            void visit(const gcpp::deferred_ptr<const Continue_stmt>&) override;
-            void visit(const gcpp::deferred_ptr<const Binary_expr>&) override;
-            void visit(const gcpp::deferred_ptr<const Call_expr>&) override;
-            void visit(const gcpp::deferred_ptr<const Get_expr>&) override;
-            void visit(const gcpp::deferred_ptr<const Set_expr>&) override;
-            void visit(const gcpp::deferred_ptr<const Super_expr>&) override;
-            void visit(const gcpp::deferred_ptr<const This_expr>&) override;
-            void visit(const gcpp::deferred_ptr<const Function_expr>&) override;
-            void visit(const gcpp::deferred_ptr<const Grouping_expr>&) override;
-            void visit(const gcpp::deferred_ptr<const Literal_expr>&) override;
-            void visit(const gcpp::deferred_ptr<const Logical_expr>&) override;
-            void visit(const gcpp::deferred_ptr<const Unary_expr>&) override;
+            void visit(const Block_stmt*) override;
+            void visit(const Class_stmt*) override;
+            void visit(const Var_stmt*) override;
+            void visit(const Var_expr*) override;
+            void visit(const Assign_expr*) override;
+            void visit(const Function_stmt*) override;
+            void visit(const Expr_stmt*) override;
+            void visit(const If_stmt*) override;
+            void visit(const Print_stmt*) override;
+            void visit(const Return_stmt*) override;
+            void visit(const While_stmt*) override;
+            void visit(const For_stmt*) override;
+            void visit(const Break_stmt*) override;
+            void visit(const Continue_stmt*) override;
+            void visit(const Binary_expr*) override;
+            void visit(const Call_expr*) override;
+            void visit(const Get_expr*) override;
+            void visit(const Set_expr*) override;
+            void visit(const Super_expr*) override;
+            void visit(const This_expr*) override;
+            void visit(const Function_expr*) override;
+            void visit(const Grouping_expr*) override;
+            void visit(const Literal_expr*) override;
+            void visit(const Logical_expr*) override;
+            void visit(const Unary_expr*) override;
 
         private:
             enum class Var_binding { declared, defined };
             enum class Function_type { none, function, initializer, method };
             enum class Class_type { none, class_, subclass };
 
-            using Scope = std::unordered_map<std::string, Var_binding>;
+            // Each local is numbered by the order it was declared in its scope, which is the slot the interpreter
+            // will define it in
+            struct Local {
+                Var_binding binding;
+                int slot;
+            };
+            using Scope = std::unordered_map<std::string, Local>;
             std::vector<Scope> scopes_;
 
             Function_type current_function_type_ {Function_type::none};
             Class_type current_class_type_ {Class_type::none};
-            Interpreter& interpreter_;
+
+            // Reset by each function, since break and continue can't reach a loop outside the function they're in
+            bool in_loop_ {false};
 
             Var_binding& declare_var(const Token& name);
-            void resolve_function(const gcpp::deferred_ptr<const Function_expr>&, Function_type);
-            void resolve_local(const gcpp::deferred_ptr<const Expr>&, const std::string& name);
+            void resolve_function(const Function_expr*, Function_type);
+            void resolve_local(Resolved_local&, const std::string& name);
     };
 
     struct Resolver_error : Runtime_error {
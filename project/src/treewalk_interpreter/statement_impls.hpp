@@ -9,99 +9,103 @@
 
 namespace motts { namespace lox {
     struct Expr_stmt : Stmt {
-        gcpp::deferred_ptr<const Expr> expr;
+        const Expr* expr;
 
-        explicit Expr_stmt(gcpp::deferred_ptr<const Expr>&& expr);
-        void accept(const gcpp::deferred_ptr<const Stmt>& owner_this, Stmt_visitor&) const override;
+        explicit Expr_stmt(const Expr* expr);
+        void accept(Stmt_visitor&) const override;
     };
 
     struct Print_stmt : Stmt {
-        gcpp::deferred_ptr<const Expr> expr;
+        const Expr* expr;
 
-        explicit Print_stmt(gcpp::deferred_ptr<const Expr>&& expr);
-        void accept(const gcpp::deferred_ptr<const Stmt>& owner_this, Stmt_visitor&) const override;
+        explicit Print_stmt(const Expr* expr);
+        void accept(Stmt_visitor&) const override;
     };
 
     struct Var_stmt : Stmt {
         Token name;
-        gcpp::deferred_ptr<const Expr> initializer;
+        const Expr* initializer;
 
-        explicit Var_stmt(Token&& name, gcpp::deferred_ptr<const Expr>&& initializer);
-        void accept(const gcpp::deferred_ptr<const Stmt>& owner_this, Stmt_visitor&) const override;
+        explicit Var_stmt(Token&& name, const Expr* initializer);
+        void accept(Stmt_visitor&) const override;
     };
 
     struct While_stmt : Stmt {
-        gcpp::deferred_ptr<const Expr> condition;
-        gcpp::deferred_ptr<const Stmt> body;
+        const Expr* condition;
+        const Stmt* body;
 
-        explicit While_stmt(gcpp::deferred_ptr<const Expr>&& condition, gcpp::deferred_ptr<const Stmt>&& body);
-        void accept(const gcpp::deferred_ptr<const Stmt>& owner_this, Stmt_visitor&) const override;
+        explicit While_stmt(const Expr* condition, const Stmt* body);
+        void accept(Stmt_visitor&) const override;
     };
 
     struct For_stmt : Stmt {
-        gcpp::deferred_ptr<const Expr> condition;
-        gcpp::deferred_ptr<const Expr> increment;
-        gcpp::deferred_ptr<const Stmt> body;
+        const Expr* condition;
+        const Expr* increment;
+        const Stmt* body;
 
-        explicit For_stmt(gcpp::deferred_ptr<const Expr>&& condition, gcpp::deferred_ptr<const Expr>&& increment, gcpp::deferred_ptr<const Stmt>&& body);
-        void accept(const gcpp::deferred_ptr<const Stmt>& owner_this, Stmt_visitor&) const override;
+        explicit For_stmt(const Expr* condition, const Expr* increment, const Stmt* body);
+        void accept(Stmt_visitor&) const override;
     };
 
     struct Block_stmt : Stmt {
-        std::vector<gcpp::deferred_ptr<const Stmt>> statements;
+        std::vector<const Stmt*> statements;
 
-        explicit Block_stmt(std::vector<gcpp::deferred_ptr<const Stmt>>&& statements);
-        void accept(const gcpp::deferred_ptr<const Stmt>& owner_this, Stmt_visitor&) const override;
+        explicit Block_stmt(std::vector<const Stmt*>&& statements);
+        void accept(Stmt_visitor&) const override;
     };
 
     struct If_stmt : Stmt {
-        gcpp::deferred_ptr<const Expr> condition;
-        gcpp::deferred_ptr<const Stmt> then_branch;
-        gcpp::deferred_ptr<const Stmt> else_branch;
+        const Expr* condition;
+        const Stmt* then_branch;
+        const Stmt* else_branch;
 
         explicit If_stmt(
-            gcpp::deferred_ptr<const Expr>&& condition,
-            gcpp::deferred_ptr<const Stmt>&& then_branch,
-            gcpp::deferred_ptr<const Stmt>&& else_branch
+            const Expr* condition,
+            const Stmt* then_branch,
+            const Stmt* else_branch
         );
-        void accept(const gcpp::deferred_ptr<const Stmt>& owner_this, Stmt_visitor&) const override;
+        void accept(Stmt_visitor&) const override;
     };
 
     struct Function_stmt : Stmt {
-        gcpp::deferred_ptr<const Function_expr> expr;
+        const Function_expr* expr;
 
-        explicit Function_stmt(gcpp::deferred_ptr<const Function_expr>&& expr);
-        void accept(const gcpp::deferred_ptr<const Stmt>& owner_this, Stmt_visitor&) const override;
+        explicit Function_stmt(const Function_expr* expr);
+        void accept(Stmt_visitor&) const override;
     };
 
     struct Return_stmt : Stmt {
         Token keyword;
-        gcpp::deferred_ptr<const Expr> value;
+        const Expr* value;
 
-        explicit Return_stmt(Token&& keyword, gcpp::deferred_ptr<const Expr>&& value);
-        void accept(const gcpp::deferred_ptr<const Stmt>& owner_this, Stmt_visitor&) const override;
+        explicit Return_stmt(Token&& keyword, const Expr* value);
+        void accept(Stmt_visitor&) const override;
     };
 
     struct Class_stmt : Stmt {
         Token name;
-        gcpp::deferred_ptr<const Var_expr> superclass;
-        std::vector<gcpp::deferred_ptr<const Function_stmt>> methods;
+        const Var_expr* superclass;
+        std::vector<const Function_stmt*> methods;
 
         explicit Class_stmt(
             Token&& name,
-            gcpp::deferred_ptr<const Var_expr>&& superclass,
-            std::vector<gcpp::deferred_ptr<const Function_stmt>>&& methods
+            const Var_expr* superclass,
+            std::vector<const Function_stmt*>&& methods
         );
-        void accept(const gcpp::deferred_ptr<const Stmt>& owner_this, Stmt_visitor&) const override;
+        void accept(Stmt_visitor&) const override;
     };
 
     struct Break_stmt : Stmt {
-        explicit Break_stmt();
-        void accept(const gcpp::deferred_ptr<const Stmt>& owner_this, Stmt_visitor&) const override;
+        Token keyword;
+
+        explicit Break_stmt(Token&& keyword);
+        void accept(Stmt_visitor&) const override;
     };
 
     struct Continue_stmt : Stmt {
-        explicit Continue_stmt();
-        void accept(const gcpp::deferred_ptr<const Stmt>& owner_this, Stmt_visitor&) const override;
+        Token keyword;
+
+        explicit Continue_stmt(Token&& keyword);
+        void accept(Stmt_visitor&) const override;
     };
 }}
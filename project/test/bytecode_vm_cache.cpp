@@ -0,0 +1,214 @@
+#define BOOST_TEST_MODULE CppLox Bytecode VM Cache Test
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <string>
+
+#include <boost/filesystem.hpp>
+#include <boost/test/unit_test.hpp>
+
+#include "bytecode_cache.hpp"
+#include "compiler.hpp"
+#include "heap.hpp"
+#include "object.hpp"
+#include "vm.hpp"
+
+using std::equal;
+using std::ifstream;
+using std::istreambuf_iterator;
+using std::ofstream;
+using std::ostringstream;
+using std::string;
+
+namespace filesystem = boost::filesystem;
+namespace loxns = motts::lox;
+
+// Not exported (internal linkage)
+namespace {
+    // Uses every kind of constant the cache stores, including functions nested in functions
+    const auto script_source =
+        "class Counter {\n"
+        "  init(name) { this.name = name; this.count = 0; }\n"
+        "  increment() { this.count = this.count + 1; return this; }\n"
+        "}\n"
+        "fun makeAdder(n) {\n"
+        "  fun add(x) { return x + n; }\n"
+        "  return add;\n"
+        "}\n"
+        "var counter = Counter(\"counter\");\n"
+        "for (var i = 0; i < 3; i = i + 1) { counter.increment(); }\n"
+        "print counter.name + \" \" + \"counted\";\n"
+        "print makeAdder(counter.count)(1 + 2);\n";
+
+    const auto script_output = "counter counted\n6\n";
+
+    // A cache file in its own temporary directory, which is removed along with it
+    struct Temp_cache {
+        explicit Temp_cache() :
+            directory {filesystem::temp_directory_path() / filesystem::unique_path()},
+            path {(directory / "script.loxc").string()}
+        {
+            filesystem::create_directory(directory);
+        }
+
+        ~Temp_cache() {
+            filesystem::remove_all(directory);
+        }
+
+        Temp_cache(const Temp_cache&) = delete;
+        Temp_cache& operator=(const Temp_cache&) = delete;
+
+        string read() const {
+            ifstream in {path, ifstream::binary};
+            return string{istreambuf_iterator<char>{in}, istreambuf_iterator<char>{}};
+        }
+
+        void write(const string& contents) const {
+            ofstream out {path, ofstream::binary | ofstream::trunc};
+            out << contents;
+        }
+
+        filesystem::path directory;
+        string path;
+    };
+
+    void save(const Temp_cache& cache, const string& source) {
+        loxns::Heap heap;
+        loxns::save_script_cache(cache.path, source, *loxns::compile(source, heap));
+    }
+
+    bool loads(const Temp_cache& cache, const string& source) {
+        loxns::Heap heap;
+        return loxns::load_script_cache(cache.path, source, heap) != nullptr;
+    }
+
+    // Whether the two functions, and every function in their constants, have the same code, lines, and constants
+    bool same_function(const loxns::Obj_function& expected, const loxns::Obj_function& actual) {
+        const auto expected_code = expected.chunk.bytecode();
+        const auto actual_code = actual.chunk.bytecode();
+        if (
+            expected.arity != actual.arity ||
+            expected.upvalue_count != actual.upvalue_count ||
+            (expected.name ? expected.name->str : "") != (actual.name ? actual.name->str : "") ||
+            !equal(expected_code.begin(), expected_code.end(), actual_code.begin(), actual_code.end()) ||
+            expected.chunk.lines.size() != actual.chunk.lines.size() ||
+            expected.chunk.constants.size() != actual.chunk.constants.size() ||
+            expected.chunk.property_caches.size() != actual.chunk.property_caches.size()
+        ) {
+            return false;
+        }
+
+        for (decltype(expected.chunk.lines.size()) i = 0; i != expected.chunk.lines.size(); ++i) {
+            if (
+                expected.chunk.lines[i].offset != actual.chunk.lines[i].offset ||
+                expected.chunk.lines[i].line != actual.chunk.lines[i].line
+            ) {
+                return false;
+            }
+        }
+
+        for (decltype(expected.chunk.constants.size()) i = 0; i != expected.chunk.constants.size(); ++i) {
+            const auto expected_constant = expected.chunk.constants[i];
+            const auto actual_constant = actual.chunk.constants[i];
+
+            if (loxns::is_obj_type(expected_constant, loxns::Obj_type::function)) {
+                if (
+                    !loxns::is_obj_type(actual_constant, loxns::Obj_type::function) ||
+                    !same_function(*loxns::as_function(expected_constant), *loxns::as_function(actual_constant))
+                ) {
+                    return false;
+                }
+            } else if (loxns::is_string(expected_constant)) {
+                if (
+                    !loxns::is_string(actual_constant) ||
+                    loxns::as_string(expected_constant)->str != loxns::as_string(actual_constant)->str
+                ) {
+                    return false;
+                }
+            } else if (expected_constant != actual_constant) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+}
+
+BOOST_AUTO_TEST_CASE(round_trip_test) {
+    Temp_cache cache;
+    loxns::Heap heap;
+    const auto compiled = loxns::compile(script_source, heap);
+    loxns::save_script_cache(cache.path, script_source, *compiled);
+
+    const auto loaded = loxns::load_script_cache(cache.path, script_source, heap);
+
+    BOOST_TEST_REQUIRE(static_cast<bool>(loaded));
+    BOOST_TEST(same_function(*compiled, *loaded->script));
+}
+
+BOOST_AUTO_TEST_CASE(round_trip_runs_the_same_test) {
+    Temp_cache cache;
+
+    // The first run compiles and writes the cache, and the second runs what it loads from the cache
+    for (auto run = 0; run != 2; ++run) {
+        ostringstream out;
+        loxns::VM vm {out};
+        vm.interpret(script_source, cache.path);
+
+        BOOST_TEST(out.str() == script_output);
+        BOOST_TEST(loads(cache, script_source));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(miss_after_source_edit_test) {
+    Temp_cache cache;
+    save(cache, script_source);
+
+    const auto edited_source = string{script_source} + "print \"edited\";\n";
+    BOOST_TEST(!loads(cache, edited_source));
+
+    // Same length, different text
+    auto same_length_source = string{script_source};
+    same_length_source.replace(same_length_source.find("counted"), 7, "tallied");
+    BOOST_TEST(!loads(cache, same_length_source));
+
+    ostringstream out;
+    loxns::VM vm {out};
+    vm.interpret(same_length_source, cache.path);
+    BOOST_TEST(out.str() == "counter tallied\n6\n");
+}
+
+BOOST_AUTO_TEST_CASE(miss_when_truncated_test) {
+    Temp_cache cache;
+    save(cache, script_source);
+    const auto contents = cache.read();
+    BOOST_TEST_REQUIRE(loads(cache, script_source));
+
+    for (const auto length : {string::size_type{0}, string::size_type{4}, contents.size() / 2, contents.size() - 1}) {
+        cache.write(contents.substr(0, length));
+        BOOST_TEST(!loads(cache, script_source), "a cache truncated to " << length << " bytes loaded");
+    }
+}
+
+BOOST_AUTO_TEST_CASE(miss_when_corrupted_test) {
+    Temp_cache cache;
+    save(cache, script_source);
+    const auto contents = cache.read();
+
+    // The magic number at the start, and bytes in the payload, which is most of the file
+    for (const auto offset : {string::size_type{0}, contents.size() / 2, contents.size() - 1}) {
+        auto corrupted = contents;
+        corrupted[offset] = static_cast<char>(corrupted[offset] ^ 0xff);
+        cache.write(corrupted);
+
+        BOOST_TEST(!loads(cache, script_source), "a cache corrupted at byte " << offset << " loaded");
+    }
+
+    // And it still runs, from source
+    ostringstream out;
+    loxns::VM vm {out};
+    vm.interpret(script_source, cache.path);
+    BOOST_TEST(out.str() == script_output);
+}
@@ -0,0 +1,162 @@
+#define BOOST_TEST_MODULE CppLox Bytecode VM Embedding Test
+
+#include <algorithm>
+#include <cstddef>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+#include "vm.hpp"
+
+using std::max;
+using std::ostringstream;
+using std::size_t;
+using std::string;
+using std::vector;
+
+namespace loxns = motts::lox;
+
+// Not exported (internal linkage)
+namespace {
+    auto error_is(const string& expected_what) {
+        return [expected_what] (const loxns::VM_error& error) {
+            return error.what() == expected_what;
+        };
+    }
+
+    // Defines `leaked` only on the first run. A later run that can still see it would print it.
+    const auto leaky_script =
+        "if (firstRun()) {\n"
+        "  print \"defining\";\n"
+        "} else {\n"
+        "  print leaked;\n"
+        "}\n"
+        "var leaked = \"leaked\";\n";
+}
+
+BOOST_AUTO_TEST_CASE(program_executes_more_than_once_test) {
+    ostringstream out;
+    loxns::VM vm {out};
+
+    const auto program = vm.compile("print \"run\";");
+    vm.execute(program);
+    vm.execute(program);
+
+    BOOST_TEST(out.str() == "run\nrun\n");
+}
+
+BOOST_AUTO_TEST_CASE(program_globals_dont_leak_test) {
+    ostringstream out;
+    loxns::VM vm {out};
+    auto first_run = true;
+    vm.define_native("firstRun", [&first_run] () {
+        const auto result = first_run;
+        first_run = false;
+        return result;
+    });
+
+    const auto program = vm.compile(leaky_script);
+    vm.execute(program);
+    BOOST_CHECK_EXCEPTION(vm.execute(program), loxns::VM_error, error_is("[Line 4] Error: Undefined variable 'leaked'"));
+
+    BOOST_TEST(out.str() == "defining\n");
+}
+
+BOOST_AUTO_TEST_CASE(program_natives_survive_reset_test) {
+    ostringstream out;
+    loxns::VM vm {out};
+    vm.define_native("answer", [] () { return 42.0; });
+
+    // The first run overwrites the native with a number, which a fresh start must undo
+    const auto program = vm.compile("var answer = answer(); print answer; print clock() > 0;");
+    vm.execute(program);
+    vm.execute(program);
+
+    BOOST_TEST(out.str() == "42\ntrue\n42\ntrue\n");
+}
+
+BOOST_AUTO_TEST_CASE(interpret_shares_globals_test) {
+    ostringstream out;
+    loxns::VM vm {out};
+
+    vm.interpret("var kept = \"kept\";");
+    vm.interpret("print kept;");
+
+    BOOST_TEST(out.str() == "kept\n");
+}
+
+BOOST_AUTO_TEST_CASE(typed_native_test) {
+    ostringstream out;
+    loxns::VM vm {out};
+    vm.define_native("repeat", [] (double count, const string& text) {
+        string repeated;
+        for (auto i = 0; i < count; ++i) {
+            repeated += text;
+        }
+
+        return repeated;
+    });
+    vector<double> recorded;
+    vm.define_native("record", [&recorded] (double value) {
+        recorded.push_back(value);
+    });
+
+    vm.interpret("print repeat(3, \"ab\"); print record(1); print record(2);");
+
+    BOOST_TEST(out.str() == "ababab\nnil\nnil\n");
+    BOOST_TEST(recorded == (vector<double>{1, 2}), boost::test_tools::per_element());
+}
+
+BOOST_AUTO_TEST_CASE(typed_native_arity_error_test) {
+    ostringstream out;
+    loxns::VM vm {out};
+    vm.define_native("record", [] (double) {});
+
+    BOOST_CHECK_EXCEPTION(
+        vm.interpret("record();"), loxns::VM_error, error_is("[Line 1] Error: Expected 1 arguments but got 0.")
+    );
+}
+
+BOOST_AUTO_TEST_CASE(typed_native_argument_type_error_test) {
+    ostringstream out;
+    loxns::VM vm {out};
+    vm.define_native("repeat", [] (double, const string& text) {
+        return text;
+    });
+
+    BOOST_CHECK_EXCEPTION(
+        vm.interpret("repeat(\"3\", \"ab\");"),
+        loxns::VM_error,
+        error_is("[Line 1] Error: Argument 1 must be a number.")
+    );
+    BOOST_CHECK_EXCEPTION(
+        vm.interpret("repeat(3, 4);"), loxns::VM_error, error_is("[Line 1] Error: Argument 2 must be a string.")
+    );
+}
+
+BOOST_AUTO_TEST_CASE(heap_stays_bounded_test) {
+    ostringstream out;
+    loxns::Gc_settings gc_settings;
+    gc_settings.first_gc_threshold = 64 * 1024;
+    loxns::VM vm {out, gc_settings};
+    size_t peak_bytes {};
+    vm.define_native("sampleHeap", [&vm, &peak_bytes] () {
+        peak_bytes = max(peak_bytes, vm.bytes_allocated());
+    });
+
+    // Every instance is garbage by the next iteration, and all of them together take many times the threshold
+    vm.interpret(
+        "class Garbage {}\n"
+        "for (var i = 0; i < 100000; i = i + 1) {\n"
+        "  var garbage = Garbage();\n"
+        "  garbage.value = i;\n"
+        "  sampleHeap();\n"
+        "}\n"
+    );
+
+    // What survives each collection is small, so the heap never gets far past the threshold before it's collected
+    BOOST_TEST(peak_bytes > 0u);
+    BOOST_TEST(peak_bytes <= 2 * gc_settings.first_gc_threshold);
+}
@@ -0,0 +1,209 @@
+#define BOOST_TEST_MODULE CppLox Bytecode VM Peephole Test
+
+#include <cstdint>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+#include "chunk.hpp"
+#include "peephole.hpp"
+
+using std::uint16_t;
+using std::uint8_t;
+using std::vector;
+
+namespace loxns = motts::lox;
+
+using loxns::Op_code;
+
+// Not exported (internal linkage)
+namespace {
+    // Builds a chunk by hand, the way the compiler would emit it, so each test controls exactly what the pass sees
+    struct Chunk_builder {
+        loxns::Chunk chunk;
+
+        Chunk_builder& emit(Op_code opcode) {
+            chunk.bytecode_push_back(opcode, 1);
+            return *this;
+        }
+
+        Chunk_builder& emit(Op_code opcode, int operand) {
+            chunk.bytecode_push_back(opcode, 1);
+            chunk.bytecode_push_back(operand, 1);
+            return *this;
+        }
+
+        Chunk_builder& emit_constant(double number) {
+            return emit(Op_code::constant, static_cast<int>(chunk.constants_push_back(loxns::Value{number})));
+        }
+
+        Chunk_builder& emit_jump(Op_code opcode, uint16_t jump_length) {
+            const auto offset = chunk.code.size();
+            chunk.bytecode_push_back(opcode, 1);
+            chunk.bytecode_push_back(0, 1);
+            chunk.bytecode_push_back(0, 1);
+            loxns::write_jump_operand(&chunk.code.at(offset + 1), jump_length);
+            return *this;
+        }
+    };
+
+    double constant_number_at(const loxns::Chunk& chunk, vector<uint8_t>::size_type offset) {
+        return chunk.constants.at(chunk.code.at(offset + 1)).as_number();
+    }
+}
+
+BOOST_AUTO_TEST_CASE(fold_test) {
+    // print (1 + 2) * 3;
+    auto chunk = Chunk_builder{}
+        .emit_constant(1).emit_constant(2).emit(Op_code::add)
+        .emit_constant(3).emit(Op_code::multiply)
+        .emit(Op_code::print).emit(Op_code::nil).emit(Op_code::return_)
+        .chunk;
+    BOOST_TEST(loxns::opcodes(chunk).size() == 8);
+
+    loxns::optimize_peephole(chunk);
+
+    const vector<Op_code> expected {Op_code::constant, Op_code::print, Op_code::nil, Op_code::return_};
+    BOOST_TEST((loxns::opcodes(chunk) == expected));
+    BOOST_TEST(constant_number_at(chunk, 0) == 9);
+}
+
+BOOST_AUTO_TEST_CASE(fold_negate_and_not_test) {
+    // print -5; print !true;
+    auto chunk = Chunk_builder{}
+        .emit_constant(5).emit(Op_code::negate).emit(Op_code::print)
+        .emit(Op_code::true_).emit(Op_code::not_).emit(Op_code::print)
+        .chunk;
+    BOOST_TEST(loxns::opcodes(chunk).size() == 6);
+
+    loxns::optimize_peephole(chunk);
+
+    const vector<Op_code> expected {Op_code::constant, Op_code::print, Op_code::false_, Op_code::print};
+    BOOST_TEST((loxns::opcodes(chunk) == expected));
+    BOOST_TEST(constant_number_at(chunk, 0) == -5);
+}
+
+BOOST_AUTO_TEST_CASE(not_fuses_with_comparison_test) {
+    // a != b; a >= b; a <= b;
+    auto chunk = Chunk_builder{}
+        .emit(Op_code::get_local, 1).emit(Op_code::get_local, 2).emit(Op_code::equal).emit(Op_code::not_)
+        .emit(Op_code::get_local, 1).emit(Op_code::get_local, 2).emit(Op_code::less).emit(Op_code::not_)
+        .emit(Op_code::get_local, 1).emit(Op_code::get_local, 2).emit(Op_code::greater).emit(Op_code::not_)
+        .chunk;
+    BOOST_TEST(loxns::opcodes(chunk).size() == 12);
+
+    loxns::optimize_peephole(chunk);
+
+    const vector<Op_code> expected {
+        Op_code::get_local, Op_code::get_local, Op_code::not_equal,
+        Op_code::get_local, Op_code::get_local, Op_code::greater_equal,
+        Op_code::get_local, Op_code::get_local, Op_code::less_equal
+    };
+    BOOST_TEST((loxns::opcodes(chunk) == expected));
+}
+
+BOOST_AUTO_TEST_CASE(add_constant_to_local_test) {
+    // i = i + 1;
+    auto chunk = Chunk_builder{}
+        .emit(Op_code::get_local, 1).emit_constant(1).emit(Op_code::add).emit(Op_code::set_local, 1).emit(Op_code::pop)
+        .chunk;
+    BOOST_TEST(loxns::opcodes(chunk).size() == 5);
+
+    loxns::optimize_peephole(chunk);
+
+    const vector<Op_code> expected {Op_code::add_constant_to_local, Op_code::pop};
+    BOOST_TEST((loxns::opcodes(chunk) == expected));
+    BOOST_TEST(chunk.code.at(1) == 1);
+    BOOST_TEST(chunk.constants.at(chunk.code.at(2)).as_number() == 1);
+}
+
+BOOST_AUTO_TEST_CASE(add_constant_to_other_local_test) {
+    // j = i + 1; reads one slot and writes another, which add_constant_to_local can't do
+    auto chunk = Chunk_builder{}
+        .emit(Op_code::get_local, 1).emit_constant(1).emit(Op_code::add).emit(Op_code::set_local, 2).emit(Op_code::pop)
+        .chunk;
+
+    loxns::optimize_peephole(chunk);
+
+    BOOST_TEST(loxns::opcodes(chunk).size() == 5);
+}
+
+BOOST_AUTO_TEST_CASE(jump_threading_test) {
+    // A jump to a jump whose destination is as far as a jump operand reaches. The first jump lands right after itself,
+    // on the second, which jumps over a run of nils to the return.
+    const uint16_t max_length {0xffff};
+    Chunk_builder builder;
+    builder.emit_jump(Op_code::jump, 0).emit_jump(Op_code::jump, max_length - 3);
+    for (auto i = 0; i != max_length - 3; ++i) {
+        builder.emit(Op_code::nil);
+    }
+    builder.emit(Op_code::return_);
+    auto& chunk = builder.chunk;
+    const auto instruction_count = loxns::opcodes(chunk).size();
+
+    loxns::optimize_peephole(chunk);
+
+    BOOST_TEST(loxns::opcodes(chunk).size() == instruction_count);
+    BOOST_TEST(loxns::read_jump_operand(&chunk.code.at(1)) == max_length);
+}
+
+BOOST_AUTO_TEST_CASE(jump_threading_past_operand_range_test) {
+    // As above, but one byte further, so the threaded jump wouldn't fit and has to stay as it was
+    const uint16_t max_length {0xffff};
+    Chunk_builder builder;
+    builder.emit_jump(Op_code::jump, 0).emit_jump(Op_code::jump, max_length - 2);
+    for (auto i = 0; i != max_length - 2; ++i) {
+        builder.emit(Op_code::nil);
+    }
+    builder.emit(Op_code::return_);
+    auto& chunk = builder.chunk;
+
+    loxns::optimize_peephole(chunk);
+
+    BOOST_TEST(loxns::read_jump_operand(&chunk.code.at(1)) == 0);
+    BOOST_TEST(loxns::read_jump_operand(&chunk.code.at(4)) == max_length - 2);
+}
+
+BOOST_AUTO_TEST_CASE(jump_if_false_threading_test) {
+    // A jump_if_false to a jump_if_false tests the same value, so it goes where the second one goes
+    auto chunk = Chunk_builder{}
+        .emit(Op_code::get_local, 1)
+        .emit_jump(Op_code::jump_if_false, 0)
+        .emit_jump(Op_code::jump_if_false, 1)
+        .emit(Op_code::nil).emit(Op_code::return_)
+        .chunk;
+
+    loxns::optimize_peephole(chunk);
+
+    BOOST_TEST(loxns::read_jump_operand(&chunk.code.at(3)) == 4);
+}
+
+BOOST_AUTO_TEST_CASE(no_combining_across_jump_target_test) {
+    // The jump lands on the second constant, so the add has to stay, since that's not always 1 + 2 at runtime
+    auto chunk = Chunk_builder{}
+        .emit_jump(Op_code::jump, 2)
+        .emit_constant(1).emit_constant(2).emit(Op_code::add).emit(Op_code::return_)
+        .chunk;
+    BOOST_TEST(loxns::opcodes(chunk).size() == 5);
+
+    loxns::optimize_peephole(chunk);
+
+    const vector<Op_code> expected {Op_code::jump, Op_code::constant, Op_code::constant, Op_code::add, Op_code::return_};
+    BOOST_TEST((loxns::opcodes(chunk) == expected));
+    BOOST_TEST(loxns::read_jump_operand(&chunk.code.at(1)) == 2);
+}
+
+BOOST_AUTO_TEST_CASE(combining_at_jump_target_test) {
+    // The jump lands on the first constant, which is where the folded constant starts, so folding is fine
+    auto chunk = Chunk_builder{}
+        .emit_jump(Op_code::jump, 0)
+        .emit_constant(1).emit_constant(2).emit(Op_code::add).emit(Op_code::return_)
+        .chunk;
+
+    loxns::optimize_peephole(chunk);
+
+    const vector<Op_code> expected {Op_code::jump, Op_code::constant, Op_code::return_};
+    BOOST_TEST((loxns::opcodes(chunk) == expected));
+    BOOST_TEST(loxns::read_jump_operand(&chunk.code.at(1)) == 0);
+    BOOST_TEST(constant_number_at(chunk, 3) == 3);
+}
@@ -4,8 +4,10 @@
 
 #include <iostream>
 #include <iterator>
+#include <algorithm>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include <boost/algorithm/string/replace.hpp>
 #include <boost/predef.h>
@@ -13,12 +15,14 @@
 #include <boost/program_options.hpp>
 #include <boost/test/unit_test.hpp>
 
+using std::count;
 using std::cout;
 using std::exit;
 using std::istreambuf_iterator;
 using std::make_unique;
 using std::string;
 using std::unique_ptr;
+using std::vector;
 
 namespace process = boost::process;
 namespace program_options = boost::program_options;
@@ -39,7 +43,16 @@ const auto& program_options_description() {
         options_description->add_options()
             ("help", "Print usage information and exit.")
             ("cpplox-file", program_options::value<string>(), "Required. File path to cpplox executable.")
-            ("test-scripts-path", program_options::value<string>(), "Required. Path to test scripts.");
+            ("test-scripts-path", program_options::value<string>(), "Required. Path to test scripts.")
+            (
+                "ignore-stderr",
+                "Compare only output and exit codes, for an interpreter whose error messages are worded differently."
+            )
+            (
+                "skip-script",
+                program_options::value<vector<string>>()->composing(),
+                "Script to skip, relative to the test scripts path. Can be given more than once."
+            );
     }
 
     return *options_description;
@@ -80,6 +93,14 @@ auto expect_script_file_out_to_be(
     const string& expected_err = "",
     int expected_exit_code = 0
 ) {
+    if (program_options_map().count("skip-script")) {
+        const auto& skipped_scripts = program_options_map().at("skip-script").as<vector<string>>();
+        if (count(skipped_scripts.cbegin(), skipped_scripts.cend(), script_file)) {
+            BOOST_TEST_MESSAGE("Skipped " + script_file);
+            return;
+        }
+    }
+
     process::ipstream cpplox_out;
     process::ipstream cpplox_err;
     const auto exit_code = process::system(
@@ -98,7 +119,9 @@ auto expect_script_file_out_to_be(
     }
 
     BOOST_TEST(actual_out == expected_out);
-    BOOST_TEST(actual_err == expected_err);
+    if (!program_options_map().count("ignore-stderr")) {
+        BOOST_TEST(actual_err == expected_err);
+    }
     BOOST_TEST(exit_code == expected_exit_code);
 }
 
@@ -122,6 +145,10 @@ BOOST_AUTO_TEST_CASE(block_scope_test) { expect_script_file_out_to_be("block/sco
 BOOST_AUTO_TEST_CASE(bool_equality_test) { expect_script_file_out_to_be("bool/equality.lox", "true\nfalse\nfalse\ntrue\n" "false\nfalse\nfalse\nfalse\nfalse\n" "false\ntrue\ntrue\nfalse\n" "true\ntrue\ntrue\ntrue\ntrue\n"); }
 BOOST_AUTO_TEST_CASE(bool_not_test) { expect_script_file_out_to_be("bool/not.lox", "false\ntrue\ntrue\n"); }
 
+BOOST_AUTO_TEST_CASE(break_in_function_in_loop_test) { expect_script_file_out_to_be("break/in_function_in_loop.lox", "", "[Line 3] Error at 'break': Cannot break outside of a loop.\n\n", EXIT_FAILURE); }
+BOOST_AUTO_TEST_CASE(break_nested_loops_test) { expect_script_file_out_to_be("break/nested_loops.lox", "0\n1\n2\nf\ndone\n"); }
+BOOST_AUTO_TEST_CASE(break_outside_loop_test) { expect_script_file_out_to_be("break/outside_loop.lox", "", "[Line 2] Error at 'break': Cannot break outside of a loop.\n\n", EXIT_FAILURE); }
+
 BOOST_AUTO_TEST_CASE(call_bool_test) { expect_script_file_out_to_be("call/bool.lox", "", "Can only call functions and classes.\n", EXIT_FAILURE); }
 BOOST_AUTO_TEST_CASE(call_nil_test) { expect_script_file_out_to_be("call/nil.lox", "", "Can only call functions and classes.\n", EXIT_FAILURE); }
 BOOST_AUTO_TEST_CASE(call_num_test) { expect_script_file_out_to_be("call/num.lox", "", "Can only call functions and classes.\n", EXIT_FAILURE); }
@@ -163,6 +190,10 @@ BOOST_AUTO_TEST_CASE(constructor_missing_arguments_test) { expect_script_file_ou
 BOOST_AUTO_TEST_CASE(constructor_return_in_nested_function_test) { expect_script_file_out_to_be("constructor/return_in_nested_function.lox", "bar\nFoo instance\n"); }
 BOOST_AUTO_TEST_CASE(constructor_return_value_test) { expect_script_file_out_to_be("constructor/return_value.lox", "", "[Line 3] Error at 'return': Cannot return a value from an initializer.\n\n", EXIT_FAILURE); }
 
+BOOST_AUTO_TEST_CASE(continue_in_function_in_loop_test) { expect_script_file_out_to_be("continue/in_function_in_loop.lox", "", "[Line 3] Error at 'continue': Cannot continue outside of a loop.\n\n", EXIT_FAILURE); }
+BOOST_AUTO_TEST_CASE(continue_nested_loops_test) { expect_script_file_out_to_be("continue/nested_loops.lox", "6\n4\n11\n13\n21\n23\n"); }
+BOOST_AUTO_TEST_CASE(continue_outside_loop_test) { expect_script_file_out_to_be("continue/outside_loop.lox", "", "[Line 2] Error at 'continue': Cannot continue outside of a loop.\n\n", EXIT_FAILURE); }
+
 BOOST_AUTO_TEST_CASE(field_call_function_field_test) { expect_script_file_out_to_be("field/call_function_field.lox", "bar\n"); }
 BOOST_AUTO_TEST_CASE(field_call_nonfunction_field_test) { expect_script_file_out_to_be("field/call_nonfunction_field.lox", "", "Can only call functions and classes.\n", EXIT_FAILURE); }
 BOOST_AUTO_TEST_CASE(field_get_and_set_method_test) { expect_script_file_out_to_be("field/get_and_set_method.lox", "other\nmethod\n"); }
@@ -254,6 +285,7 @@ BOOST_AUTO_TEST_CASE(field_many_test) { expect_script_file_out_to_be(
     "watermelon\n"
     "yuzu\n"
 ); }
+BOOST_AUTO_TEST_CASE(field_many_shapes_test) { expect_script_file_out_to_be("field/many_shapes.lox", "16\n26\n36\n" "16\n16\n16\n16\n16\n16\n16\n16\n16\n16\n16\n16\n" "tagged\n"); }
 BOOST_AUTO_TEST_CASE(field_method_test) { expect_script_file_out_to_be("field/method.lox", "got method\narg\n"); }
 BOOST_AUTO_TEST_CASE(field_method_binds_this_test) { expect_script_file_out_to_be("field/method_binds_this.lox", "foo1\n"); }
 BOOST_AUTO_TEST_CASE(field_on_instance_test) { expect_script_file_out_to_be("field/on_instance.lox", "bar value\nbaz value\nbar value\nbaz value\n"); }
@@ -264,6 +296,7 @@ BOOST_AUTO_TEST_CASE(field_set_on_function_test) { expect_script_file_out_to_be(
 BOOST_AUTO_TEST_CASE(field_set_on_nil_test) { expect_script_file_out_to_be("field/set_on_nil.lox", "", "[Line 1] Error at 'foo': Only instances have fields.\n", EXIT_FAILURE); }
 BOOST_AUTO_TEST_CASE(field_set_on_num_test) { expect_script_file_out_to_be("field/set_on_num.lox", "", "[Line 1] Error at 'foo': Only instances have fields.\n", EXIT_FAILURE); }
 BOOST_AUTO_TEST_CASE(field_set_on_string_test) { expect_script_file_out_to_be("field/set_on_string.lox", "", "[Line 1] Error at 'foo': Only instances have fields.\n", EXIT_FAILURE); }
+BOOST_AUTO_TEST_CASE(field_shadows_method_test) { expect_script_file_out_to_be("field/shadows_method.lox", "method\nmethod\nfield\nfield\nmethod\nfield\n"); }
 BOOST_AUTO_TEST_CASE(field_undefined_test) { expect_script_file_out_to_be("field/undefined.lox", "", "Undefined property 'bar'.\n", EXIT_FAILURE); }
 
 BOOST_AUTO_TEST_CASE(for_break_continue_test) { expect_script_file_out_to_be("for/break_continue.lox", "0\n0\n2\n"); }
@@ -305,10 +338,14 @@ BOOST_AUTO_TEST_CASE(if_truth_test) { expect_script_file_out_to_be("if/truth.lox
 BOOST_AUTO_TEST_CASE(if_var_in_else_test) { expect_script_file_out_to_be("if/var_in_else.lox", "", "[Line 2] Error at 'var': Expected expression.\n\n", EXIT_FAILURE); }
 BOOST_AUTO_TEST_CASE(if_var_in_then_test) { expect_script_file_out_to_be("if/var_in_then.lox", "", "[Line 2] Error at 'var': Expected expression.\n\n", EXIT_FAILURE); }
 
+BOOST_AUTO_TEST_CASE(inheritance_constructor_test) { expect_script_file_out_to_be("inheritance/constructor.lox", "value\n"); }
+BOOST_AUTO_TEST_CASE(inheritance_constructor_extra_arguments_test) { expect_script_file_out_to_be("inheritance/constructor_extra_arguments.lox", "", "[Line 7] Error at ')': Expected 1 arguments but got 2.\n", EXIT_FAILURE); }
+BOOST_AUTO_TEST_CASE(inheritance_constructor_missing_arguments_test) { expect_script_file_out_to_be("inheritance/constructor_missing_arguments.lox", "", "[Line 7] Error at ')': Expected 2 arguments but got 1.\n", EXIT_FAILURE); }
 BOOST_AUTO_TEST_CASE(inheritance_inherit_from_function_test) { expect_script_file_out_to_be("inheritance/inherit_from_function.lox", "", "[Line 3] Error at 'foo': Superclass must be a class.\n", EXIT_FAILURE); }
 BOOST_AUTO_TEST_CASE(inheritance_inherit_from_nil_test) { expect_script_file_out_to_be("inheritance/inherit_from_nil.lox", "", "[Line 2] Error at 'Nil': Superclass must be a class.\n", EXIT_FAILURE); }
 BOOST_AUTO_TEST_CASE(inheritance_inherit_from_number_test) { expect_script_file_out_to_be("inheritance/inherit_from_number.lox", "", "[Line 2] Error at 'Number': Superclass must be a class.\n", EXIT_FAILURE); }
 BOOST_AUTO_TEST_CASE(inheritance_inherit_methods_test) { expect_script_file_out_to_be("inheritance/inherit_methods.lox", "foo\nbar\nbar\n"); }
+BOOST_AUTO_TEST_CASE(inheritance_inherited_method_cache_test) { expect_script_file_out_to_be("inheritance/inherited_method_cache.lox", "I am base\nI am derived\nI am derived\nI am base\nI am derived\nI am derived\nI am derived\n"); }
 BOOST_AUTO_TEST_CASE(inheritance_parenthesized_superclass_test) { expect_script_file_out_to_be("inheritance/parenthesized_superclass.lox", "", "[Line 4] Error at '(': Expected superclass name.\n\n", EXIT_FAILURE); }
 BOOST_AUTO_TEST_CASE(inheritance_set_fields_from_base_class_test) { expect_script_file_out_to_be("inheritance/set_fields_from_base_class.lox", "foo 1\nfoo 2\nbar 1\nbar 2\nbar 1\nbar 2\n"); }
 
@@ -320,12 +357,18 @@ BOOST_AUTO_TEST_CASE(logical_operator_or_truth_test) { expect_script_file_out_to
 BOOST_AUTO_TEST_CASE(method_arity_test) { expect_script_file_out_to_be("method/arity.lox", "no args\n1\n3\n6\n10\n15\n21\n28\n36\n"); }
 BOOST_AUTO_TEST_CASE(method_empty_block_test) { expect_script_file_out_to_be("method/empty_block.lox", "nil\n"); }
 BOOST_AUTO_TEST_CASE(method_extra_arguments_test) { expect_script_file_out_to_be("method/extra_arguments.lox", "", "[Line 8] Error at ')': Expected 2 arguments but got 4.\n", EXIT_FAILURE); }
+BOOST_AUTO_TEST_CASE(method_invoke_field_closure_test) { expect_script_file_out_to_be("method/invoke_field_closure.lox", "1\n3\n13\n100\n23\n200\n"); }
+BOOST_AUTO_TEST_CASE(method_many_shapes_recursive_call_test) { expect_script_file_out_to_be("method/many_shapes_recursive_call.lox", "abcdef\nabcdef\n"); }
 BOOST_AUTO_TEST_CASE(method_missing_arguments_test) { expect_script_file_out_to_be("method/missing_arguments.lox", "", "[Line 5] Error at ')': Expected 2 arguments but got 1.\n", EXIT_FAILURE); }
 BOOST_AUTO_TEST_CASE(method_not_found_test) { expect_script_file_out_to_be("method/not_found.lox", "", "Undefined property 'unknown'.\n", EXIT_FAILURE); }
 BOOST_AUTO_TEST_CASE(method_refer_to_name_test) { expect_script_file_out_to_be("method/refer_to_name.lox", "", "Undefined variable 'method'.\n", EXIT_FAILURE); }
 BOOST_AUTO_TEST_CASE(method_too_many_arguments_test) { expect_script_file_out_to_be("method/too_many_arguments.lox", "", "[Line 1] Error at ')': Cannot have more than 8 arguments.\n\n", EXIT_FAILURE); }
 BOOST_AUTO_TEST_CASE(method_too_many_parameters_test) { expect_script_file_out_to_be("method/too_many_parameters.lox", "", "[Line 3] Error at ')': Cannot have more than 8 parameters.\n\n", EXIT_FAILURE); }
 
+BOOST_AUTO_TEST_CASE(native_clock_test) { expect_script_file_out_to_be("native/clock.lox", "true\ntrue\ntrue\n"); }
+BOOST_AUTO_TEST_CASE(native_cpu_time_test) { expect_script_file_out_to_be("native/cpu_time.lox", "true\ntrue\n"); }
+BOOST_AUTO_TEST_CASE(native_nano_time_test) { expect_script_file_out_to_be("native/nano_time.lox", "true\ntrue\ntrue\n"); }
+
 BOOST_AUTO_TEST_CASE(nil_literal_test) { expect_script_file_out_to_be("nil/literal.lox", "nil\n"); }
 
 BOOST_AUTO_TEST_CASE(number_decimal_point_at_eof_test) { expect_script_file_out_to_be("number/decimal_point_at_eof.lox", "", "[Line 2] Error at end: Expected property name after '.'.\n\n", EXIT_FAILURE); }
@@ -367,6 +410,12 @@ BOOST_AUTO_TEST_CASE(operator_subtract_test) { expect_script_file_out_to_be("ope
 BOOST_AUTO_TEST_CASE(operator_subtract_nonnum_num_test) { expect_script_file_out_to_be("operator/subtract_nonnum_num.lox", "", "[Line 1] Error at '-': Operands must be numbers.\n", EXIT_FAILURE); }
 BOOST_AUTO_TEST_CASE(operator_subtract_num_nonnum_test) { expect_script_file_out_to_be("operator/subtract_num_nonnum.lox", "", "[Line 1] Error at '-': Operands must be numbers.\n", EXIT_FAILURE); }
 
+BOOST_AUTO_TEST_CASE(optimizer_add_string_num_test) { expect_script_file_out_to_be("optimizer/add_string_num.lox", "before\n", "Operands must be two numbers or two strings.\n", EXIT_FAILURE); }
+BOOST_AUTO_TEST_CASE(optimizer_dead_branches_test) { expect_script_file_out_to_be("optimizer/dead_branches.lox", "ac\nlive\nae\nae\n"); }
+BOOST_AUTO_TEST_CASE(optimizer_fold_test) { expect_script_file_out_to_be("optimizer/fold.lox", "ab\nabc\n7\n9\n3.5\n-3\ntrue\ntrue\ntrue\n"); }
+BOOST_AUTO_TEST_CASE(optimizer_logical_test) { expect_script_file_out_to_be("optimizer/logical.lox", "x\nnil\nx\ns\nfalse\ncalled\nf\n"); }
+BOOST_AUTO_TEST_CASE(optimizer_negate_string_test) { expect_script_file_out_to_be("optimizer/negate_string.lox", "before\n", "[Line 4] Error at '-': Operands must be numbers.\n", EXIT_FAILURE); }
+
 BOOST_AUTO_TEST_CASE(print_missing_argument_test) { expect_script_file_out_to_be("print/missing_argument.lox", "", "[Line 2] Error at ';': Expected expression.\n\n", EXIT_FAILURE); }
 
 BOOST_AUTO_TEST_CASE(regression_40_test) { expect_script_file_out_to_be("regression/40.lox", "false\n"); }
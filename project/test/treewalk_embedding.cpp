@@ -0,0 +1,129 @@
+#define BOOST_TEST_MODULE CppLox Treewalk Embedding Test
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+#include "lox.hpp"
+
+using std::ostringstream;
+using std::string;
+using std::vector;
+
+namespace loxns = motts::lox;
+
+// Not exported (internal linkage)
+namespace {
+    auto error_is(const string& expected_what) {
+        return [expected_what] (const loxns::Runtime_error& error) {
+            return error.what() == expected_what;
+        };
+    }
+
+    // Defines `leaked` only on the first run. A later run that can still see it would print it.
+    const auto leaky_script =
+        "if (firstRun()) {\n"
+        "  print \"defining\";\n"
+        "} else {\n"
+        "  print leaked;\n"
+        "}\n"
+        "var leaked = \"leaked\";\n";
+}
+
+BOOST_AUTO_TEST_CASE(program_executes_more_than_once_test) {
+    ostringstream out;
+    loxns::Lox lox {out};
+
+    const auto program = lox.compile("print \"run\";");
+    lox.execute(program);
+    lox.execute(program);
+
+    BOOST_TEST(out.str() == "run\nrun\n");
+}
+
+BOOST_AUTO_TEST_CASE(program_globals_dont_leak_test) {
+    ostringstream out;
+    loxns::Lox lox {out};
+    auto first_run = true;
+    lox.define_native("firstRun", [&first_run] () {
+        const auto result = first_run;
+        first_run = false;
+        return result;
+    });
+
+    const auto program = lox.compile(leaky_script);
+    lox.execute(program);
+    BOOST_CHECK_EXCEPTION(lox.execute(program), loxns::Runtime_error, error_is("Undefined variable 'leaked'."));
+
+    BOOST_TEST(out.str() == "defining\n");
+}
+
+BOOST_AUTO_TEST_CASE(program_natives_survive_reset_test) {
+    ostringstream out;
+    loxns::Lox lox {out};
+    lox.define_native("answer", [] () { return 42.0; });
+
+    // The first run overwrites the native with a number, which a fresh start must undo
+    const auto program = lox.compile("var answer = answer(); print answer; print clock() > 0;");
+    lox.execute(program);
+    lox.execute(program);
+
+    BOOST_TEST(out.str() == "42\ntrue\n42\ntrue\n");
+}
+
+BOOST_AUTO_TEST_CASE(run_shares_globals_test) {
+    ostringstream out;
+    loxns::Lox lox {out};
+
+    lox.run("var kept = \"kept\";");
+    lox.run("print kept;");
+
+    BOOST_TEST(out.str() == "kept\n");
+}
+
+BOOST_AUTO_TEST_CASE(typed_native_test) {
+    ostringstream out;
+    loxns::Lox lox {out};
+    lox.define_native("repeat", [] (double count, const string& text) {
+        string repeated;
+        for (auto i = 0; i < count; ++i) {
+            repeated += text;
+        }
+
+        return repeated;
+    });
+    vector<double> recorded;
+    lox.define_native("record", [&recorded] (double value) {
+        recorded.push_back(value);
+    });
+
+    lox.run("print repeat(3, \"ab\"); print record(1); print record(2);");
+
+    BOOST_TEST(out.str() == "ababab\nnil\nnil\n");
+    BOOST_TEST(recorded == (vector<double>{1, 2}), boost::test_tools::per_element());
+}
+
+BOOST_AUTO_TEST_CASE(typed_native_arity_error_test) {
+    ostringstream out;
+    loxns::Lox lox {out};
+    lox.define_native("record", [] (double) {});
+
+    BOOST_CHECK_EXCEPTION(
+        lox.run("record();"), loxns::Runtime_error, error_is("[Line 1] Error at ')': Expected 1 arguments but got 0.")
+    );
+}
+
+BOOST_AUTO_TEST_CASE(typed_native_argument_type_error_test) {
+    ostringstream out;
+    loxns::Lox lox {out};
+    lox.define_native("repeat", [] (double, const string& text) {
+        return text;
+    });
+
+    BOOST_CHECK_EXCEPTION(
+        lox.run("repeat(\"3\", \"ab\");"), loxns::Runtime_error, error_is("Argument 1 must be a number.")
+    );
+    BOOST_CHECK_EXCEPTION(lox.run("repeat(3, 4);"), loxns::Runtime_error, error_is("Argument 2 must be a string."));
+}